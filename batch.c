@@ -0,0 +1,198 @@
+/*
+ * batch.c: the command-line modes that the GTK front end offers
+ * alongside its GUI (--generate, --time-generation, --test-solve and
+ * --list-presets), for front ends that have no such thing of their
+ * own. Nothing here touches the display, so these run without one;
+ * benchmark.sh depends on them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "puzzles.h"
+
+static void list_presets_from_menu(struct preset_menu *menu)
+{
+    int i;
+
+    for (i = 0; i < menu->n_entries; i++) {
+        if (menu->entries[i].params) {
+            char *paramstr = thegame.encode_params(
+                menu->entries[i].params, true);
+            printf("%s %s\n", paramstr, menu->entries[i].title);
+            sfree(paramstr);
+        } else {
+            list_presets_from_menu(menu->entries[i].submenu);
+        }
+    }
+}
+
+static int batch_generate(const char *pname, const char *arg, int ngenerate,
+                          bool time_generation, bool test_solve)
+{
+    midend *me = midend_new(NULL, &thegame, NULL, NULL);
+    int i;
+
+    for (i = 0; i < ngenerate; i++) {
+        char *pstr, *seed;
+        const char *err;
+        struct rusage before, after;
+
+        if (arg) {
+            pstr = snewn(strlen(arg) + 40, char);
+
+            strcpy(pstr, arg);
+            if (i > 0 && strchr(arg, '#'))
+                sprintf(pstr + strlen(pstr), "-%d", i);
+
+            err = midend_game_id(me, pstr);
+            if (err) {
+                fprintf(stderr, "%s: error parsing '%s': %s\n",
+                        pname, pstr, err);
+                return 1;
+            }
+            sfree(pstr);
+        }
+
+        if (time_generation)
+            getrusage(RUSAGE_SELF, &before);
+
+        midend_new_game(me);
+
+        seed = midend_get_random_seed(me);
+
+        if (time_generation) {
+            double elapsed;
+
+            getrusage(RUSAGE_SELF, &after);
+
+            elapsed = (after.ru_utime.tv_sec -
+                       before.ru_utime.tv_sec);
+            elapsed += (after.ru_utime.tv_usec -
+                        before.ru_utime.tv_usec) / 1000000.0;
+
+            /* This is the line benchmark.pl parses. */
+            printf("%s %s: %.6f\n", thegame.name, seed, elapsed);
+        }
+
+        if (test_solve && thegame.can_solve) {
+            /*
+             * Destroy the aux_info in the midend by re-entering the
+             * same game id, and then try to solve it.
+             */
+            char *game_id;
+
+            game_id = midend_get_game_id(me);
+            err = midend_game_id(me, game_id);
+            if (err) {
+                fprintf(stderr, "%s %s: game id re-entry error: %s\n",
+                        thegame.name, seed, err);
+                return 1;
+            }
+            midend_new_game(me);
+            sfree(game_id);
+
+            err = midend_solve(me);
+            /*
+             * "Solution not known for this puzzle" just means there's
+             * no algorithmic solver (e.g. Netslide), which is fine.
+             */
+            if (err && strcmp(err, "Solution not known for this puzzle")) {
+                fprintf(stderr, "%s %s: solve error: %s\n",
+                        thegame.name, seed, err);
+                return 1;
+            }
+        }
+
+        sfree(seed);
+
+        if (!time_generation) {
+            char *id = midend_get_game_id(me);
+            puts(id);
+            sfree(id);
+        }
+    }
+
+    midend_free(me);
+    return 0;
+}
+
+/*
+ * Returns true if the command line asked for one of the batch modes,
+ * in which case it has been carried out and *status is the exit
+ * status. Returns false, having done nothing, if the front end should
+ * start up normally.
+ */
+bool batch_main(int argc, char **argv, int *status)
+{
+    const char *pname = argv[0];
+    int ngenerate = 0;
+    bool time_generation = false, test_solve = false, list_presets = false;
+    bool doing_opts = true;
+    const char *arg = NULL;
+    int ac = argc;
+    char **av = argv;
+
+    while (--ac > 0) {
+        char *p = *++av;
+        if (doing_opts && !strcmp(p, "--version")) {
+            printf("%s, from Simon Tatham's Portable Puzzle Collection\n%s\n",
+                   thegame.name, ver);
+            *status = 0;
+            return true;
+        } else if (doing_opts && !strcmp(p, "--generate")) {
+            if (--ac > 0) {
+                ngenerate = atoi(*++av);
+                if (!ngenerate) {
+                    fprintf(stderr, "%s: '--generate' expected a number\n",
+                            pname);
+                    *status = 1;
+                    return true;
+                }
+            } else
+                ngenerate = 1;
+        } else if (doing_opts && !strcmp(p, "--time-generation")) {
+            time_generation = true;
+        } else if (doing_opts && !strcmp(p, "--test-solve")) {
+            test_solve = true;
+        } else if (doing_opts && !strcmp(p, "--list-presets")) {
+            list_presets = true;
+        } else if (doing_opts && !strcmp(p, "--")) {
+            doing_opts = false;
+        } else if (!doing_opts || p[0] != '-') {
+            if (arg) {
+                fprintf(stderr, "%s: more than one argument supplied\n",
+                        pname);
+                *status = 1;
+                return true;
+            }
+            arg = p;
+        } else {
+            fprintf(stderr, "%s: unrecognised option '%s'\n", pname, p);
+            *status = 1;
+            return true;
+        }
+    }
+
+    if (ngenerate > 0) {
+        *status = batch_generate(pname, arg, ngenerate,
+                                 time_generation, test_solve);
+        return true;
+    } else if (list_presets) {
+        midend *me;
+        struct preset_menu *menu;
+
+        me = midend_new(NULL, &thegame, NULL, NULL);
+        menu = midend_get_presets(me, NULL);
+        list_presets_from_menu(menu);
+        midend_free(me);
+        *status = 0;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,768 @@
+/*
+ * benchmark.c: generate puzzles from every preset of every game, in
+ * one process and on as many threads as you like, and report how
+ * long each one took.
+ *
+ * This does the same job as running benchmark.sh, but without
+ * starting a process per preset or waiting for one preset to finish
+ * before starting the next. Its default output is the same raw data
+ * benchmark.sh produces, so it can be piped straight into
+ * benchmark.pl; with --json it writes a machine-readable version
+ * including wall-clock time and memory use too.
+ *
+ * Each (game, preset, seed number) triple is a job, and every job
+ * generates its puzzle from a random seed determined by the seed
+ * number alone, so the puzzles generated, and the order the results
+ * are reported in, don't depend on the number of threads.
+ *
+ * With --stats, it instead summarises each preset's generation times
+ * with the median and the 95th and 99th percentiles, each with a
+ * confidence interval, since generation time for the harder presets
+ * is too heavy-tailed for the mean to say much. --save-baseline
+ * writes those figures to a file, and --baseline compares a run
+ * against such a file and fails if any preset has got slower by more
+ * than the --threshold fraction (default 0.1).
+ *
+ * --ids prints the game id (parameters and description) of each
+ * generated puzzle instead of its time, so that two builds can be
+ * checked to generate exactly the same puzzles; latincheck.sh uses
+ * it to compare the two layouts of the latin square solver.
+ *
+ * --redraws N also times N full redraws of each generated puzzle at
+ * its preferred tile size, through the null front end's counting
+ * drawing (see drawtrace.c), and adds the CPU time per redraw and the
+ * drawing calls one redraw makes to the --json output. --trace FILE
+ * writes a Chrome trace of every job's generation and redraws, one
+ * track per thread.
+ *
+ * Usage: benchmark [--threads N] [--seeds N] [--test-solve]
+ *                  [--json FILE] [--stats] [--save-baseline FILE]
+ *                  [--baseline FILE [--threshold X]]
+ *                  [--redraws N] [--trace FILE] [--ids] [game...]
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* for clock_gettime */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "puzzles.h"
+
+struct job {
+    const game *game;
+    const char *params;                /* shared between a preset's jobs */
+    int seedno;
+
+    char *seed;                        /* as reported by the midend */
+    char *id;                          /* params:desc, if --ids */
+    double wall, cpu;                  /* seconds */
+    long maxrss;                       /* kilobytes, whole process */
+    const char *err;                   /* NULL on success */
+
+    struct draw_stats draw;            /* one full redraw, if --redraws */
+    int worker;                        /* which thread ran it */
+    double start, generated, end;      /* microseconds since the pool began */
+};
+
+/*
+ * A simple work-stealing scheme. The jobs are dealt out to the
+ * workers in contiguous runs; each worker takes jobs from the front
+ * of its own run, and one that runs out steals the back half of the
+ * longest run left.
+ */
+struct worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int lo, hi;                        /* jobs [lo,hi) are ours */
+    struct pool *pool;
+};
+
+struct pool {
+    struct job *jobs;
+    int njobs;
+    struct worker *workers;
+    int nworkers;
+    bool test_solve, ids;
+    int redraws;
+    struct timespec t0;
+};
+
+static double timespec_secs(const struct timespec *ts)
+{
+    return ts->tv_sec + ts->tv_nsec / 1000000000.0;
+}
+
+static double pool_usecs(struct pool *pool, const struct timespec *ts)
+{
+    return (timespec_secs(ts) - timespec_secs(&pool->t0)) * 1000000.0;
+}
+
+static void run_job(struct job *job, struct pool *pool)
+{
+    /* Nothing is drawn through it, but the midend won't draw without one. */
+    static const drawing_api drapi = { 1, NULL };
+    midend *me = midend_new(NULL, job->game, NULL, NULL), *dme;
+    struct timespec wall0, wall1, cpu0, cpu1;
+    struct rusage ru;
+    char *id;
+    const char *err;
+    char *game_id;
+    int i, w, h;
+
+    id = snewn(strlen(job->params) + 40, char);
+    sprintf(id, "%s#bench-%d", job->params, job->seedno);
+    err = midend_game_id(me, id);
+    sfree(id);
+    if (err) {
+        job->err = err;
+        midend_free(me);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall0);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+    midend_new_game(me);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+    clock_gettime(CLOCK_MONOTONIC, &wall1);
+
+    job->wall = timespec_secs(&wall1) - timespec_secs(&wall0);
+    job->cpu = timespec_secs(&cpu1) - timespec_secs(&cpu0);
+    job->seed = midend_get_random_seed(me);
+    if (pool->ids)
+        job->id = midend_get_game_id(me);
+    job->start = pool_usecs(pool, &wall0);
+    job->generated = job->end = pool_usecs(pool, &wall1);
+
+    /*
+     * Peak RSS is only available for the process as a whole, so this
+     * is the high-water mark reached by the time this job finished,
+     * not what this job used on its own.
+     */
+    getrusage(RUSAGE_SELF, &ru);
+    job->maxrss = ru.ru_maxrss;
+
+    if (pool->redraws > 0) {
+        /*
+         * A midend with a drawing generates interactive games (see
+         * midend_new_game), which for Mines means a placeholder and
+         * not the layout the timings above are for. So generation
+         * ran without one, and the redraws happen in a second midend
+         * that has a drawing and is given the generated game's id.
+         *
+         * Every full redraw of the same state makes the same calls,
+         * so the counts from all of them divide down to one's worth.
+         */
+        dme = midend_new(NULL, job->game, &drapi, &job->draw);
+        game_id = midend_get_game_id(me);
+        err = midend_game_id(dme, game_id);
+        sfree(game_id);
+        if (err) {
+            job->err = err;
+            midend_free(dme);
+            midend_free(me);
+            return;
+        }
+        midend_new_game(dme);
+        w = h = INT_MAX;
+        midend_size(dme, &w, &h, false, 1);
+        memset(&job->draw, 0, sizeof(job->draw));
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+        for (i = 0; i < pool->redraws; i++)
+            midend_force_redraw(dme);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+        clock_gettime(CLOCK_MONOTONIC, &wall1);
+        job->end = pool_usecs(pool, &wall1);
+        for (i = 0; i < DRAWSTAT_NPRIMS; i++)
+            job->draw.prims[i] /= pool->redraws;
+        job->draw.text_chars /= pool->redraws;
+        job->draw.pixels /= pool->redraws;
+        job->draw.redraw_ms = (timespec_secs(&cpu1) - timespec_secs(&cpu0))
+            * 1000.0 / pool->redraws;
+        midend_free(dme);
+    }
+
+    if (pool->test_solve && job->game->can_solve) {
+        /*
+         * As in gtk.c: re-enter the game id to throw away the
+         * aux_info, and then check the puzzle can still be solved.
+         */
+        game_id = midend_get_game_id(me);
+        err = midend_game_id(me, game_id);
+        sfree(game_id);
+        if (!err) {
+            midend_new_game(me);
+            err = midend_solve(me);
+            if (err && !strcmp(err, "Solution not known for this puzzle"))
+                err = NULL;
+        }
+        job->err = err;
+    }
+
+    midend_free(me);
+}
+
+static bool take_job(struct worker *w, int *index)
+{
+    bool ret = false;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->lo < w->hi) {
+        *index = w->lo++;
+        ret = true;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return ret;
+}
+
+static bool steal_jobs(struct worker *w)
+{
+    struct pool *pool = w->pool;
+    struct worker *victim = NULL;
+    int i, most = 0;
+
+    /*
+     * Pick the victim with the most jobs left. Each count is read
+     * under its own lock, but may be out of date by the time we come
+     * back to steal, so it's only a heuristic.
+     */
+    for (i = 0; i < pool->nworkers; i++) {
+        struct worker *v = &pool->workers[i];
+        int left;
+        if (v == w)
+            continue;
+        pthread_mutex_lock(&v->lock);
+        left = v->hi - v->lo;
+        pthread_mutex_unlock(&v->lock);
+        if (left > most) {
+            most = left;
+            victim = v;
+        }
+    }
+    if (!victim)
+        return false;
+
+    pthread_mutex_lock(&victim->lock);
+    most = victim->hi - victim->lo;
+    if (most > 0) {
+        int n = (most + 1) / 2;
+        pthread_mutex_lock(&w->lock);
+        w->hi = victim->hi;
+        w->lo = victim->hi = victim->hi - n;
+        pthread_mutex_unlock(&w->lock);
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return true;                       /* even if we lost a race: look again */
+}
+
+static void *worker_thread(void *vw)
+{
+    struct worker *w = (struct worker *)vw;
+    int index;
+
+    while (1) {
+        if (take_job(w, &index)) {
+            w->pool->jobs[index].worker = (int)(w - w->pool->workers);
+            run_job(&w->pool->jobs[index], w->pool);
+        }
+        else if (!steal_jobs(w))
+            break;
+    }
+    return NULL;
+}
+
+static void run_pool(struct pool *pool)
+{
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &pool->t0);
+    pool->workers = snewn(pool->nworkers, struct worker);
+    for (i = 0; i < pool->nworkers; i++) {
+        struct worker *w = &pool->workers[i];
+        pthread_mutex_init(&w->lock, NULL);
+        w->lo = (int)((long)pool->njobs * i / pool->nworkers);
+        w->hi = (int)((long)pool->njobs * (i+1) / pool->nworkers);
+        w->pool = pool;
+    }
+    for (i = 0; i < pool->nworkers; i++)
+        pthread_create(&pool->workers[i].thread, NULL, worker_thread,
+                       &pool->workers[i]);
+    for (i = 0; i < pool->nworkers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        pthread_mutex_destroy(&pool->workers[i].lock);
+    }
+    sfree(pool->workers);
+}
+
+struct preset_list {
+    char **params;
+    int n, size;
+};
+
+static void collect_presets(const game *g, struct preset_menu *menu,
+                            struct preset_list *list)
+{
+    int i;
+
+    for (i = 0; i < menu->n_entries; i++) {
+        if (menu->entries[i].params) {
+            if (list->n >= list->size) {
+                list->size = list->n * 5 / 4 + 16;
+                list->params = sresize(list->params, list->size, char *);
+            }
+            list->params[list->n++] =
+                g->encode_params(menu->entries[i].params, true);
+        } else {
+            collect_presets(g, menu->entries[i].submenu, list);
+        }
+    }
+}
+
+/*
+ * Statistics for one preset, over its nseeds jobs.
+ */
+#define NQUANTILES 3
+static const double quantiles[NQUANTILES] = { 0.5, 0.95, 0.99 };
+static const char *const quantile_names[NQUANTILES] = {
+    "median", "p95", "p99"
+};
+
+struct preset_stats {
+    const game *game;
+    const char *params;
+    int n;                             /* jobs that succeeded */
+    double mean;
+    double q[NQUANTILES];
+    double lo[NQUANTILES], hi[NQUANTILES]; /* 95% confidence intervals */
+};
+
+static int cmp_double(const void *av, const void *bv, void *ctx)
+{
+    double a = *(const double *)av, b = *(const double *)bv;
+    return a < b ? -1 : a > b ? +1 : 0;
+}
+
+static double rank_value(const double *sorted, int n, double rank)
+{
+    int r = (int)rank;
+    return sorted[r < 0 ? 0 : r >= n ? n-1 : r];
+}
+
+/*
+ * The q-quantile of n sorted samples, by the nearest-rank method,
+ * with a distribution-free confidence interval: the number of samples
+ * below the true quantile is binomial(n, q), so using the normal
+ * approximation to that, the interval runs between the order
+ * statistics 1.96 standard deviations either side of rank nq.
+ */
+static void quantile_ci(const double *sorted, int n, double q,
+                        double *val, double *lo, double *hi)
+{
+    double sd = sqrt(n * q * (1 - q));
+
+    *val = rank_value(sorted, n, ceil(n * q) - 1);
+    *lo = rank_value(sorted, n, floor(n * q - 1.96 * sd) - 1);
+    *hi = rank_value(sorted, n, ceil(n * q + 1.96 * sd) - 1);
+}
+
+static void compute_stats(struct pool *pool, int first, int nseeds,
+                          struct preset_stats *st)
+{
+    double *times = snewn(nseeds, double);
+    double total = 0;
+    int i;
+
+    st->game = pool->jobs[first].game;
+    st->params = pool->jobs[first].params;
+    st->n = 0;
+    for (i = first; i < first + nseeds; i++)
+        if (pool->jobs[i].seed && !pool->jobs[i].err) {
+            times[st->n++] = pool->jobs[i].cpu;
+            total += pool->jobs[i].cpu;
+        }
+
+    if (st->n) {
+        arraysort(times, st->n, cmp_double, NULL);
+        st->mean = total / st->n;
+        for (i = 0; i < NQUANTILES; i++)
+            quantile_ci(times, st->n, quantiles[i],
+                        &st->q[i], &st->lo[i], &st->hi[i]);
+    }
+    sfree(times);
+}
+
+/*
+ * Baseline files have one line per preset:
+ *
+ *   <game> <params> <n> <median> <p95> <p99>
+ *
+ * where <game> is the game's short name as used on the command line.
+ */
+static void write_baseline(FILE *fp, struct preset_stats *st, int nst)
+{
+    int i, j;
+
+    for (i = 0; i < nst; i++) {
+        if (!st[i].n)
+            continue;
+        fprintf(fp, "%s %s %d", st[i].game->htmlhelp_topic,
+                st[i].params, st[i].n);
+        for (j = 0; j < NQUANTILES; j++)
+            fprintf(fp, " %.6f", st[i].q[j]);
+        fputc('\n', fp);
+    }
+}
+
+/*
+ * Returns the number of presets that regressed, or -1 if the baseline
+ * file couldn't be read. A preset has regressed if, for any of the
+ * quantiles, even the bottom of its confidence interval is more than
+ * (1 + threshold) times the baseline figure; so noise alone should
+ * only rarely trip it.
+ */
+static int compare_baseline(const char *filename, struct preset_stats *st,
+                            int nst, double threshold)
+{
+    FILE *fp = fopen(filename, "r");
+    char *line;
+    int i, j, regressed = 0;
+
+    if (!fp) {
+        perror(filename);
+        return -1;
+    }
+    while ((line = fgetline(fp)) != NULL) {
+        char name[80], params[256];
+        double base[NQUANTILES];
+        int n;
+
+        if (sscanf(line, "%79s %255s %d %lf %lf %lf", name, params, &n,
+                   &base[0], &base[1], &base[2]) != 3 + NQUANTILES) {
+            sfree(line);
+            continue;
+        }
+        sfree(line);
+
+        for (i = 0; i < nst; i++)
+            if (st[i].n && !strcmp(st[i].game->htmlhelp_topic, name) &&
+                !strcmp(st[i].params, params))
+                break;
+        if (i == nst)
+            continue;                  /* not measured this time */
+
+        for (j = 0; j < NQUANTILES; j++) {
+            if (st[i].lo[j] > base[j] * (1 + threshold)) {
+                fprintf(stderr, "%s %s: %s regressed from %.6f to %.6f "
+                        "(95%% CI %.6f-%.6f)\n", st[i].game->name,
+                        st[i].params, quantile_names[j], base[j],
+                        st[i].q[j], st[i].lo[j], st[i].hi[j]);
+                regressed++;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    return regressed;
+}
+
+static void json_string(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned char)*s);
+        else
+            fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+static void write_json(FILE *fp, struct pool *pool, int nseeds,
+                       struct preset_stats *st, int nst)
+{
+    int i, j;
+
+    fprintf(fp, "{\n  \"threads\": %d,\n  \"seeds\": %d,\n  \"jobs\": [",
+            pool->nworkers, nseeds);
+    for (i = 0; i < pool->njobs; i++) {
+        struct job *job = &pool->jobs[i];
+        fprintf(fp, "%s\n    {\"game\": ", i ? "," : "");
+        json_string(fp, job->game->name);
+        fprintf(fp, ", \"params\": ");
+        json_string(fp, job->params);
+        fprintf(fp, ", \"seed\": %d", job->seedno);
+        if (job->seed) {
+            fprintf(fp, ", \"wall\": %.6f, \"cpu\": %.6f, \"maxrss_kb\": %ld",
+                    job->wall, job->cpu, job->maxrss);
+            if (pool->redraws > 0) {
+                fprintf(fp, ", \"redraw_ms\": %.6f, \"draw\": {",
+                        job->draw.redraw_ms);
+                for (j = 0; j < DRAWSTAT_NPRIMS; j++)
+                    fprintf(fp, "\"%s\": %ld, ", draw_stat_names[j],
+                            job->draw.prims[j]);
+                fprintf(fp, "\"text_chars\": %ld, \"pixels\": %ld}",
+                        job->draw.text_chars, job->draw.pixels);
+            }
+        }
+        if (job->err) {
+            fprintf(fp, ", \"error\": ");
+            json_string(fp, job->err);
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ],\n  \"presets\": [");
+    for (i = 0; i < nst; i++) {
+        fprintf(fp, "%s\n    {\"game\": ", i ? "," : "");
+        json_string(fp, st[i].game->name);
+        fprintf(fp, ", \"params\": ");
+        json_string(fp, st[i].params);
+        fprintf(fp, ", \"n\": %d", st[i].n);
+        if (st[i].n) {
+            fprintf(fp, ", \"mean\": %.6f", st[i].mean);
+            for (j = 0; j < NQUANTILES; j++)
+                fprintf(fp, ", \"%s\": [%.6f, %.6f, %.6f]",
+                        quantile_names[j], st[i].lo[j], st[i].q[j],
+                        st[i].hi[j]);
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
+
+static void file_write(void *wctx, const void *buf, int len)
+{
+    fwrite(buf, 1, len, (FILE *)wctx);
+}
+
+static void write_trace(FILE *fp, struct pool *pool)
+{
+    draw_trace *tr = draw_trace_new();
+    char *name;
+    int i;
+
+    for (i = 0; i < pool->njobs; i++) {
+        struct job *job = &pool->jobs[i];
+        if (!job->seed)
+            continue;
+        name = snewn(strlen(job->game->name) + strlen(job->params) + 40,
+                     char);
+        sprintf(name, "%s %s#bench-%d", job->game->name, job->params,
+                job->seedno);
+        draw_trace_span(tr, name, job->worker, job->start, job->generated);
+        sfree(name);
+        if (pool->redraws > 0) {
+            draw_trace_span(tr, "redraw", job->worker, job->generated,
+                            job->end);
+            draw_trace_counts(tr, "draw", job->worker, job->generated,
+                              &job->draw);
+        }
+    }
+    draw_trace_write(tr, file_write, fp);
+    draw_trace_free(tr);
+}
+
+int main(int argc, char **argv)
+{
+    const char *pname = argv[0];
+    const char *jsonfile = NULL, *tracefile = NULL;
+    const char *baseline = NULL, *save_baseline = NULL;
+    double threshold = 0.1;
+    int nthreads = 0, nseeds = 100, redraws = 0;
+    bool test_solve = false, stats = false, ids = false;
+    const game **games = snewn(gamecount, const game *);
+    int ngames = 0;
+    struct preset_list *presets;
+    struct pool pool;
+    struct preset_stats *st;
+    int nst;
+    int i, j, k, n;
+    bool failed = false;
+
+    while (--argc > 0) {
+        char *p = *++argv;
+        if (!strcmp(p, "--threads") && argc > 1) {
+            argc--;
+            nthreads = atoi(*++argv);
+        } else if (!strcmp(p, "--seeds") && argc > 1) {
+            argc--;
+            nseeds = atoi(*++argv);
+        } else if (!strcmp(p, "--json") && argc > 1) {
+            argc--;
+            jsonfile = *++argv;
+        } else if (!strcmp(p, "--redraws") && argc > 1) {
+            argc--;
+            redraws = atoi(*++argv);
+        } else if (!strcmp(p, "--trace") && argc > 1) {
+            argc--;
+            tracefile = *++argv;
+        } else if (!strcmp(p, "--test-solve")) {
+            test_solve = true;
+        } else if (!strcmp(p, "--stats")) {
+            stats = true;
+        } else if (!strcmp(p, "--ids")) {
+            ids = true;
+        } else if (!strcmp(p, "--baseline") && argc > 1) {
+            argc--;
+            baseline = *++argv;
+        } else if (!strcmp(p, "--save-baseline") && argc > 1) {
+            argc--;
+            save_baseline = *++argv;
+        } else if (!strcmp(p, "--threshold") && argc > 1) {
+            argc--;
+            threshold = atof(*++argv);
+        } else if (p[0] == '-') {
+            fprintf(stderr, "%s: unrecognised option '%s'\n", pname, p);
+            return 1;
+        } else {
+            for (i = 0; i < gamecount; i++)
+                if (!strcmp(p, gamelist[i]->htmlhelp_topic) ||
+                    !strcmp(p, gamelist[i]->name))
+                    break;
+            if (i == gamecount) {
+                fprintf(stderr, "%s: unrecognised game '%s'\n", pname, p);
+                return 1;
+            }
+            games[ngames++] = gamelist[i];
+        }
+    }
+    if (!ngames)
+        for (ngames = 0; ngames < gamecount; ngames++)
+            games[ngames] = gamelist[ngames];
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+
+    presets = snewn(ngames, struct preset_list);
+    n = 0;
+    for (i = 0; i < ngames; i++) {
+        midend *me = midend_new(NULL, games[i], NULL, NULL);
+        presets[i].params = NULL;
+        presets[i].n = presets[i].size = 0;
+        collect_presets(games[i], midend_get_presets(me, NULL), &presets[i]);
+        midend_free(me);
+        n += presets[i].n * nseeds;
+    }
+
+    pool.jobs = snewn(n, struct job);
+    pool.njobs = 0;
+    pool.nworkers = nthreads;
+    pool.test_solve = test_solve;
+    pool.ids = ids;
+    pool.redraws = redraws;
+    for (i = 0; i < ngames; i++)
+        for (j = 0; j < presets[i].n; j++)
+            for (k = 0; k < nseeds; k++) {
+                struct job *job = &pool.jobs[pool.njobs++];
+                job->game = games[i];
+                job->params = presets[i].params[j];
+                job->seedno = k;
+                job->seed = NULL;
+                job->id = NULL;
+                job->err = NULL;
+                job->worker = 0;
+            }
+    assert(pool.njobs == n);
+
+    run_pool(&pool);
+
+    /* Jobs for each preset are consecutive, in seed order. */
+    nst = nseeds > 0 ? pool.njobs / nseeds : 0;
+    st = snewn(nst ? nst : 1, struct preset_stats);
+    for (i = 0; i < nst; i++)
+        compute_stats(&pool, i * nseeds, nseeds, &st[i]);
+
+    for (i = 0; i < pool.njobs; i++) {
+        struct job *job = &pool.jobs[i];
+        if (job->err) {
+            fprintf(stderr, "%s %s#bench-%d: %s\n", job->game->name,
+                    job->params, job->seedno, job->err);
+            failed = true;
+        }
+        /* The raw format benchmark.pl expects, as written by benchmark.sh. */
+        if (job->id && !stats)
+            printf("%s %s\n", job->game->name, job->id);
+        else if (job->seed && !stats)
+            printf("%s %s: %.6f\n", job->game->name, job->seed, job->cpu);
+    }
+
+    if (stats) {
+        for (i = 0; i < nst; i++) {
+            if (!st[i].n)
+                continue;
+            printf("%s %s: n=%d mean=%.6f", st[i].game->name, st[i].params,
+                   st[i].n, st[i].mean);
+            for (j = 0; j < NQUANTILES; j++)
+                printf(" %s=%.6f [%.6f,%.6f]", quantile_names[j],
+                       st[i].q[j], st[i].lo[j], st[i].hi[j]);
+            printf("\n");
+        }
+    }
+
+    if (save_baseline) {
+        FILE *fp = fopen(save_baseline, "w");
+        if (!fp) {
+            perror(save_baseline);
+            return 1;
+        }
+        write_baseline(fp, st, nst);
+        fclose(fp);
+    }
+
+    if (baseline) {
+        int regressed = compare_baseline(baseline, st, nst, threshold);
+        if (regressed != 0)
+            failed = true;
+        if (regressed > 0)
+            fprintf(stderr, "%s: %d preset%s regressed\n", pname,
+                    regressed, regressed == 1 ? "" : "s");
+    }
+
+    if (jsonfile) {
+        FILE *fp = fopen(jsonfile, "w");
+        if (!fp) {
+            perror(jsonfile);
+            return 1;
+        }
+        write_json(fp, &pool, nseeds, st, nst);
+        fclose(fp);
+    }
+
+    if (tracefile) {
+        FILE *fp = fopen(tracefile, "w");
+        if (!fp) {
+            perror(tracefile);
+            return 1;
+        }
+        write_trace(fp, &pool);
+        fclose(fp);
+    }
+
+    for (i = 0; i < pool.njobs; i++) {
+        sfree(pool.jobs[i].seed);
+        sfree(pool.jobs[i].id);
+    }
+    sfree(pool.jobs);
+    sfree(st);
+    for (i = 0; i < ngames; i++) {
+        for (j = 0; j < presets[i].n; j++)
+            sfree(presets[i].params[j]);
+        sfree(presets[i].params);
+    }
+    sfree(presets);
+    sfree(games);
+
+    return failed ? 1 : 0;
+}
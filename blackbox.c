@@ -1556,6 +1556,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     false, NULL, NULL, /* can_format_as_text_now, text_format */
     NULL, NULL, /* get_prefs, set_prefs */
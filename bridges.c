@@ -3319,6 +3319,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     get_prefs, set_prefs,
@@ -39,11 +39,19 @@ endif()
 include_directories(${GTK_INCLUDE_DIRS})
 link_directories(${GTK_LIBRARY_DIRS})
 
-set(platform_common_sources sdl-fe.c )
+set(platform_common_sources sdl-fe.c batch.c)
 set(platform_gui_libs ${GTK_LIBRARIES})
 
 set(platform_libs -lm -lSDL2)
 
+# Optional: compression of long records in binary saved games.
+find_package(ZLIB)
+if(ZLIB_FOUND)
+  add_definitions(-DHAVE_ZLIB)
+  include_directories(${ZLIB_INCLUDE_DIRS})
+  list(APPEND platform_libs ${ZLIB_LIBRARIES})
+endif()
+
 set(build_icons FALSE)
 if(CMAKE_CROSSCOMPILING)
   # The puzzle icons are built by compiling and running a preliminary
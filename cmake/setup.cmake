@@ -14,6 +14,11 @@ if(USE_DRAW_POLYGON_FALLBACK)
   add_compile_definitions(USE_DRAW_POLYGON_FALLBACK)
 endif()
 
+option(LATIN_BITSET "keep the latin square solver's candidates as bitsets" off)
+if(LATIN_BITSET)
+  add_compile_definitions(LATIN_BITSET)
+endif()
+
 # Don't disable assertions, even in release mode.  Our assertions
 # generally aren't expensive and protect against more annoying crashes
 # and memory corruption.
@@ -1758,6 +1758,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     false, NULL, /* solve */
     false, NULL, NULL, /* can_format_as_text_now, text_format */
     NULL, NULL, /* get_prefs, set_prefs */
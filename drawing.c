@@ -34,6 +34,7 @@
 #endif
 
 #include "puzzles.h"
+#include "tree234.h"
 
 struct print_colour {
     int hatch;
@@ -266,6 +267,108 @@ void blitter_load(drawing *dr, blitter *bl, int x, int y)
     dri->pub.api->blitter_load(dr, bl, x, y);
 }
 
+/*
+ * A cache of rendered tiles, for back ends whose game_redraw comes
+ * down to drawing each grid cell in one of a limited number of ways.
+ * The back end names each appearance with a key (typically the same
+ * flags word it keeps in its drawstate to decide whether a cell
+ * needs redrawing). The first time a key is drawn, the result is
+ * saved in a blitter; after that, drawing it is a blitter_load.
+ *
+ * It's up to the back end to make sure that what it draws for a key
+ * really does depend on nothing else, and stays inside the tile.
+ * Tiles are only cached at the size the cache was made for, so a
+ * back end should make a new one from game_set_size.
+ */
+#define TILE_CACHE_MAX 512
+
+struct tile_cache_entry {
+    unsigned long key;
+    blitter *bl;
+};
+
+struct tile_cache {
+    int w, h;
+    tree234 *tiles;             /* NULL if the front end has no blitters */
+};
+
+static int tile_cache_cmp(void *av, void *bv)
+{
+    const struct tile_cache_entry *a = (const struct tile_cache_entry *)av;
+    const struct tile_cache_entry *b = (const struct tile_cache_entry *)bv;
+    if (a->key < b->key)
+        return -1;
+    else if (a->key > b->key)
+        return +1;
+    return 0;
+}
+
+tile_cache *tile_cache_new(drawing *dr, int w, int h)
+{
+    tile_cache *tc = snew(tile_cache);
+    tc->w = w;
+    tc->h = h;
+    tc->tiles = NULL;
+    if (dr && dr->api->blitter_new && dr->api->blitter_save &&
+        dr->api->blitter_load)
+        tc->tiles = newtree234(tile_cache_cmp);
+    return tc;
+}
+
+void tile_cache_free(drawing *dr, tile_cache *tc)
+{
+    struct tile_cache_entry *ent;
+
+    if (!tc)
+        return;
+    if (tc->tiles) {
+        while ((ent = delpos234(tc->tiles, 0)) != NULL) {
+            blitter_free(dr, ent->bl);
+            sfree(ent);
+        }
+        freetree234(tc->tiles);
+    }
+    sfree(tc);
+}
+
+/*
+ * Draws the tile with the given key at (x,y) and returns true, or
+ * returns false if it isn't cached, in which case the caller should
+ * draw it the long way and then call tile_cache_store.
+ */
+bool tile_cache_draw(drawing *dr, tile_cache *tc, unsigned long key,
+                     int x, int y)
+{
+    struct tile_cache_entry tmp, *ent;
+
+    if (!tc || !tc->tiles)
+        return false;
+    tmp.key = key;
+    ent = find234(tc->tiles, &tmp, NULL);
+    if (!ent)
+        return false;
+    blitter_load(dr, ent->bl, x, y);
+    return true;
+}
+
+void tile_cache_store(drawing *dr, tile_cache *tc, unsigned long key,
+                      int x, int y)
+{
+    struct tile_cache_entry *ent;
+
+    if (!tc || !tc->tiles || count234(tc->tiles) >= TILE_CACHE_MAX)
+        return;
+    ent = snew(struct tile_cache_entry);
+    ent->key = key;
+    ent->bl = blitter_new(dr, tc->w, tc->h);
+    blitter_save(dr, ent->bl, x, y);
+    if (add234(tc->tiles, ent) != ent) {
+        /* already there, so the caller didn't need to draw it after all */
+        blitter_free(dr, ent->bl);
+        sfree(ent);
+    }
+}
+
 void print_begin_doc(drawing *dr, int pages)
 {
     drawing_internal *dri = PRIVATE_CAST(dr);
@@ -0,0 +1,184 @@
+/*
+ * drawtrace.c: counting what a redraw asks the front end to do, and
+ * recording where the time went in a form chrome://tracing and
+ * Perfetto can read.
+ *
+ * A front end that wants to know what its redraws cost keeps a
+ * struct draw_stats per frame, bumping the count for each drawing
+ * API call it gets and filling in whatever timings it can measure.
+ * The null front end does the counting itself, for any drawing
+ * created with a struct draw_stats as its handle, so command-line
+ * tools can measure a back end's game_redraw with no display at all.
+ *
+ * A draw_trace collects spans of time ("X" events, in the trace
+ * format's terms) and snapshots of a frame's counts ("C" events),
+ * and writes them all out at the end as a Trace Event Format JSON
+ * file. Timestamps are in microseconds from whatever origin the
+ * caller likes.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "puzzles.h"
+
+/*
+ * Past this many events a trace stops recording, rather than eat all
+ * the memory of a front end that has been left running with tracing
+ * on.
+ */
+#define DRAW_TRACE_MAX 1000000
+
+const char *const draw_stat_names[DRAWSTAT_NPRIMS] = {
+    "text", "rect", "line", "thick_line", "polygon", "circle", "clip",
+    "blit",
+};
+
+struct draw_trace_event {
+    char *name;
+    int tid;
+    double ts, dur;                    /* dur < 0 for a counter event */
+    struct draw_stats stats;           /* counter events only */
+};
+
+struct draw_trace {
+    struct draw_trace_event *events;
+    int nevents, size;
+};
+
+draw_trace *draw_trace_new(void)
+{
+    draw_trace *tr = snew(draw_trace);
+    tr->events = NULL;
+    tr->nevents = tr->size = 0;
+    return tr;
+}
+
+void draw_trace_free(draw_trace *tr)
+{
+    int i;
+
+    if (!tr)
+        return;
+    for (i = 0; i < tr->nevents; i++)
+        sfree(tr->events[i].name);
+    sfree(tr->events);
+    sfree(tr);
+}
+
+static struct draw_trace_event *draw_trace_add(draw_trace *tr,
+                                               const char *name, int tid,
+                                               double ts)
+{
+    struct draw_trace_event *ev;
+
+    if (tr->nevents >= DRAW_TRACE_MAX)
+        return NULL;
+    if (tr->nevents >= tr->size) {
+        tr->size = tr->nevents * 5 / 4 + 256;
+        tr->events = sresize(tr->events, tr->size, struct draw_trace_event);
+    }
+    ev = &tr->events[tr->nevents++];
+    ev->name = dupstr(name);
+    ev->tid = tid;
+    ev->ts = ts;
+    ev->dur = -1;
+    return ev;
+}
+
+void draw_trace_span(draw_trace *tr, const char *name, int tid,
+                     double start, double end)
+{
+    struct draw_trace_event *ev = draw_trace_add(tr, name, tid, start);
+    if (ev)
+        ev->dur = end > start ? end - start : 0;
+}
+
+void draw_trace_counts(draw_trace *tr, const char *name, int tid,
+                       double ts, const struct draw_stats *st)
+{
+    struct draw_trace_event *ev = draw_trace_add(tr, name, tid, ts);
+    if (ev)
+        ev->stats = *st;
+}
+
+static void draw_trace_printf(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    const char *fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len >= (int)sizeof(buf))
+        len = sizeof(buf) - 1;
+    write(wctx, buf, len);
+}
+
+static void draw_trace_string(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    const char *s)
+{
+    write(wctx, "\"", 1);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            write(wctx, "\\", 1);
+            write(wctx, s, 1);
+        } else if ((unsigned char)*s < 0x20) {
+            draw_trace_printf(write, wctx, "\\u%04x", (unsigned char)*s);
+        } else {
+            write(wctx, s, 1);
+        }
+    }
+    write(wctx, "\"", 1);
+}
+
+void draw_trace_write(draw_trace *tr,
+                      void (*write)(void *ctx, const void *buf, int len),
+                      void *wctx)
+{
+    int i, j;
+
+    draw_trace_printf(write, wctx, "{\"traceEvents\":[");
+    for (i = 0; i < tr->nevents; i++) {
+        const struct draw_trace_event *ev = &tr->events[i];
+
+        draw_trace_printf(write, wctx, "%s\n{\"name\":", i ? "," : "");
+        draw_trace_string(write, wctx, ev->name);
+        draw_trace_printf(write, wctx, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f,",
+                          ev->tid, ev->ts);
+        if (ev->dur >= 0) {
+            draw_trace_printf(write, wctx, "\"ph\":\"X\",\"dur\":%.3f}",
+                              ev->dur);
+            continue;
+        }
+        draw_trace_printf(write, wctx, "\"ph\":\"C\",\"args\":{");
+        for (j = 0; j < DRAWSTAT_NPRIMS; j++)
+            draw_trace_printf(write, wctx, "\"%s\":%ld,",
+                              draw_stat_names[j], ev->stats.prims[j]);
+        draw_trace_printf(write, wctx, "\"text_chars\":%ld,\"pixels\":%ld}}",
+                          ev->stats.text_chars, ev->stats.pixels);
+    }
+    draw_trace_printf(write, wctx, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+/*
+ * One line summing up a frame, for an on-screen overlay or a log.
+ */
+void draw_stats_format(const struct draw_stats *st, char *buf, int len)
+{
+    long prims = 0;
+    int i;
+
+    for (i = 0; i < DRAWSTAT_NPRIMS; i++)
+        if (i != DRAWSTAT_TEXT)
+            prims += st->prims[i];
+    snprintf(buf, len, "prims %ld text %ld px %ld | "
+             "redraw %.2f raster %.2f upload %.2f present %.2f ms",
+             prims, st->prims[DRAWSTAT_TEXT], st->pixels,
+             st->redraw_ms, st->raster_ms, st->upload_ms, st->present_ms);
+}
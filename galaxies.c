@@ -4124,6 +4124,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
 #ifdef EDITOR
     false, NULL,
 #else
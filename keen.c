@@ -244,6 +244,31 @@ struct solver_ctx {
     int *iscratch;
 };
 
+/*
+ * Contexts for the branches of a recursive search that are searched
+ * at once (see latin.c): the clue layout is shared, but each needs
+ * scratch space of its own. One after another, they can all share the
+ * same one.
+ */
+static void *clone_ctx(void *vctx)
+{
+    struct solver_ctx *ctx = (struct solver_ctx *)vctx;
+    int a = ctx->w * ctx->w, ni = max(a+1, 4*ctx->w);
+    struct solver_ctx *ret;
+
+    ret = smalloc(sizeof(struct solver_ctx) + ni * sizeof(int) +
+                  (a+1) * sizeof(digit));
+    *ret = *ctx;
+    ret->iscratch = (int *)(ret + 1);
+    ret->dscratch = (digit *)(ret->iscratch + ni);
+    return ret;
+}
+
+static void free_ctx(void *vctx)
+{
+    sfree(vctx);
+}
+
 static void solver_clue_candidate(struct solver_ctx *ctx, int diff, int box)
 {
     int w = ctx->w;
@@ -381,15 +406,15 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 
 		/* (i,j) is a valid digit pair. Try it both ways round. */
 
-		if (solver->cube[sq[0]*w+i-1] &&
-		    solver->cube[sq[1]*w+j-1]) {
+		if (cubeat(sq[0]*w+i-1) &&
+		    cubeat(sq[1]*w+j-1)) {
 		    ctx->dscratch[0] = i;
 		    ctx->dscratch[1] = j;
 		    solver_clue_candidate(ctx, diff, box);
 		}
 
-		if (solver->cube[sq[0]*w+j-1] &&
-		    solver->cube[sq[1]*w+i-1]) {
+		if (cubeat(sq[0]*w+j-1) &&
+		    cubeat(sq[1]*w+i-1)) {
 		    ctx->dscratch[0] = j;
 		    ctx->dscratch[1] = i;
 		    solver_clue_candidate(ctx, diff, box);
@@ -420,7 +445,7 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 		    for (j = ctx->dscratch[i] + 1; j <= w; j++) {
 			if (op == C_ADD ? (total < j) : (total % j != 0))
 			    continue;  /* this one won't fit */
-			if (!solver->cube[sq[i]*w+j-1])
+			if (!cubeat(sq[i]*w+j-1))
 			    continue;  /* this one is ruled out already */
 			for (k = 0; k < i; k++)
 			    if (ctx->dscratch[k] == j &&
@@ -487,7 +512,7 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 
 	    for (i = 0; i < n; i++)
 		for (j = 1; j <= w; j++) {
-		    if (solver->cube[sq[i]*w+j-1] &&
+		    if (cubeat(sq[i]*w+j-1) &&
 			!(ctx->iscratch[i] & (1 << j))) {
 #ifdef STANDALONE_SOLVER
 			if (solver_show_working) {
@@ -497,7 +522,7 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 			    prefix[0] = '\0';
 			}
 #endif
-			solver->cube[sq[i]*w+j-1] = 0;
+			cubeat_clear(sq[i]*w+j-1);
 			ret = 1;
 		    }
 		}
@@ -531,7 +556,7 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 		    for (k = 0; k < w; k++) {
 			int pos = start + k*step;
 			if (ctx->whichbox[pos] != box &&
-			    solver->cube[pos*w+j-1]) {
+			    cubeat(pos*w+j-1)) {
 #ifdef STANDALONE_SOLVER
 			    if (solver_show_working) {
 				printf("%s%s%*s   ruling out %d at (%d,%d)\n",
@@ -541,7 +566,7 @@ static int solver_common(struct latin_solver *solver, void *vctx, int diff)
 				prefix[0] = prefix2[0] = '\0';
 			    }
 #endif
-			    solver->cube[pos*w+j-1] = 0;
+			    cubeat_clear(pos*w+j-1);
 			    ret = 1;
 			}
 		    }
@@ -686,7 +711,8 @@ static bool keen_valid(struct latin_solver *solver, void *vctx)
     return true;
 }
 
-static int solver(int w, DSF *dsf, long *clues, digit *soln, int maxdiff)
+static int solver(int w, DSF *dsf, long *clues, digit *soln, int maxdiff,
+                  latin_arena *arena)
 {
     int a = w*w;
     struct solver_ctx ctx;
@@ -730,10 +756,11 @@ static int solver(int w, DSF *dsf, long *clues, digit *soln, int maxdiff)
     ctx.dscratch = snewn(a+1, digit);
     ctx.iscratch = snewn(max(a+1, 4*w), int);
 
-    ret = latin_solver(soln, w, maxdiff,
+    ret = latin_solver(soln, w, arena, maxdiff,
 		       DIFF_EASY, DIFF_HARD, DIFF_EXTREME,
 		       DIFF_EXTREME, DIFF_UNREASONABLE,
-		       keen_solvers, keen_valid, &ctx, NULL, NULL);
+		       keen_solvers, keen_valid, &ctx, NULL, NULL,
+		       clone_ctx, free_ctx);
 
     sfree(ctx.dscratch);
     sfree(ctx.iscratch);
@@ -893,45 +920,42 @@ static const char *parse_block_structure(const char **p, int w, DSF *dsf)
     return NULL;
 }
 
-static char *new_game_desc(const game_params *params, random_state *rs,
-			   char **aux, bool interactive)
+struct keen_attempt_ctx {
+    const game_params *params;
+    int diff;
+};
+
+struct keen_attempt_result {
+    char *desc, *aux;
+};
+
+static void free_keen_attempt_result(void *vres)
+{
+    struct keen_attempt_result *res = (struct keen_attempt_result *)vres;
+    sfree(res->desc);
+    sfree(res->aux);
+    sfree(res);
+}
+
+/*
+ * One go at generating a puzzle of exactly the required difficulty,
+ * returning NULL if it didn't come out right. new_game_desc hands
+ * these to race_attempts, which may run several at once.
+ */
+static void *keen_attempt(void *vctx, random_state *rs)
 {
+    const struct keen_attempt_ctx *ctx = (const struct keen_attempt_ctx *)vctx;
+    const game_params *params = ctx->params;
     int w = params->w, a = w*w;
     digit *grid, *soln;
     int *order, *revorder, *singletons;
     DSF *dsf;
     long *clues, *cluevals;
     int i, j, k, n, x, y, ret;
-    int diff = params->diff;
+    int diff = ctx->diff;
     char *desc, *p;
-
-    /*
-     * Difficulty exceptions: 3x3 puzzles at difficulty Hard or
-     * higher are currently not generable - the generator will spin
-     * forever looking for puzzles of the appropriate difficulty. We
-     * dial each of these down to the next lower difficulty.
-     *
-     * Remember to re-test this whenever a change is made to the
-     * solver logic!
-     *
-     * I tested it using the following shell command:
-
-for d in e n h x u; do
-  for i in {3..9}; do
-    echo ./keen --generate 1 ${i}d${d}
-    perl -e 'alarm 30; exec @ARGV' ./keen --generate 5 ${i}d${d} >/dev/null \
-      || echo broken
-  done
-done
-
-     * Of course, it's better to do that after taking the exceptions
-     * _out_, so as to detect exceptions that should be removed as
-     * well as those which should be added.
-     */
-    if (w == 3 && diff > DIFF_NORMAL)
-	diff = DIFF_NORMAL;
-
-    grid = NULL;
+    latin_arena *arena;
+    struct keen_attempt_result *res = NULL;
 
     order = snewn(a, int);
     revorder = snewn(a, int);
@@ -940,321 +964,315 @@ done
     clues = snewn(a, long);
     cluevals = snewn(a, long);
     soln = snewn(a, digit);
+    arena = latin_arena_new(w);
 
-    while (1) {
-	/*
-	 * First construct a latin square to be the solution.
-	 */
-	sfree(grid);
-	grid = latin_generate(w, rs);
+    /*
+     * First construct a latin square to be the solution.
+     */
+    grid = latin_generate(w, rs);
 
-	/*
-	 * Divide the grid into arbitrarily sized blocks, but so as
-	 * to arrange plenty of dominoes which can be SUB/DIV clues.
-	 * We do this by first placing dominoes at random for a
-	 * while, then tying the remaining singletons one by one
-	 * into neighbouring blocks.
-	 */
-	for (i = 0; i < a; i++)
-	    order[i] = i;
-	shuffle(order, a, sizeof(*order), rs);
-	for (i = 0; i < a; i++)
-	    revorder[order[i]] = i;
+    /*
+     * Divide the grid into arbitrarily sized blocks, but so as
+     * to arrange plenty of dominoes which can be SUB/DIV clues.
+     * We do this by first placing dominoes at random for a
+     * while, then tying the remaining singletons one by one
+     * into neighbouring blocks.
+     */
+    for (i = 0; i < a; i++)
+	order[i] = i;
+    shuffle(order, a, sizeof(*order), rs);
+    for (i = 0; i < a; i++)
+	revorder[order[i]] = i;
 
-	for (i = 0; i < a; i++)
-	    singletons[i] = true;
+    for (i = 0; i < a; i++)
+	singletons[i] = true;
 
-	dsf_reinit(dsf);
+    dsf_reinit(dsf);
 
-	/* Place dominoes. */
-	for (i = 0; i < a; i++) {
-	    if (singletons[i]) {
-		int best = -1;
-
-		x = i % w;
-		y = i / w;
-
-		if (x > 0 && singletons[i-1] &&
-		    (best == -1 || revorder[i-1] < revorder[best]))
-		    best = i-1;
-		if (x+1 < w && singletons[i+1] &&
-		    (best == -1 || revorder[i+1] < revorder[best]))
-		    best = i+1;
-		if (y > 0 && singletons[i-w] &&
-		    (best == -1 || revorder[i-w] < revorder[best]))
-		    best = i-w;
-		if (y+1 < w && singletons[i+w] &&
-		    (best == -1 || revorder[i+w] < revorder[best]))
-		    best = i+w;
+    /* Place dominoes. */
+    for (i = 0; i < a; i++) {
+	if (singletons[i]) {
+	    int best = -1;
+
+	    x = i % w;
+	    y = i / w;
+
+	    if (x > 0 && singletons[i-1] &&
+		(best == -1 || revorder[i-1] < revorder[best]))
+		best = i-1;
+	    if (x+1 < w && singletons[i+1] &&
+		(best == -1 || revorder[i+1] < revorder[best]))
+		best = i+1;
+	    if (y > 0 && singletons[i-w] &&
+		(best == -1 || revorder[i-w] < revorder[best]))
+		best = i-w;
+	    if (y+1 < w && singletons[i+w] &&
+		(best == -1 || revorder[i+w] < revorder[best]))
+		best = i+w;
 
-		/*
-		 * When we find a potential domino, we place it with
-		 * probability 3/4, which seems to strike a decent
-		 * balance between plenty of dominoes and leaving
-		 * enough singletons to make interesting larger
-		 * shapes.
-		 */
-		if (best >= 0 && random_upto(rs, 4)) {
-		    singletons[i] = singletons[best] = false;
-		    dsf_merge(dsf, i, best);
-		}
+	    /*
+	     * When we find a potential domino, we place it with
+	     * probability 3/4, which seems to strike a decent
+	     * balance between plenty of dominoes and leaving
+	     * enough singletons to make interesting larger
+	     * shapes.
+	     */
+	    if (best >= 0 && random_upto(rs, 4)) {
+		singletons[i] = singletons[best] = false;
+		dsf_merge(dsf, i, best);
 	    }
 	}
+    }
 
-	/* Fold in singletons. */
-	for (i = 0; i < a; i++) {
-	    if (singletons[i]) {
-		int best = -1;
-
-		x = i % w;
-		y = i / w;
-
-		if (x > 0 && dsf_size(dsf, i-1) < MAXBLK &&
-		    (best == -1 || revorder[i-1] < revorder[best]))
-		    best = i-1;
-		if (x+1 < w && dsf_size(dsf, i+1) < MAXBLK &&
-		    (best == -1 || revorder[i+1] < revorder[best]))
-		    best = i+1;
-		if (y > 0 && dsf_size(dsf, i-w) < MAXBLK &&
-		    (best == -1 || revorder[i-w] < revorder[best]))
-		    best = i-w;
-		if (y+1 < w && dsf_size(dsf, i+w) < MAXBLK &&
-		    (best == -1 || revorder[i+w] < revorder[best]))
-		    best = i+w;
-
-		if (best >= 0) {
-		    singletons[i] = singletons[best] = false;
-		    dsf_merge(dsf, i, best);
-		}
+    /* Fold in singletons. */
+    for (i = 0; i < a; i++) {
+	if (singletons[i]) {
+	    int best = -1;
+
+	    x = i % w;
+	    y = i / w;
+
+	    if (x > 0 && dsf_size(dsf, i-1) < MAXBLK &&
+		(best == -1 || revorder[i-1] < revorder[best]))
+		best = i-1;
+	    if (x+1 < w && dsf_size(dsf, i+1) < MAXBLK &&
+		(best == -1 || revorder[i+1] < revorder[best]))
+		best = i+1;
+	    if (y > 0 && dsf_size(dsf, i-w) < MAXBLK &&
+		(best == -1 || revorder[i-w] < revorder[best]))
+		best = i-w;
+	    if (y+1 < w && dsf_size(dsf, i+w) < MAXBLK &&
+		(best == -1 || revorder[i+w] < revorder[best]))
+		best = i+w;
+
+	    if (best >= 0) {
+		singletons[i] = singletons[best] = false;
+		dsf_merge(dsf, i, best);
 	    }
 	}
+    }
 
-        /* Quit and start again if we have any singletons left over
-         * which we weren't able to do anything at all with. */
-	for (i = 0; i < a; i++)
-	    if (singletons[i])
-                break;
-        if (i < a)
-            continue;
+    /* Quit and start again if we have any singletons left over
+     * which we weren't able to do anything at all with. */
+    for (i = 0; i < a; i++)
+	if (singletons[i])
+	    break;
+    if (i < a)
+	goto out;
 
-	/*
-	 * Decide what would be acceptable clues for each block.
-	 *
-	 * Blocks larger than 2 have free choice of ADD or MUL;
-	 * blocks of size 2 can be anything in principle (except
-	 * that they can only be DIV if the two numbers have an
-	 * integer quotient, of course), but we rule out (or try to
-	 * avoid) some clues because they're of low quality.
-	 *
-	 * Hence, we iterate once over the grid, stopping at the first
-	 * element in every >2 block and the _last_ element of every
-	 * 2-block; the latter means that we can make our decision
-	 * about a 2-block in the knowledge of both numbers in it.
-	 *
-	 * We reuse the 'singletons' array (finished with in the
-	 * above loop) to hold information about which blocks are
-	 * suitable for what.
-	 */
+    /*
+     * Decide what would be acceptable clues for each block.
+     *
+     * Blocks larger than 2 have free choice of ADD or MUL;
+     * blocks of size 2 can be anything in principle (except
+     * that they can only be DIV if the two numbers have an
+     * integer quotient, of course), but we rule out (or try to
+     * avoid) some clues because they're of low quality.
+     *
+     * Hence, we iterate once over the grid, stopping at the first
+     * element in every >2 block and the _last_ element of every
+     * 2-block; the latter means that we can make our decision
+     * about a 2-block in the knowledge of both numbers in it.
+     *
+     * We reuse the 'singletons' array (finished with in the
+     * above loop) to hold information about which blocks are
+     * suitable for what.
+     */
 #define F_ADD     0x01
 #define F_SUB     0x02
 #define F_MUL     0x04
 #define F_DIV     0x08
 #define BAD_SHIFT 4
 
-	for (i = 0; i < a; i++) {
-	    singletons[i] = 0;
-	    j = dsf_minimal(dsf, i);
-	    k = dsf_size(dsf, j);
-	    if (params->multiplication_only)
-		singletons[j] = F_MUL;
-	    else if (j == i && k > 2) {
-		singletons[j] |= F_ADD | F_MUL;
-	    } else if (j != i && k == 2) {
-		/* Fetch the two numbers and sort them into order. */
-		int p = grid[j], q = grid[i], v;
-		if (p < q) {
-		    int t = p; p = q; q = t;
-		}
+    for (i = 0; i < a; i++) {
+	singletons[i] = 0;
+	j = dsf_minimal(dsf, i);
+	k = dsf_size(dsf, j);
+	if (params->multiplication_only)
+	    singletons[j] = F_MUL;
+	else if (j == i && k > 2) {
+	    singletons[j] |= F_ADD | F_MUL;
+	} else if (j != i && k == 2) {
+	    /* Fetch the two numbers and sort them into order. */
+	    int p = grid[j], q = grid[i], v;
+	    if (p < q) {
+		int t = p; p = q; q = t;
+	    }
 
-		/*
-		 * Addition clues are always allowed, but we try to
-		 * avoid sums of 3, 4, (2w-1) and (2w-2) if we can,
-		 * because they're too easy - they only leave one
-		 * option for the pair of numbers involved.
-		 */
-		v = p + q;
-		if (v > 4 && v < 2*w-2)
-		    singletons[j] |= F_ADD;
-                else
-		    singletons[j] |= F_ADD << BAD_SHIFT;
+	    /*
+	     * Addition clues are always allowed, but we try to
+	     * avoid sums of 3, 4, (2w-1) and (2w-2) if we can,
+	     * because they're too easy - they only leave one
+	     * option for the pair of numbers involved.
+	     */
+	    v = p + q;
+	    if (v > 4 && v < 2*w-2)
+		singletons[j] |= F_ADD;
+	    else
+		singletons[j] |= F_ADD << BAD_SHIFT;
 
-		/*
-		 * Multiplication clues: above Normal difficulty, we
-		 * prefer (but don't absolutely insist on) clues of
-		 * this type which leave multiple options open.
-		 */
-		v = p * q;
-		n = 0;
-		for (k = 1; k <= w; k++)
-		    if (v % k == 0 && v / k <= w && v / k != k)
-			n++;
-		if (n <= 2 && diff > DIFF_NORMAL)
-		    singletons[j] |= F_MUL << BAD_SHIFT;
-                else
-		    singletons[j] |= F_MUL;
+	    /*
+	     * Multiplication clues: above Normal difficulty, we
+	     * prefer (but don't absolutely insist on) clues of
+	     * this type which leave multiple options open.
+	     */
+	    v = p * q;
+	    n = 0;
+	    for (k = 1; k <= w; k++)
+		if (v % k == 0 && v / k <= w && v / k != k)
+		    n++;
+	    if (n <= 2 && diff > DIFF_NORMAL)
+		singletons[j] |= F_MUL << BAD_SHIFT;
+	    else
+		singletons[j] |= F_MUL;
 
-		/*
-		 * Subtraction: we completely avoid a difference of
-		 * w-1.
-		 */
-		v = p - q;
-		if (v < w-1)
-		    singletons[j] |= F_SUB;
+	    /*
+	     * Subtraction: we completely avoid a difference of
+	     * w-1.
+	     */
+	    v = p - q;
+	    if (v < w-1)
+		singletons[j] |= F_SUB;
 
-		/*
-		 * Division: for a start, the quotient must be an
-		 * integer or the clue type is impossible. Also, we
-		 * never use quotients strictly greater than w/2,
-		 * because they're not only too easy but also
-		 * inelegant.
-		 */
-		if (p % q == 0 && 2 * (p / q) <= w)
-		    singletons[j] |= F_DIV;
-	    }
+	    /*
+	     * Division: for a start, the quotient must be an
+	     * integer or the clue type is impossible. Also, we
+	     * never use quotients strictly greater than w/2,
+	     * because they're not only too easy but also
+	     * inelegant.
+	     */
+	    if (p % q == 0 && 2 * (p / q) <= w)
+		singletons[j] |= F_DIV;
 	}
+    }
 
-	/*
-	 * Actually choose a clue for each block, trying to keep the
-	 * numbers of each type even, and starting with the
-	 * preferred candidates for each type where possible.
-	 *
-	 * I'm sure there should be a faster algorithm for doing
-	 * this, but I can't be bothered: O(N^2) is good enough when
-	 * N is at most the number of dominoes that fits into a 9x9
-	 * square.
-	 */
-	shuffle(order, a, sizeof(*order), rs);
-	for (i = 0; i < a; i++)
-	    clues[i] = 0;
-	while (1) {
-	    bool done_something = false;
-
-	    for (k = 0; k < 4; k++) {
-		long clue;
-		int good, bad;
-		switch (k) {
-		  case 0:                clue = C_DIV; good = F_DIV; break;
-		  case 1:                clue = C_SUB; good = F_SUB; break;
-		  case 2:                clue = C_MUL; good = F_MUL; break;
-		  default /* case 3 */ : clue = C_ADD; good = F_ADD; break;
-		}
+    /*
+     * Actually choose a clue for each block, trying to keep the
+     * numbers of each type even, and starting with the
+     * preferred candidates for each type where possible.
+     *
+     * I'm sure there should be a faster algorithm for doing
+     * this, but I can't be bothered: O(N^2) is good enough when
+     * N is at most the number of dominoes that fits into a 9x9
+     * square.
+     */
+    shuffle(order, a, sizeof(*order), rs);
+    for (i = 0; i < a; i++)
+	clues[i] = 0;
+    while (1) {
+	bool done_something = false;
+
+	for (k = 0; k < 4; k++) {
+	    long clue;
+	    int good, bad;
+	    switch (k) {
+	      case 0:                clue = C_DIV; good = F_DIV; break;
+	      case 1:                clue = C_SUB; good = F_SUB; break;
+	      case 2:                clue = C_MUL; good = F_MUL; break;
+	      default /* case 3 */ : clue = C_ADD; good = F_ADD; break;
+	    }
 
+	    for (i = 0; i < a; i++) {
+		j = order[i];
+		if (singletons[j] & good) {
+		    clues[j] = clue;
+		    singletons[j] = 0;
+		    break;
+		}
+	    }
+	    if (i == a) {
+		/* didn't find a nice one, use a nasty one */
+		bad = good << BAD_SHIFT;
 		for (i = 0; i < a; i++) {
 		    j = order[i];
-		    if (singletons[j] & good) {
+		    if (singletons[j] & bad) {
 			clues[j] = clue;
 			singletons[j] = 0;
 			break;
 		    }
 		}
-		if (i == a) {
-		    /* didn't find a nice one, use a nasty one */
-                    bad = good << BAD_SHIFT;
-		    for (i = 0; i < a; i++) {
-			j = order[i];
-			if (singletons[j] & bad) {
-			    clues[j] = clue;
-			    singletons[j] = 0;
-			    break;
-			}
-		    }
-		}
-		if (i < a)
-		    done_something = true;
 	    }
-
-	    if (!done_something)
-		break;
+	    if (i < a)
+		done_something = true;
 	}
+
+	if (!done_something)
+	    break;
+    }
 #undef F_ADD
 #undef F_SUB
 #undef F_MUL
 #undef F_DIV
 #undef BAD_SHIFT
 
-	/*
-	 * Having chosen the clue types, calculate the clue values.
-	 */
-	for (i = 0; i < a; i++) {
-	    j = dsf_minimal(dsf, i);
-	    if (j == i) {
-		cluevals[j] = grid[i];
-	    } else {
-		switch (clues[j]) {
-		  case C_ADD:
-		    cluevals[j] += grid[i];
-		    break;
-		  case C_MUL:
-		    cluevals[j] *= grid[i];
-		    break;
-		  case C_SUB:
-		    cluevals[j] = labs(cluevals[j] - grid[i]);
-		    break;
-		  case C_DIV:
-		    {
-			int d1 = cluevals[j], d2 = grid[i];
-			if (d1 == 0 || d2 == 0)
-			    cluevals[j] = 0;
-			else
-			    cluevals[j] = d2/d1 + d1/d2;/* one is 0 :-) */
-		    }
-		    break;
+    /*
+     * Having chosen the clue types, calculate the clue values.
+     */
+    for (i = 0; i < a; i++) {
+	j = dsf_minimal(dsf, i);
+	if (j == i) {
+	    cluevals[j] = grid[i];
+	} else {
+	    switch (clues[j]) {
+	      case C_ADD:
+		cluevals[j] += grid[i];
+		break;
+	      case C_MUL:
+		cluevals[j] *= grid[i];
+		break;
+	      case C_SUB:
+		cluevals[j] = labs(cluevals[j] - grid[i]);
+		break;
+	      case C_DIV:
+		{
+		    int d1 = cluevals[j], d2 = grid[i];
+		    if (d1 == 0 || d2 == 0)
+			cluevals[j] = 0;
+		    else
+			cluevals[j] = d2/d1 + d1/d2;/* one is 0 :-) */
 		}
+		break;
 	    }
 	}
+    }
 
-	for (i = 0; i < a; i++) {
-	    j = dsf_minimal(dsf, i);
-	    if (j == i) {
-		clues[j] |= cluevals[j];
-	    }
+    for (i = 0; i < a; i++) {
+	j = dsf_minimal(dsf, i);
+	if (j == i) {
+	    clues[j] |= cluevals[j];
 	}
+    }
 
-	/*
-	 * See if the game can be solved at the specified difficulty
-	 * level, but not at the one below.
-	 */
-	if (diff > 0) {
-	    memset(soln, 0, a);
-	    ret = solver(w, dsf, clues, soln, diff-1);
-	    if (ret <= diff-1)
-		continue;
-	}
+    /*
+     * See if the game can be solved at the specified difficulty
+     * level, but not at the one below.
+     */
+    if (diff > 0) {
 	memset(soln, 0, a);
-	ret = solver(w, dsf, clues, soln, diff);
-	if (ret != diff)
-	    continue;		       /* go round again */
-
-	/*
-	 * I wondered if at this point it would be worth trying to
-	 * merge adjacent blocks together, to make the puzzle
-	 * gradually more difficult if it's currently easier than
-	 * specced, increasing the chance of a given generation run
-	 * being successful.
-	 *
-	 * It doesn't seem to be critical for the generation speed,
-	 * though, so for the moment I'm leaving it out.
-	 */
-
-	/*
-	 * We've got a usable puzzle!
-	 */
-	break;
+	ret = solver(w, dsf, clues, soln, diff-1, arena);
+	if (ret <= diff-1)
+	    goto out;
     }
+    memset(soln, 0, a);
+    ret = solver(w, dsf, clues, soln, diff, arena);
+    if (ret != diff)
+	goto out;
 
     /*
-     * Encode the puzzle description.
+     * I wondered if at this point it would be worth trying to
+     * merge adjacent blocks together, to make the puzzle
+     * gradually more difficult if it's currently easier than
+     * specced, increasing the chance of a given generation run
+     * being successful.
+     *
+     * It doesn't seem to be critical for the generation speed,
+     * though, so for the moment I'm leaving it out.
      */
+
+    /*
+     * We've got a usable puzzle! Encode the puzzle description.
+     */
+    res = snew(struct keen_attempt_result);
     desc = snewn(40*a, char);
     p = desc;
     p = encode_block_structure(p, w, dsf);
@@ -1272,18 +1290,19 @@ done
 	}
     }
     *p++ = '\0';
-    desc = sresize(desc, p - desc, char);
+    res->desc = sresize(desc, p - desc, char);
 
     /*
      * Encode the solution.
      */
     assert(memcmp(soln, grid, a) == 0);
-    *aux = snewn(a+2, char);
-    (*aux)[0] = 'S';
+    res->aux = snewn(a+2, char);
+    res->aux[0] = 'S';
     for (i = 0; i < a; i++)
-	(*aux)[i+1] = '0' + soln[i];
-    (*aux)[a+1] = '\0';
+	res->aux[i+1] = '0' + soln[i];
+    res->aux[a+1] = '\0';
 
+  out:
     sfree(grid);
     sfree(order);
     sfree(revorder);
@@ -1292,7 +1311,53 @@ done
     sfree(clues);
     sfree(cluevals);
     sfree(soln);
+    latin_arena_free(arena);
+
+    return res;
+}
+
+static char *new_game_desc(const game_params *params, random_state *rs,
+			   char **aux, bool interactive)
+{
+    int w = params->w;
+    int diff = params->diff;
+    struct keen_attempt_ctx ctx;
+    struct keen_attempt_result *res;
+    char *desc;
+
+    /*
+     * Difficulty exceptions: 3x3 puzzles at difficulty Hard or
+     * higher are currently not generable - the generator will spin
+     * forever looking for puzzles of the appropriate difficulty. We
+     * dial each of these down to the next lower difficulty.
+     *
+     * Remember to re-test this whenever a change is made to the
+     * solver logic!
+     *
+     * I tested it using the following shell command:
+
+for d in e n h x u; do
+  for i in {3..9}; do
+    echo ./keen --generate 1 ${i}d${d}
+    perl -e 'alarm 30; exec @ARGV' ./keen --generate 5 ${i}d${d} >/dev/null \
+      || echo broken
+  done
+done
+
+     * Of course, it's better to do that after taking the exceptions
+     * _out_, so as to detect exceptions that should be removed as
+     * well as those which should be added.
+     */
+    if (w == 3 && diff > DIFF_NORMAL)
+	diff = DIFF_NORMAL;
 
+    ctx.params = params;
+    ctx.diff = diff;
+    res = race_attempts(rs, keen_attempt, free_keen_attempt_result,
+                        &ctx, 0);
+    desc = res->desc;
+    *aux = res->aux;
+    sfree(res);
     return desc;
 }
 
@@ -1485,7 +1550,7 @@ static char *solve_game(const game_state *state, const game_state *currstate,
     memset(soln, 0, a);
 
     ret = solver(w, state->clues->dsf, state->clues->clues,
-		 soln, DIFFCOUNT-1);
+		 soln, DIFFCOUNT-1, NULL);
 
     if (ret == diff_impossible) {
 	*error = "No solution exists for this puzzle";
@@ -2527,6 +2592,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     false, NULL, NULL, /* can_format_as_text_now, text_format */
     get_prefs, set_prefs,
@@ -2613,7 +2679,7 @@ int main(int argc, char **argv)
     for (diff = 0; diff < DIFFCOUNT; diff++) {
 	memset(s->grid, 0, p->w * p->w);
 	ret = solver(p->w, s->clues->dsf, s->clues->clues,
-		     s->grid, diff);
+		     s->grid, diff, NULL);
 	if (ret <= diff)
 	    break;
     }
@@ -2633,7 +2699,7 @@ int main(int argc, char **argv)
 	    solver_show_working = really_show_working ? 1 : 0;
 	    memset(s->grid, 0, p->w * p->w);
 	    ret = solver(p->w, s->clues->dsf, s->clues->clues,
-			 s->grid, diff);
+			 s->grid, diff, NULL);
 	    if (ret != diff)
 		printf("Puzzle is inconsistent\n");
 	    else {
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 #include <stdarg.h>
 
@@ -20,12 +21,75 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
 			    int diff_simple, int diff_set_0, int diff_set_1,
 			    int diff_forcing, int diff_recursive,
 			    usersolver_t const *usersolvers, validator_t valid,
-                            void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree);
+                            void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree,
+                            ctxnew_t branchnew, ctxfree_t branchfree);
 
 #ifdef STANDALONE_SOLVER
 int solver_show_working, solver_recurse_depth;
 #endif
 
+#ifdef LATIN_BITSET
+#define LATIN_ONE ((latin_bits)1)
+
+void latin_solver_clear(struct latin_solver *solver, int pos)
+{
+    int o = solver->o, n = pos % o, xy = pos / o, x = xy / o, y = xy % o;
+
+    solver->cube[xy] &= ~(LATIN_ONE << n);
+    solver->rowbits[y*o+n] &= ~(LATIN_ONE << x);
+    solver->colbits[x*o+n] &= ~(LATIN_ONE << y);
+}
+
+/*
+ * The o positions start, start+step, ... as a word, bit i standing
+ * for start+i*step. Every line the solver looks along runs through
+ * one square's digits (step 1), one column (step o) or one row (step
+ * o*o) for a given digit, and each of those is a word already.
+ */
+static latin_bits latin_solver_line(struct latin_solver *solver,
+                                    int start, int step)
+{
+    int o = solver->o;
+
+    if (step == 1) {
+        assert(start % o == 0);
+        return solver->cube[start / o];
+    } else if (step == o) {
+        assert(start / o % o == 0);
+        return solver->colbits[start / (o*o) * o + start % o];
+    } else {
+        assert(step == o*o && start < o*o);
+        return solver->rowbits[start];
+    }
+}
+#endif
+
+/*
+ * The number of candidates left in a square, and (if there are
+ * exactly two) their sum.
+ */
+static int latin_solver_count(struct latin_solver *solver, int x, int y,
+                              int *sum)
+{
+    int o = solver->o, count;
+#ifdef LATIN_BITSET
+    latin_bits b = solver->cube[x*o+y];
+
+    count = setelim_popcount(b);
+    if (sum && count == 2)
+        *sum = setelim_ctz(b) + setelim_ctz(b & (b - 1)) + 2;
+#else
+    int t, n;
+
+    for (count = t = 0, n = 1; n <= o; n++)
+        if (cube(x, y, n))
+            count++, t += n;
+    if (sum)
+        *sum = t;
+#endif
+    return count;
+}
+
 /*
  * Function called when we are certain that a particular square has
  * a particular number in it. The y-coordinate passed in here is
@@ -38,6 +102,39 @@ void latin_solver_place(struct latin_solver *solver, int x, int y, int n)
     assert(n <= o);
     assert(cube(x,y,n));
 
+#ifdef LATIN_BITSET
+    /*
+     * The same three sets of eliminations as below, but a word at a
+     * time, keeping all three views of the cube in step.
+     */
+    {
+        latin_bits b;
+
+        for (b = solver->cube[x*o+y] & ~(LATIN_ONE << (n-1)); b;
+             b &= b - 1) {
+            i = setelim_ctz(b);
+            solver->rowbits[y*o+i] &= ~(LATIN_ONE << x);
+            solver->colbits[x*o+i] &= ~(LATIN_ONE << y);
+        }
+        solver->cube[x*o+y] = LATIN_ONE << (n-1);
+
+        for (b = solver->colbits[x*o+n-1] & ~(LATIN_ONE << y); b;
+             b &= b - 1) {
+            i = setelim_ctz(b);
+            solver->cube[x*o+i] &= ~(LATIN_ONE << (n-1));
+            solver->rowbits[i*o+n-1] &= ~(LATIN_ONE << x);
+        }
+        solver->colbits[x*o+n-1] = LATIN_ONE << y;
+
+        for (b = solver->rowbits[y*o+n-1] & ~(LATIN_ONE << x); b;
+             b &= b - 1) {
+            i = setelim_ctz(b);
+            solver->cube[i*o+y] &= ~(LATIN_ONE << (n-1));
+            solver->colbits[i*o+n-1] &= ~(LATIN_ONE << y);
+        }
+        solver->rowbits[y*o+n-1] = LATIN_ONE << x;
+    }
+#else
     /*
      * Rule out all other numbers in this square.
      */
@@ -58,6 +155,7 @@ void latin_solver_place(struct latin_solver *solver, int x, int y, int n)
     for (i = 0; i < o; i++)
 	if (i != x)
             cube(i,y,n) = false;
+#endif
 
     /*
      * Enter the number in the result grid.
@@ -81,12 +179,22 @@ int latin_solver_elim(struct latin_solver *solver, int start, int step
 #ifdef STANDALONE_SOLVER
     char **names = solver->names;
 #endif
-    int fpos, m, i;
+    int fpos, m;
+#ifndef LATIN_BITSET
+    int i;
+#endif
 
     /*
      * Count the number of set bits within this section of the
      * cube.
      */
+#ifdef LATIN_BITSET
+    {
+        latin_bits b = latin_solver_line(solver, start, step);
+        m = setelim_popcount(b);
+        fpos = m ? start + setelim_ctz(b) * step : -1;
+    }
+#else
     m = 0;
     fpos = -1;
     for (i = 0; i < o; i++)
@@ -94,6 +202,7 @@ int latin_solver_elim(struct latin_solver *solver, int start, int step
 	    fpos = start+i*step;
 	    m++;
 	}
+#endif
 
     if (m == 1) {
 	int x, y, n;
@@ -139,7 +248,9 @@ int latin_solver_elim(struct latin_solver *solver, int start, int step
 }
 
 struct latin_solver_scratch {
-    unsigned char *grid, *rowidx, *colidx, *set;
+    unsigned char *grid, *rowidx, *colidx;
+    setelim_bits *rows;
+    setelim *se;
     int *neighbours, *bfsqueue;
 #ifdef STANDALONE_SOLVER
     int *bfsprev;
@@ -159,10 +270,9 @@ int latin_solver_set(struct latin_solver *solver,
     char **names = solver->names;
 #endif
     int i, j, n, count;
-    unsigned char *grid = scratch->grid;
     unsigned char *rowidx = scratch->rowidx;
     unsigned char *colidx = scratch->colidx;
-    unsigned char *set = scratch->set;
+    setelim_bits *rows = scratch->rows, set, ok;
 
     /*
      * We are passed a o-by-o matrix of booleans. Our first job
@@ -174,9 +284,16 @@ int latin_solver_set(struct latin_solver *solver,
     memset(colidx, true, o);
     for (i = 0; i < o; i++) {
         int count = 0, first = -1;
+#ifdef LATIN_BITSET
+        latin_bits b = latin_solver_line(solver, start+i*step1, step2);
+        count = setelim_popcount(b);
+        if (count)
+            first = setelim_ctz(b);
+#else
         for (j = 0; j < o; j++)
             if (solver->cube[start+i*step1+j*step2])
                 first = j, count++;
+#endif
 
 	if (count == 0) return -1;
         if (count == 1)
@@ -197,142 +314,114 @@ int latin_solver_set(struct latin_solver *solver,
     assert(n == j);
 
     /*
-     * And create the smaller matrix.
+     * And create the smaller matrix, a word per row.
      */
-    for (i = 0; i < n; i++)
+    for (i = 0; i < n; i++) {
+#ifdef LATIN_BITSET
+        latin_bits b = latin_solver_line(solver, start+rowidx[i]*step1,
+                                         step2);
+#endif
+        rows[i] = 0;
         for (j = 0; j < n; j++)
-            grid[i*o+j] = solver->cube[start+rowidx[i]*step1+colidx[j]*step2];
+#ifdef LATIN_BITSET
+            if (b & ((latin_bits)1 << colidx[j]))
+#else
+            if (solver->cube[start+rowidx[i]*step1+colidx[j]*step2])
+#endif
+                rows[i] |= (setelim_bits)1 << j;
+    }
 
     /*
      * Having done that, we now have a matrix in which every row
      * has at least two 1s in. Now we search to see if we can find
      * a rectangle of zeroes (in the set-theoretic sense of
      * `rectangle', i.e. a subset of rows crossed with a subset of
-     * columns) whose width and height add up to n.
+     * columns) whose width and height add up to n. setelim_next
+     * hands us each set of columns for which there are at least
+     * enough rows.
      */
+    setelim_start(scratch->se, n, rows);
+    while (setelim_next(scratch->se, &set, &ok)) {
+        bool progress = false;
+
+        count = setelim_popcount(set);
 
-    memset(set, 0, n);
-    count = 0;
-    while (1) {
         /*
-         * We have a candidate set. If its size is <=1 or >=n-1
-         * then we move on immediately.
+         * We expect never to be able to get _more_ than n-count
+         * suitable rows: this would imply that (for example) there
+         * are four numbers which between them have at most three
+         * possible positions, and hence it indicates a faulty
+         * deduction before this point or even a bogus clue.
          */
-        if (count > 1 && count < n-1) {
-            /*
-             * The number of rows we need is n-count. See if we can
-             * find that many rows which each have a zero in all
-             * the positions listed in `set'.
-             */
-            int rows = 0;
-            for (i = 0; i < n; i++) {
-                bool ok = true;
-                for (j = 0; j < n; j++)
-                    if (set[j] && grid[i*o+j]) {
-                        ok = false;
-                        break;
-                    }
-                if (ok)
-                    rows++;
-            }
-
-            /*
-             * We expect never to be able to get _more_ than
-             * n-count suitable rows: this would imply that (for
-             * example) there are four numbers which between them
-             * have at most three possible positions, and hence it
-             * indicates a faulty deduction before this point or
-             * even a bogus clue.
-             */
-            if (rows > n - count) {
+        if (setelim_popcount(ok) > n - count) {
 #ifdef STANDALONE_SOLVER
-		if (solver_show_working) {
-		    va_list ap;
-		    printf("%*s", solver_recurse_depth*4,
-			   "");
-		    va_start(ap, fmt);
-		    vprintf(fmt, ap);
-		    va_end(ap);
-		    printf(":\n%*s  contradiction reached\n",
-			   solver_recurse_depth*4, "");
-		}
+            if (solver_show_working) {
+                va_list ap;
+                printf("%*s", solver_recurse_depth*4,
+                       "");
+                va_start(ap, fmt);
+                vprintf(fmt, ap);
+                va_end(ap);
+                printf(":\n%*s  contradiction reached\n",
+                       solver_recurse_depth*4, "");
+            }
 #endif
-		return -1;
-	    }
-
-            if (rows >= n - count) {
-                bool progress = false;
+            return -1;
+        }
 
-                /*
-                 * We've got one! Now, for each row which _doesn't_
-                 * satisfy the criterion, eliminate all its set
-                 * bits in the positions _not_ listed in `set'.
-                 * Return +1 (meaning progress has been made) if we
-                 * successfully eliminated anything at all.
-                 *
-                 * This involves referring back through
-                 * rowidx/colidx in order to work out which actual
-                 * positions in the cube to meddle with.
-                 */
-                for (i = 0; i < n; i++) {
-                    bool ok = true;
-                    for (j = 0; j < n; j++)
-                        if (set[j] && grid[i*o+j]) {
-                            ok = false;
-                            break;
-                        }
-                    if (!ok) {
-                        for (j = 0; j < n; j++)
-                            if (!set[j] && grid[i*o+j]) {
-                                int fpos = (start+rowidx[i]*step1+
-                                            colidx[j]*step2);
-#ifdef STANDALONE_SOLVER
-                                if (solver_show_working) {
-                                    int px, py, pn;
-
-                                    if (!progress) {
-                                        va_list ap;
-					printf("%*s", solver_recurse_depth*4,
-					       "");
-                                        va_start(ap, fmt);
-                                        vprintf(fmt, ap);
-                                        va_end(ap);
-                                        printf(":\n");
-                                    }
+        /*
+         * We've got one! Now, for each row which _doesn't_ satisfy
+         * the criterion, eliminate all its set bits in the
+         * positions _not_ listed in `set'. Return +1 (meaning
+         * progress has been made) if we successfully eliminated
+         * anything at all.
+         *
+         * This involves referring back through rowidx/colidx in
+         * order to work out which actual positions in the cube to
+         * meddle with.
+         */
+        for (i = 0; i < n; i++) {
+            setelim_bits elim;
 
-                                    pn = 1 + fpos % o;
-                                    py = fpos / o;
-                                    px = py / o;
-                                    py %= o;
+            if (ok & ((setelim_bits)1 << i))
+                continue;
+            for (elim = rows[i] & ~set; elim; elim &= elim - 1) {
+                int fpos;
 
-                                    printf("%*s  ruling out %s at (%d,%d)\n",
-					   solver_recurse_depth*4, "",
-                                           names[pn-1], px+1, py+1);
-                                }
-#endif
-                                progress = true;
-                                solver->cube[fpos] = false;
-                            }
+                j = setelim_ctz(elim);
+                fpos = start+rowidx[i]*step1+colidx[j]*step2;
+#ifdef STANDALONE_SOLVER
+                if (solver_show_working) {
+                    int px, py, pn;
+
+                    if (!progress) {
+                        va_list ap;
+                        printf("%*s", solver_recurse_depth*4,
+                               "");
+                        va_start(ap, fmt);
+                        vprintf(fmt, ap);
+                        va_end(ap);
+                        printf(":\n");
                     }
-                }
 
-                if (progress) {
-                    return +1;
+                    pn = 1 + fpos % o;
+                    py = fpos / o;
+                    px = py / o;
+                    py %= o;
+
+                    printf("%*s  ruling out %s at (%d,%d)\n",
+                           solver_recurse_depth*4, "",
+                           names[pn-1], px+1, py+1);
                 }
+#endif
+                progress = true;
+                cubeat_clear(fpos);
             }
         }
 
-        /*
-         * Binary increment: change the rightmost 0 to a 1, and
-         * change all 1s to the right of it to 0s.
-         */
-        i = n;
-        while (i > 0 && set[i-1])
-            set[--i] = 0, count--;
-        if (i > 0)
-            set[--i] = 1, count++;
-        else
-            break;                     /* done */
+        if (progress) {
+            return +1;
+        }
     }
 
     return 0;
@@ -402,9 +491,7 @@ int latin_solver_forcing(struct latin_solver *solver,
              * `the other one' (since we will shortly know there
              * are exactly two).
              */
-            for (count = t = 0, n = 1; n <= o; n++)
-                if (cube(x, y, n))
-                    count++, t += n;
+            count = latin_solver_count(solver, x, y, &t);
             if (count != 2)
                 continue;
 
@@ -450,7 +537,7 @@ int latin_solver_forcing(struct latin_solver *solver,
                          * Try visiting each of those neighbours.
                          */
                         for (i = 0; i < nneighbours; i++) {
-                            int cc, tt, nn;
+                            int cc, tt;
 
                             xt = neighbours[i] % o;
                             yt = neighbours[i] / o;
@@ -477,9 +564,7 @@ int latin_solver_forcing(struct latin_solver *solver,
                              * this square to have exactly two
                              * possible numbers.
                              */
-                            for (cc = tt = 0, nn = 1; nn <= o; nn++)
-                                if (cube(xt, yt, nn))
-                                    cc++, tt += nn;
+                            cc = latin_solver_count(solver, xt, yt, &tt);
                             if (cc == 2) {
                                 bfsqueue[tail++] = yt*o+xt;
 #ifdef STANDALONE_SOLVER
@@ -522,7 +607,7 @@ int latin_solver_forcing(struct latin_solver *solver,
 					   xt+1, yt+1);
                                 }
 #endif
-                                cube(xt, yt, orign) = false;
+                                cube_clear(xt, yt, orign);
                                 return 1;
                             }
                         }
@@ -533,14 +618,14 @@ int latin_solver_forcing(struct latin_solver *solver,
     return 0;
 }
 
-struct latin_solver_scratch *latin_solver_new_scratch(struct latin_solver *solver)
+static struct latin_solver_scratch *latin_scratch_new(int o)
 {
     struct latin_solver_scratch *scratch = snew(struct latin_solver_scratch);
-    int o = solver->o;
     scratch->grid = snewn(o*o, unsigned char);
     scratch->rowidx = snewn(o, unsigned char);
     scratch->colidx = snewn(o, unsigned char);
-    scratch->set = snewn(o, unsigned char);
+    scratch->rows = snewn(o, setelim_bits);
+    scratch->se = setelim_new(o);
     scratch->neighbours = snewn(3*o, int);
     scratch->bfsqueue = snewn(o*o, int);
 #ifdef STANDALONE_SOLVER
@@ -549,6 +634,11 @@ struct latin_solver_scratch *latin_solver_new_scratch(struct latin_solver *solve
     return scratch;
 }
 
+struct latin_solver_scratch *latin_solver_new_scratch(struct latin_solver *solver)
+{
+    return latin_scratch_new(solver->o);
+}
+
 void latin_solver_free_scratch(struct latin_solver_scratch *scratch)
 {
 #ifdef STANDALONE_SOLVER
@@ -556,24 +646,166 @@ void latin_solver_free_scratch(struct latin_solver_scratch *scratch)
 #endif
     sfree(scratch->bfsqueue);
     sfree(scratch->neighbours);
-    sfree(scratch->set);
+    setelim_free(scratch->se);
+    sfree(scratch->rows);
     sfree(scratch->colidx);
     sfree(scratch->rowidx);
     sfree(scratch->grid);
     sfree(scratch);
 }
 
-bool latin_solver_alloc(struct latin_solver *solver, digit *grid, int o)
+/*
+ * The arrays a solver allocates for itself.
+ */
+static void latin_solver_alloc_storage(struct latin_solver *solver, int o)
+{
+#ifdef LATIN_BITSET
+    assert(o <= (int)(sizeof(latin_bits) * CHAR_BIT));
+    solver->cube = snewn(o*o, latin_bits);
+    solver->rowbits = snewn(o*o, latin_bits);
+    solver->colbits = snewn(o*o, latin_bits);
+#else
+    solver->cube = snewn(o*o*o, unsigned char);
+#endif
+    solver->row = snewn(o*o, unsigned char);
+    solver->col = snewn(o*o, unsigned char);
+}
+
+static void latin_solver_free_storage(struct latin_solver *solver)
+{
+    sfree(solver->cube);
+#ifdef LATIN_BITSET
+    sfree(solver->rowbits);
+    sfree(solver->colbits);
+#endif
+    sfree(solver->row);
+    sfree(solver->col);
+}
+
+/*
+ * One level of an arena: the storage for a solver at that depth of
+ * recursion, and the working space latin_solver_recurse uses there.
+ */
+struct latin_arena_level {
+    struct latin_solver store;         /* only the storage pointers */
+    struct latin_solver_scratch *scratch;
+    digit *list, *ingrid, *outgrid;
+};
+
+struct latin_arena {
+    int o;
+    struct latin_arena_level *levels;
+    int nlevels, levelsize;
+    long allocs;
+    /*
+     * In a thread searching one branch of a parallel recursion (see
+     * latin_branches_run), the search it's part of and which branch.
+     */
+    struct latin_branches *branches;
+    int branch;
+};
+
+latin_arena *latin_arena_new(int o)
+{
+    latin_arena *arena = snew(latin_arena);
+    arena->o = o;
+    arena->levels = NULL;
+    arena->nlevels = arena->levelsize = 0;
+    arena->allocs = 0;
+    arena->branches = NULL;
+    arena->branch = 0;
+    return arena;
+}
+
+void latin_arena_free(latin_arena *arena)
+{
+    int i;
+
+    if (!arena)
+        return;
+    for (i = 0; i < arena->nlevels; i++) {
+        struct latin_arena_level *lev = &arena->levels[i];
+        latin_solver_free_storage(&lev->store);
+        latin_solver_free_scratch(lev->scratch);
+        sfree(lev->list);
+        sfree(lev->ingrid);
+        sfree(lev->outgrid);
+    }
+    sfree(arena->levels);
+    sfree(arena);
+}
+
+long latin_arena_allocs(const latin_arena *arena)
+{
+    return arena->allocs;
+}
+
+/*
+ * Find the level for a given depth, making it (and any above it) if
+ * this is the deepest the arena has been. The levels array can move
+ * as it grows, so callers shouldn't keep the pointer across anything
+ * that might go deeper.
+ */
+static struct latin_arena_level *latin_arena_level(latin_arena *arena,
+                                                   int depth)
+{
+    int o = arena->o;
+
+    if (depth >= arena->levelsize) {
+        arena->levelsize = depth * 5 / 4 + 8;
+        arena->levels = sresize(arena->levels, arena->levelsize,
+                                struct latin_arena_level);
+        arena->allocs++;
+    }
+    while (arena->nlevels <= depth) {
+        struct latin_arena_level *lev = &arena->levels[arena->nlevels++];
+        latin_solver_alloc_storage(&lev->store, o);
+        lev->scratch = latin_scratch_new(o);
+        lev->list = snewn(o, digit);
+        lev->ingrid = snewn(o*o, digit);
+        lev->outgrid = snewn(o*o, digit);
+        arena->allocs++;
+    }
+    return &arena->levels[depth];
+}
+
+/*
+ * Set up a solver whose storage is an arena's level for the given
+ * depth, or (with no arena) newly allocated.
+ */
+static bool latin_solver_alloc_level(struct latin_solver *solver,
+                                     digit *grid, int o,
+                                     latin_arena *arena, int depth)
 {
     int x, y;
 
     solver->o = o;
-    solver->cube = snewn(o*o*o, unsigned char);
-    solver->grid = grid;		/* write straight back to the input */
+    solver->arena = arena;
+    solver->depth = depth;
+    if (arena) {
+        const struct latin_solver *store;
+        assert(arena->o == o);
+        store = &latin_arena_level(arena, depth)->store;
+        solver->cube = store->cube;
+#ifdef LATIN_BITSET
+        solver->rowbits = store->rowbits;
+        solver->colbits = store->colbits;
+#endif
+        solver->row = store->row;
+        solver->col = store->col;
+    } else {
+        latin_solver_alloc_storage(solver, o);
+    }
+
+#ifdef LATIN_BITSET
+    for (x = 0; x < o*o; x++)
+        solver->cube[x] = solver->rowbits[x] = solver->colbits[x] =
+            ((latin_bits)2 << (o-1)) - 1;
+#else
     memset(solver->cube, 1, o*o*o);
+#endif
+    solver->grid = grid;		/* write straight back to the input */
 
-    solver->row = snewn(o*o, unsigned char);
-    solver->col = snewn(o*o, unsigned char);
     memset(solver->row, 0, o*o);
     memset(solver->col, 0, o*o);
 
@@ -596,11 +828,21 @@ bool latin_solver_alloc(struct latin_solver *solver, digit *grid, int o)
     return true;
 }
 
+bool latin_solver_alloc(struct latin_solver *solver, digit *grid, int o)
+{
+    return latin_solver_alloc_level(solver, grid, o, NULL, 0);
+}
+
+bool latin_solver_alloc_arena(struct latin_solver *solver, digit *grid,
+                              int o, latin_arena *arena)
+{
+    return latin_solver_alloc_level(solver, grid, o, arena, 0);
+}
+
 void latin_solver_free(struct latin_solver *solver)
 {
-    sfree(solver->cube);
-    sfree(solver->row);
-    sfree(solver->col);
+    if (!solver->arena)
+        latin_solver_free_storage(solver);
 }
 
 int latin_solver_diff_simple(struct latin_solver *solver)
@@ -707,6 +949,203 @@ int latin_solver_diff_set(struct latin_solver *solver,
     return 0;
 }
 
+static void latin_solver_show_cube(struct latin_solver *solver)
+{
+#ifdef STANDALONE_SOLVER
+    if (solver_show_working > 1) {
+        int o = solver->o;
+        unsigned char *cube = snewn(o*o*o, unsigned char);
+        latin_solver_get_cube(solver, cube);
+        latin_solver_debug(cube, o);
+        sfree(cube);
+    }
+#endif
+}
+
+#ifndef STANDALONE_SOLVER
+/*
+ * Parallel recursion. If the front end has lent us threads (see
+ * struct parallel_runner), a recursion with enough of the grid still
+ * to fill has its branches searched at once, each thread claiming the
+ * next branch not yet started and searching it with an arena of its
+ * own. The results are then combined in branch order exactly as the
+ * serial loop would, so the answer and difficulty don't change.
+ *
+ * The serial loop stops at the first branch that takes it to two
+ * solutions, so once the branches finished so far show that point
+ * can't be later than some branch, nothing beyond it is worth
+ * searching: cutoff drops to just past it, no more branches from
+ * there on are started, and any in progress give up at their next
+ * guess. Every guess checks for that, so if the runner has atomics
+ * the check reads a copy of cutoff kept in one, instead of taking
+ * the lock each time.
+ *
+ * This is left out of the standalone solvers, whose -v output follows
+ * the serial search step by step.
+ *
+ * Handing branches to other threads costs some tens of microseconds
+ * (waking them, plus an arena each). Timing the serial search across
+ * the hardest Keen, Towers and Unequal presets, a recursion with 30
+ * or more empty squares took 200us or more on average, while with
+ * under 20 most took less than 100us, so below 30 the hand-off would
+ * eat much of whatever the extra threads saved.
+ */
+#define LATIN_PARALLEL_MIN_EMPTY 30
+
+struct latin_branches {
+    const struct parallel_runner *pr;
+    int o, x, y, n;
+    const digit *list, *ingrid;
+    int diff_simple, diff_set_0, diff_set_1, diff_forcing, diff_recursive;
+    usersolver_t const *usersolvers;
+    validator_t valid;
+    void *ctx;
+    ctxnew_t ctxnew, branchnew;
+    ctxfree_t ctxfree, branchfree;
+    digit *grids;                      /* the grid each branch ends with */
+    void *shared_cutoff;               /* atomic copy of cutoff, or NULL */
+
+    void *lock;                        /* protects everything below */
+    int next;                          /* next branch not yet claimed */
+    int cutoff;                        /* branches from here on not needed */
+    int *rets;                         /* each branch's result, or -1 */
+};
+
+static void latin_branches_update_cutoff(struct latin_branches *br)
+{
+    int i, nsols = 0;
+
+    for (i = 0; i < br->cutoff; i++) {
+        if (br->rets[i] == diff_ambiguous)
+            nsols += 2;
+        else if (br->rets[i] >= 0 && br->rets[i] != diff_impossible)
+            nsols++;
+        if (nsols >= 2) {
+            br->cutoff = i+1;
+            if (br->shared_cutoff)
+                br->pr->atomic_set(br->shared_cutoff, br->cutoff);
+            break;
+        }
+    }
+}
+
+static bool latin_branch_cancelled(latin_arena *arena)
+{
+    struct latin_branches *br = arena->branches;
+    bool ret;
+
+    if (!br)
+        return false;
+    if (br->shared_cutoff)
+        return arena->branch >= br->pr->atomic_get(br->shared_cutoff);
+    br->pr->lock(br->lock);
+    ret = arena->branch >= br->cutoff;
+    br->pr->unlock(br->lock);
+    return ret;
+}
+
+static void latin_branch_worker(void *vbr)
+{
+    struct latin_branches *br = (struct latin_branches *)vbr;
+    const struct parallel_runner *pr = br->pr;
+    int o = br->o;
+    latin_arena *arena = latin_arena_new(o);
+
+    arena->branches = br;
+    pr->lock(br->lock);
+    while (br->next < br->n && br->next < br->cutoff) {
+        int k = br->next++, ret;
+        digit *grid = br->grids + k*o*o;
+        struct latin_solver subsolver;
+        void *newctx;
+
+        pr->unlock(br->lock);
+
+        arena->branch = k;
+        memcpy(grid, br->ingrid, o*o);
+        grid[br->y*o+br->x] = br->list[k];
+        /*
+         * A branch needs a context of its own if the serial search
+         * would give it one, or (branchnew) just because it's running
+         * alongside others.
+         */
+        if (br->ctxnew)
+            newctx = br->ctxnew(br->ctx);
+        else if (br->branchnew)
+            newctx = br->branchnew(br->ctx);
+        else
+            newctx = br->ctx;
+        if (latin_solver_alloc_level(&subsolver, grid, o, arena, 0)) {
+            ret = latin_solver_top(&subsolver, br->diff_recursive,
+                                   br->diff_simple, br->diff_set_0,
+                                   br->diff_set_1, br->diff_forcing,
+                                   br->diff_recursive, br->usersolvers,
+                                   br->valid, newctx,
+                                   br->ctxnew, br->ctxfree,
+                                   br->branchnew, br->branchfree);
+        } else {
+            ret = diff_impossible;
+        }
+        latin_solver_free(&subsolver);
+        if (br->ctxnew)
+            br->ctxfree(newctx);
+        else if (br->branchnew)
+            br->branchfree(newctx);
+
+        pr->lock(br->lock);
+        br->rets[k] = ret;
+        latin_branches_update_cutoff(br);
+    }
+    pr->unlock(br->lock);
+
+    latin_arena_free(arena);
+}
+
+/*
+ * Search all the branches and combine them into the serial loop's
+ * verdict, leaving the first solution found in solver->grid.
+ */
+static int latin_branches_run(struct latin_branches *br,
+                              struct latin_solver *solver)
+{
+    const struct parallel_runner *pr = br->pr;
+    int o = br->o, i, diff = diff_impossible;
+
+    br->grids = snewn(br->n * o*o, digit);
+    br->rets = snewn(br->n, int);
+    for (i = 0; i < br->n; i++)
+        br->rets[i] = -1;
+    br->next = 0;
+    br->cutoff = br->n;
+    br->shared_cutoff = pr->atomic_new ? pr->atomic_new(br->n) : NULL;
+    br->lock = pr->lock_new();
+
+    pr->run(latin_branch_worker, br, min(pr->nworkers, br->n));
+
+    for (i = 0; i < br->cutoff; i++) {
+        int ret = br->rets[i];
+
+        assert(ret >= 0 && ret != diff_unfinished);
+        if (diff == diff_impossible && ret != diff_impossible)
+            memcpy(solver->grid, br->grids + i*o*o, o*o);
+        if (ret == diff_ambiguous)
+            diff = diff_ambiguous;
+        else if (ret != diff_impossible)
+            diff = (diff == diff_impossible ? br->diff_recursive :
+                    diff_ambiguous);
+        if (diff == diff_ambiguous)
+            break;
+    }
+
+    pr->lock_free(br->lock);
+    if (br->shared_cutoff)
+        pr->atomic_free(br->shared_cutoff);
+    sfree(br->grids);
+    sfree(br->rets);
+    return diff;
+}
+#endif
+
 /*
  * Returns:
  * 0 for 'didn't do anything' implying it was already solved.
@@ -721,9 +1160,10 @@ static int latin_solver_recurse
     (struct latin_solver *solver, int diff_simple, int diff_set_0,
      int diff_set_1, int diff_forcing, int diff_recursive,
      usersolver_t const *usersolvers, validator_t valid, void *ctx,
-     ctxnew_t ctxnew, ctxfree_t ctxfree)
+     ctxnew_t ctxnew, ctxfree_t ctxfree, ctxnew_t branchnew,
+     ctxfree_t branchfree)
 {
-    int best, bestcount;
+    int best, bestcount, nempty = 0;
     int o = solver->o, x, y, n;
 #ifdef STANDALONE_SOLVER
     char **names = solver->names;
@@ -741,16 +1181,14 @@ static int latin_solver_recurse
                  * An unfilled square. Count the number of
                  * possible digits in it.
                  */
-                count = 0;
-                for (n = 1; n <= o; n++)
-                    if (cube(x,y,n))
-                        count++;
+                count = latin_solver_count(solver, x, y, NULL);
 
                 /*
                  * We should have found any impossibilities
                  * already, so this can safely be an assert.
                  */
                 assert(count > 1);
+                nempty++;
 
                 if (count < bestcount) {
                     bestcount = count;
@@ -765,6 +1203,11 @@ static int latin_solver_recurse
         int i, j;
         digit *list, *ingrid, *outgrid;
         int diff = diff_impossible;    /* no solution found yet */
+        latin_arena *arena = solver->arena, *ownarena = NULL;
+        struct latin_arena_level *lev;
+#ifndef STANDALONE_SOLVER
+        const struct parallel_runner *pr = get_parallel_runner();
+#endif
 
         /*
          * Attempt recursion.
@@ -772,9 +1215,17 @@ static int latin_solver_recurse
         y = best / o;
         x = best % o;
 
-        list = snewn(o, digit);
-        ingrid = snewn(o*o, digit);
-        outgrid = snewn(o*o, digit);
+        /*
+         * Our working space and the solvers we recurse into all come
+         * from the arena, one level further down each time. If we
+         * weren't given one, make one for the whole of this search.
+         */
+        if (!arena)
+            arena = ownarena = latin_arena_new(o);
+        lev = latin_arena_level(arena, solver->depth);
+        list = lev->list;
+        ingrid = lev->ingrid;
+        outgrid = lev->outgrid;
         memcpy(ingrid, solver->grid, o*o);
 
         /* Make a list of the possible digits. */
@@ -795,6 +1246,41 @@ static int latin_solver_recurse
         }
 #endif
 
+#ifndef STANDALONE_SOLVER
+        /*
+         * Worth farming the branches out to other threads, if we have
+         * any, we aren't in one already, and each branch can have a
+         * context of its own (or none).
+         */
+        if (pr && pr->nworkers > 1 && j > 1 && !arena->branches &&
+            nempty >= LATIN_PARALLEL_MIN_EMPTY &&
+            (ctxnew || branchnew || !ctx)) {
+            struct latin_branches br;
+
+            br.pr = pr;
+            br.o = o;
+            br.x = x;
+            br.y = y;
+            br.n = j;
+            br.list = list;
+            br.ingrid = ingrid;
+            br.diff_simple = diff_simple;
+            br.diff_set_0 = diff_set_0;
+            br.diff_set_1 = diff_set_1;
+            br.diff_forcing = diff_forcing;
+            br.diff_recursive = diff_recursive;
+            br.usersolvers = usersolvers;
+            br.valid = valid;
+            br.ctx = ctx;
+            br.ctxnew = ctxnew;
+            br.ctxfree = ctxfree;
+            br.branchnew = branchnew;
+            br.branchfree = branchfree;
+            diff = latin_branches_run(&br, solver);
+            j = 0;                     /* nothing left for the loop below */
+        }
+#endif
+
         /*
          * And step along the list, recursing back into the
          * main solver at every stage.
@@ -804,6 +1290,17 @@ static int latin_solver_recurse
 	    void *newctx;
 	    struct latin_solver subsolver;
 
+#ifndef STANDALONE_SOLVER
+            /*
+             * If this search is part of a branch the parallel search
+             * has stopped needing, its result no longer matters.
+             */
+            if (latin_branch_cancelled(arena)) {
+                diff = diff_impossible;
+                break;
+            }
+#endif
+
             memcpy(outgrid, ingrid, o*o);
             outgrid[y*o+x] = list[i];
 
@@ -819,7 +1316,8 @@ static int latin_solver_recurse
 	    } else {
 		newctx = ctx;
 	    }
-	    if (latin_solver_alloc(&subsolver, outgrid, o)) {
+	    if (latin_solver_alloc_level(&subsolver, outgrid, o, arena,
+                                         solver->depth + 1)) {
 #ifdef STANDALONE_SOLVER
                 subsolver.names = solver->names;
 #endif
@@ -827,7 +1325,7 @@ static int latin_solver_recurse
                                        diff_simple, diff_set_0, diff_set_1,
                                        diff_forcing, diff_recursive,
                                        usersolvers, valid, newctx,
-                                       ctxnew, ctxfree);
+                                       ctxnew, ctxfree, branchnew, branchfree);
             } else {
                 ret = diff_impossible;
             }
@@ -874,9 +1372,7 @@ static int latin_solver_recurse
                 break;
         }
 
-        sfree(outgrid);
-        sfree(ingrid);
-        sfree(list);
+        latin_arena_free(ownarena);
 
         if (diff == diff_impossible)
             return -1;
@@ -893,11 +1389,17 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
 			    int diff_simple, int diff_set_0, int diff_set_1,
 			    int diff_forcing, int diff_recursive,
 			    usersolver_t const *usersolvers, validator_t valid,
-                            void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree)
+                            void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree,
+                            ctxnew_t branchnew, ctxfree_t branchfree)
 {
-    struct latin_solver_scratch *scratch = latin_solver_new_scratch(solver);
+    struct latin_solver_scratch *scratch;
     int ret, diff = diff_simple;
 
+    if (solver->arena)
+        scratch = latin_arena_level(solver->arena, solver->depth)->scratch;
+    else
+        scratch = latin_solver_new_scratch(solver);
+
     assert(maxdiff <= diff_recursive);
     /*
      * Now loop over the grid repeatedly trying all permitted modes
@@ -911,7 +1413,7 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
 
 	cont:
 
-        latin_solver_debug(solver->cube, solver->o);
+        latin_solver_show_cube(solver);
 
 	for (i = 0; i <= maxdiff; i++) {
 	    if (usersolvers[i])
@@ -954,8 +1456,8 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
         int nsol = latin_solver_recurse(solver,
 					diff_simple, diff_set_0, diff_set_1,
 					diff_forcing, diff_recursive,
-					usersolvers, valid, ctx,
-                                        ctxnew, ctxfree);
+					usersolvers, valid, ctx, ctxnew,
+                                        ctxfree, branchnew, branchfree);
         if (nsol < 0) diff = diff_impossible;
         else if (nsol == 1) diff = diff_recursive;
         else if (nsol > 1) diff = diff_ambiguous;
@@ -1015,7 +1517,8 @@ static int latin_solver_top(struct latin_solver *solver, int maxdiff,
         diff = diff_impossible;
     }
 
-    latin_solver_free_scratch(scratch);
+    if (!solver->arena)
+        latin_solver_free_scratch(scratch);
 
     return diff;
 }
@@ -1024,7 +1527,8 @@ int latin_solver_main(struct latin_solver *solver, int maxdiff,
 		      int diff_simple, int diff_set_0, int diff_set_1,
 		      int diff_forcing, int diff_recursive,
 		      usersolver_t const *usersolvers, validator_t valid,
-                      void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree)
+                      void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree,
+                      ctxnew_t branchnew, ctxfree_t branchfree)
 {
     int diff;
 #ifdef STANDALONE_SOLVER
@@ -1052,7 +1556,8 @@ int latin_solver_main(struct latin_solver *solver, int maxdiff,
     diff = latin_solver_top(solver, maxdiff,
 			    diff_simple, diff_set_0, diff_set_1,
 			    diff_forcing, diff_recursive,
-			    usersolvers, valid, ctx, ctxnew, ctxfree);
+			    usersolvers, valid, ctx, ctxnew, ctxfree,
+			    branchnew, branchfree);
 
 #ifdef STANDALONE_SOLVER
     sfree(names);
@@ -1062,20 +1567,22 @@ int latin_solver_main(struct latin_solver *solver, int maxdiff,
     return diff;
 }
 
-int latin_solver(digit *grid, int o, int maxdiff,
+int latin_solver(digit *grid, int o, latin_arena *arena, int maxdiff,
 		 int diff_simple, int diff_set_0, int diff_set_1,
 		 int diff_forcing, int diff_recursive,
 		 usersolver_t const *usersolvers, validator_t valid,
-                 void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree)
+                 void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree,
+                 ctxnew_t branchnew, ctxfree_t branchfree)
 {
     struct latin_solver solver;
     int diff;
 
-    if (latin_solver_alloc(&solver, grid, o))
+    if (latin_solver_alloc_arena(&solver, grid, o, arena))
         diff = latin_solver_main(&solver, maxdiff,
                                  diff_simple, diff_set_0, diff_set_1,
                                  diff_forcing, diff_recursive,
-                                 usersolvers, valid, ctx, ctxnew, ctxfree);
+                                 usersolvers, valid, ctx, ctxnew, ctxfree,
+                                 branchnew, branchfree);
     else
         diff = diff_impossible;
     latin_solver_free(&solver);
@@ -1086,17 +1593,14 @@ void latin_solver_debug(unsigned char *cube, int o)
 {
 #ifdef STANDALONE_SOLVER
     if (solver_show_working > 1) {
-        struct latin_solver ls, *solver = &ls;
         char *dbg;
         int x, y, i, c = 0;
 
-        ls.cube = cube; ls.o = o; /* for cube() to work */
-
         dbg = snewn(3*o*o*o, char);
         for (y = 0; y < o; y++) {
             for (x = 0; x < o; x++) {
                 for (i = 1; i <= o; i++) {
-                    if (cube(x,y,i))
+                    if (cube[(x*o+y)*o+i-1])
                         dbg[c++] = i + '0';
                     else
                         dbg[c++] = '.';
@@ -1114,6 +1618,18 @@ void latin_solver_debug(unsigned char *cube, int o)
 #endif
 }
 
+void latin_solver_get_cube(struct latin_solver *solver, unsigned char *out)
+{
+#ifdef LATIN_BITSET
+    int o = solver->o, pos;
+
+    for (pos = 0; pos < o*o*o; pos++)
+        out[pos] = cubeat(pos);
+#else
+    memcpy(out, solver->cube, solver->o * solver->o * solver->o);
+#endif
+}
+
 void latin_debug(digit *sq, int o)
 {
 #ifdef STANDALONE_SOLVER
@@ -11,21 +11,61 @@ typedef unsigned char digit;
 extern int solver_show_working, solver_recurse_depth;
 #endif
 
+#ifdef LATIN_BITSET
+/*
+ * With LATIN_BITSET defined, the candidate cube is kept as one word
+ * per square instead of one byte per (square, digit), together with
+ * the same bits transposed by row and by column, so that counting
+ * and set elimination come down to popcounts and masks. Either way,
+ * code outside latin.c should only get at the cube through the
+ * cube() family of macros below. latincheck.sh checks that the two
+ * layouts generate and solve the same puzzles.
+ */
+typedef setelim_bits latin_bits;        /* at least 32 bits: o <= 32 */
+#endif
+
+typedef struct latin_arena latin_arena; /* private to latin.c */
+
 struct latin_solver {
   int o;                /* order of latin square */
+#ifdef LATIN_BITSET
+  latin_bits *cube;     /* o^2, indexed by x*o+y: bit n-1 set if n is
+                           a possibility there */
+  latin_bits *rowbits;  /* o^2: rowbits[y*o+n-1] bit x set iff cube(x,y,n) */
+  latin_bits *colbits;  /* o^2: colbits[x*o+n-1] bit y set iff cube(x,y,n) */
+#else
   unsigned char *cube;  /* o^3, indexed by x, y, and digit:
                            true in that position indicates a possibility */
+#endif
   digit *grid;          /* o^2, indexed by x and y: for final deductions */
 
   unsigned char *row;   /* o^2: row[y*cr+n-1] true if n is in row y */
   unsigned char *col;   /* o^2: col[x*cr+n-1] true if n is in col x */
 
+  latin_arena *arena;   /* owns the storage above, if not NULL */
+  int depth;            /* levels of recursion above this solver */
+
 #ifdef STANDALONE_SOLVER
   char **names;         /* o: names[n-1] gives name of 'digit' n */
 #endif
 };
+/*
+ * cubepos() gives a position in the cube as if it were o^3 bytes,
+ * whichever way it's really stored. cube() and cubeat() read it;
+ * cube_clear() and cubeat_clear() rule out a possibility.
+ */
 #define cubepos(x,y,n) (((x)*solver->o+(y))*solver->o+(n)-1)
+#ifdef LATIN_BITSET
+#define cubeat(pos) ((int)(solver->cube[(pos)/solver->o] >> \
+                           ((pos)%solver->o)) & 1)
+#define cube(x,y,n) cubeat(cubepos(x,y,n))
+#define cubeat_clear(pos) latin_solver_clear(solver, pos)
+#else
+#define cubeat(pos) (solver->cube[pos])
 #define cube(x,y,n) (solver->cube[cubepos(x,y,n)])
+#define cubeat_clear(pos) (cubeat(pos) = false)
+#endif
+#define cube_clear(x,y,n) cubeat_clear(cubepos(x,y,n))
 
 #define gridpos(x,y) ((y)*solver->o+(x))
 #define grid(x,y) (solver->grid[gridpos(x,y)])
@@ -36,6 +76,14 @@ struct latin_solver {
 /* Place a value at a specific location. */
 void latin_solver_place(struct latin_solver *solver, int x, int y, int n);
 
+#ifdef LATIN_BITSET
+/* Rule out one possibility; cubeat_clear() calls this. */
+void latin_solver_clear(struct latin_solver *solver, int pos);
+#endif
+
+/* Copy the cube out as o^3 bytes, indexed by cubepos(). */
+void latin_solver_get_cube(struct latin_solver *solver, unsigned char *out);
+
 /* Positional elimination. */
 int latin_solver_elim(struct latin_solver *solver, int start, int step
 #ifdef STANDALONE_SOLVER
@@ -70,6 +118,26 @@ int latin_solver_forcing(struct latin_solver *solver,
 bool latin_solver_alloc(struct latin_solver *solver, digit *grid, int o);
 void latin_solver_free(struct latin_solver *solver);
 
+/* A latin_arena holds all the storage a solver of one order needs,
+ * for itself and for each level of recursion beneath it, and keeps
+ * it between puzzles. A generator that solves many candidate puzzles
+ * can make one and pass it to each of them, so that once it has been
+ * as deep as its puzzles go the solver stops allocating altogether.
+ * Wherever an arena is asked for, NULL means the solver allocates its
+ * own for the duration of the call.
+ *
+ * latin_arena_allocs counts the times the arena has had to allocate
+ * (for a new level of recursion, or more room to keep levels in). */
+latin_arena *latin_arena_new(int o);
+void latin_arena_free(latin_arena *arena);
+long latin_arena_allocs(const latin_arena *arena);
+
+/* As latin_solver_alloc, but with storage from an arena (if not
+ * NULL), which latin_solver_free then leaves alone. Only one solver
+ * can use an arena at a time. */
+bool latin_solver_alloc_arena(struct latin_solver *solver, digit *grid,
+                              int o, latin_arena *arena);
+
 /* Allocates scratch space (for _set and _forcing) */
 struct latin_solver_scratch *
   latin_solver_new_scratch(struct latin_solver *solver);
@@ -91,24 +159,37 @@ typedef int (*usersolver_t)(struct latin_solver *solver, void *ctx);
 typedef bool (*validator_t)(struct latin_solver *solver, void *ctx);
 typedef void *(*ctxnew_t)(void *ctx);
 typedef void (*ctxfree_t)(void *ctx);
+/*
+ * ctxnew makes the context for one branch of a recursion, for solvers
+ * whose context changes as the search goes down; without it, every
+ * branch shares ctx. branchnew does the same, but only for branches
+ * searched at the same time as others, for solvers that can share a
+ * context one branch after another but not at once (scratch space,
+ * say). If either is given, branches may be searched on several
+ * threads at once, so it mustn't modify the context it copies; with
+ * neither, recursion stays on the calling thread (unless ctx is
+ * NULL). ctxfree and branchfree free what they make.
+ */
 
 /* Individual puzzles should use their enumerations for their
  * own difficulty levels, ensuring they don't clash with these. */
 enum { diff_impossible = 10, diff_ambiguous, diff_unfinished };
 
 /* Externally callable function that allocates and frees a latin_solver */
-int latin_solver(digit *grid, int o, int maxdiff,
+int latin_solver(digit *grid, int o, latin_arena *arena, int maxdiff,
 		 int diff_simple, int diff_set_0, int diff_set_1,
 		 int diff_forcing, int diff_recursive,
 		 usersolver_t const *usersolvers, validator_t valid,
-                 void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree);
+                 void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree,
+                 ctxnew_t branchnew, ctxfree_t branchfree);
 
 /* Version you can call if you want to alloc and free latin_solver yourself */
 int latin_solver_main(struct latin_solver *solver, int maxdiff,
 		      int diff_simple, int diff_set_0, int diff_set_1,
 		      int diff_forcing, int diff_recursive,
 		      usersolver_t const *usersolvers, validator_t valid,
-                      void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree);
+                      void *ctx, ctxnew_t ctxnew, ctxfree_t ctxfree,
+                      ctxnew_t branchnew, ctxfree_t branchfree);
 
 void latin_solver_debug(unsigned char *cube, int o);
 
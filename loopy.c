@@ -1511,17 +1511,33 @@ static game_state *remove_clues(game_state *state, random_state *rs,
 }
 
 
-static char *new_game_desc(const game_params *params, random_state *rs,
-                           char **aux, bool interactive)
+struct loopy_attempt_ctx {
+    const game_params *params;
+    const char *grid_desc;
+};
+
+static void free_loopy_attempt_result(void *vres)
 {
-    /* solution and description both use run-length encoding in obvious ways */
-    char *retval, *game_desc, *grid_desc;
+    sfree(vres);
+}
+
+/*
+ * One go at a board on the grid in ctx, returning its description,
+ * or NULL if it came out too easy. Each attempt builds its own copy
+ * of the grid, because race_attempts may run several at once and
+ * grids aren't safe to share between threads.
+ */
+static void *loopy_attempt(void *vctx, random_state *rs)
+{
+    const struct loopy_attempt_ctx *ctx =
+        (const struct loopy_attempt_ctx *)vctx;
+    const game_params *params = ctx->params;
+    char *game_desc = NULL;
     grid *g;
     game_state *state = snew(game_state);
     game_state *state_new;
 
-    grid_desc = grid_new_desc(grid_types[params->type], params->w, params->h, rs);
-    state->game_grid = g = loopy_generate_grid(params, grid_desc);
+    state->game_grid = g = loopy_generate_grid(params, ctx->grid_desc);
 
     state->clues = snewn(g->num_faces, signed char);
     state->lines = snewn(g->num_edges, char);
@@ -1530,8 +1546,6 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 
     state->grid_type = params->type;
 
-    newboard_please:
-
     memset(state->lines, LINE_UNKNOWN, g->num_edges);
     memset(state->line_errors, 0, g->num_edges * sizeof(bool));
 
@@ -1554,13 +1568,29 @@ static char *new_game_desc(const game_params *params, random_state *rs,
 #ifdef SHOW_WORKING
         fprintf(stderr, "Rejecting board, it is too easy\n");
 #endif
-        goto newboard_please;
+    } else {
+        game_desc = state_to_text(state);
     }
 
-    game_desc = state_to_text(state);
-
     free_game(state);
 
+    return game_desc;
+}
+
+static char *new_game_desc(const game_params *params, random_state *rs,
+                           char **aux, bool interactive)
+{
+    /* solution and description both use run-length encoding in obvious ways */
+    char *retval, *game_desc, *grid_desc;
+    struct loopy_attempt_ctx ctx;
+
+    grid_desc = grid_new_desc(grid_types[params->type], params->w, params->h, rs);
+
+    ctx.params = params;
+    ctx.grid_desc = grid_desc;
+    game_desc = race_attempts(rs, loopy_attempt, free_loopy_attempt_result,
+                              &ctx, 0);
+
     if (grid_desc) {
         retval = snewn(strlen(grid_desc) + 1 + strlen(game_desc) + 1, char);
         sprintf(retval, "%s%c%s", grid_desc, (int)GRID_DESC_SEP, game_desc);
@@ -3752,6 +3782,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     get_prefs, set_prefs,
@@ -20,9 +20,10 @@ enum { NEWGAME, MOVE, SOLVE, RESTART };/* for midend_state_entry.movetype */
 #define special(type) ( (type) != MOVE )
 
 struct midend_state_entry {
-    game_state *state;
+    game_state *state;                 /* NULL if dropped or unbuilt */
     char *movestr;
     int movetype;
+    unsigned long lastused;            /* for choosing what to drop */
 };
 
 struct midend_serialise_buf {
@@ -30,6 +31,31 @@ struct midend_serialise_buf {
     int len, size;
 };
 
+/*
+ * A game generation in flight between midend_new_game_start and
+ * midend_new_game_finish. Everything midend_generation_run needs is
+ * copied in here, so that it never has to look at the midend itself
+ * and can be run on whatever thread the front end likes.
+ */
+struct midend_generation {
+    const game *ourgame;
+    game_params *curparams;            /* NULL if we already have a desc */
+    char *seedstr;
+    bool interactive;
+    char *desc, *aux_info;             /* filled in by the run step */
+    int serial;                        /* compared with midend's newgame_serial */
+};
+
+/*
+ * A ready-made game waiting in the midend's pool: exactly what a
+ * finished midend_generation would have handed to
+ * midend_new_game_finish.
+ */
+struct midend_pool_entry {
+    char *cparstr;                     /* full encoding of its curparams */
+    char *seedstr, *desc, *aux_info;
+};
+
 struct midend_serialise_buf_read_ctx {
     struct midend_serialise_buf *ser;
     int len, pos;
@@ -73,9 +99,49 @@ struct midend {
     int nstates, statesize, statepos;
     struct midend_state_entry *states;
 
+    /*
+     * Limits on how many of those states are kept in memory; see
+     * midend_set_history_budget.
+     */
+    int snapshot_interval, max_cached_states;
+    unsigned long state_clock;
+
+    /*
+     * The state the game was loaded from, if it came from a
+     * checkpoint in a save file, which is never dropped since the
+     * moves before it haven't been checked; and the state undo can't
+     * go back past, because one of those moves turned out to be
+     * invalid. See midend_materialise_state.
+     */
+    int checkpoint, undo_floor;
+
+    /*
+     * How many of the states at the start of the list are already
+     * recorded in the binary save file the front end is appending
+     * to; see midend_serialise_append. 0 means that file is out of
+     * date in some way that appending can't describe. journal_statepos
+     * is the STATEPOS it last recorded, or -1 if its undo chain needs
+     * cutting back even though there's nothing new to add.
+     */
+    int journal_nstates, journal_statepos;
+
     struct midend_serialise_buf newgame_undo, newgame_redo;
     bool newgame_can_store_undo;
 
+    /*
+     * Bumped whenever something happens that makes an outstanding
+     * midend_generation no longer wanted (a newer one being started,
+     * or the params or game ID changing underneath it).
+     */
+    int newgame_serial;
+
+    /*
+     * Pre-generated games, in the order they were made. At most
+     * pool_target of them are kept for any one set of params.
+     */
+    struct midend_pool_entry *pool;
+    int npool, poolsize, pool_target;
+
     game_params *params, *curparams;
     game_drawstate *drawstate;
     bool first_draw;
@@ -126,6 +192,7 @@ struct deserialise_data {
     game_params *params, *cparams;
     game_ui *ui;
     struct midend_state_entry *states;
+    char **checkpoints;                /* encoded states, or NULL */
     int nstates, statepos;
 };
 
@@ -142,6 +209,7 @@ static void midend_serialise_prefs(
 static const char *midend_deserialise_prefs(
     midend *me, game_ui *ui,
     bool (*read)(void *ctx, void *buf, int len), void *rctx);
+static bool midend_pool_take(midend *me, midend_generation *gen);
 static config_item *midend_get_prefs(midend *me, game_ui *ui);
 static void midend_set_prefs(midend *me, game_ui *ui, config_item *all_prefs);
 static void midend_apply_prefs(midend *me, game_ui *ui);
@@ -186,11 +254,18 @@ midend *midend_new(frontend *fe, const game *ourgame,
     me->random = random_new(randseed, randseedsize);
     me->nstates = me->statesize = me->statepos = 0;
     me->states = NULL;
+    me->snapshot_interval = me->max_cached_states = 0;
+    me->checkpoint = me->undo_floor = 0;
+    me->journal_nstates = me->journal_statepos = 0;
+    me->state_clock = 0;
     me->newgame_undo.buf = NULL;
     me->newgame_undo.size = me->newgame_undo.len = 0;
     me->newgame_redo.buf = NULL;
     me->newgame_redo.size = me->newgame_redo.len = 0;
     me->newgame_can_store_undo = false;
+    me->newgame_serial = 0;
+    me->pool = NULL;
+    me->npool = me->poolsize = me->pool_target = 0;
     me->params = ourgame->default_params();
     me->game_id_change_notify_function = NULL;
     me->game_id_change_notify_ctx = NULL;
@@ -253,21 +328,159 @@ const game *midend_which_game(midend *me)
     return me->ourgame;
 }
 
-static void midend_purge_states(midend *me)
+/*
+ * The undo chain.
+ *
+ * Every entry in me->states keeps the move string that produced it,
+ * but if a history budget has been set, only some of them keep their
+ * game_state: entry 0, every snapshot_interval'th entry after that,
+ * and any RESTART entries (which don't follow from their predecessor
+ * by a move) are always kept, and at most max_cached_states others,
+ * least recently used first out. Any state that has been dropped is
+ * rebuilt on demand by midend_state, by replaying execute_move from
+ * the nearest earlier state that's still there.
+ *
+ * States are only ever dropped by midend_trim_states, which never
+ * drops the current state or its neighbours either side, so pointers
+ * from midend_state stay valid until the next trim.
+ *
+ * A game loaded from a save file with checkpoints in it (see
+ * midend_deserialise) may also start out with states missing before
+ * the current one, which were never built at all.
+ */
+static bool history_pinned(int snapshot_interval, int i, int movetype)
+{
+    return (i == 0 || snapshot_interval <= 1 || i % snapshot_interval == 0 ||
+            (movetype != MOVE && movetype != SOLVE));
+}
+
+static bool midend_state_pinned(midend *me, int i)
 {
-    while (me->nstates > me->statepos) {
-        me->ourgame->free_game(me->states[--me->nstates].state);
+    return (i == me->checkpoint || i == me->undo_floor ||
+            history_pinned(me->snapshot_interval, i, me->states[i].movetype));
+}
+
+static void midend_truncate_states(midend *me, int n)
+{
+    if (me->journal_nstates > n) {
+        me->journal_nstates = n;
+        me->journal_statepos = -1;
+    }
+    if (me->checkpoint >= n)
+        me->checkpoint = 0;
+    while (me->nstates > n) {
+        me->nstates--;
+        if (me->states[me->nstates].state)
+            me->ourgame->free_game(me->states[me->nstates].state);
         if (me->states[me->nstates].movestr)
             sfree(me->states[me->nstates].movestr);
     }
+}
+
+/*
+ * Make sure entry i has its game_state, replaying moves to rebuild it
+ * if necessary. This can only fail for moves midend_deserialise
+ * didn't check (see there). In the redo chain, the chain is cut off
+ * just before the move that failed. Before a checkpoint, undo is
+ * stopped at the first state after the failure that's still there.
+ */
+static bool midend_materialise_state(midend *me, int i)
+{
+    int j = i;
+
+    assert(i >= me->undo_floor && i < me->nstates);
+    while (!me->states[j].state)
+        j--;                  /* terminates, since entry 0 is never dropped */
+    for (j++; j <= i; j++) {
+        struct midend_state_entry *prev = &me->states[j-1], *ej = &me->states[j];
+
+        if (ej->movetype == RESTART)
+            ej->state = me->ourgame->new_game(me, me->curparams, ej->movestr);
+        else
+            ej->state = me->ourgame->execute_move(prev->state, ej->movestr);
+        if (!ej->state || ej->state == prev->state) {
+            ej->state = NULL;
+            if (j >= me->statepos) {
+                midend_truncate_states(me, j);
+            } else {
+                while (!me->states[j].state)
+                    j++;      /* terminates, since the current state is there */
+                me->undo_floor = j;
+            }
+            return false;
+        }
+        ej->lastused = ++me->state_clock;
+    }
+    return true;
+}
+
+/*
+ * Look up a state that must already be there. That's always true of
+ * entry 0, the current state and its neighbours either side (which
+ * midend_trim_states never drops), so these are all anyone asks for;
+ * midend_undo and midend_redo materialise the state they move to
+ * before moving, and fail if they can't.
+ */
+static game_state *midend_state(midend *me, int i)
+{
+    assert(me->states[i].state);
+    me->states[i].lastused = ++me->state_clock;
+    return me->states[i].state;
+}
+
+static void midend_trim_states(midend *me)
+{
+    int i, ncached;
+
+    if (me->snapshot_interval <= 1)
+        return;
+
+    ncached = 0;
+    for (i = 0; i < me->nstates; i++)
+        if (me->states[i].state && !midend_state_pinned(me, i))
+            ncached++;
+
+    while (ncached > me->max_cached_states) {
+        int victim = -1;
+
+        for (i = 0; i < me->nstates; i++) {
+            if (!me->states[i].state || midend_state_pinned(me, i) ||
+                (i >= me->statepos-2 && i <= me->statepos))
+                continue;
+            if (victim < 0 ||
+                me->states[i].lastused < me->states[victim].lastused)
+                victim = i;
+        }
+        if (victim < 0)
+            break;                     /* everything left is in use */
+        me->ourgame->free_game(me->states[victim].state);
+        me->states[victim].state = NULL;
+        ncached--;
+    }
+}
+
+void midend_set_history_budget(midend *me, int snapshot_interval,
+                               int max_cached_states)
+{
+    me->snapshot_interval = snapshot_interval;
+    me->max_cached_states = max_cached_states;
+    midend_trim_states(me);
+}
+
+static void midend_purge_states(midend *me)
+{
+    midend_truncate_states(me, me->statepos);
     me->newgame_redo.len = 0;
 }
 
 static void midend_free_game(midend *me)
 {
+    me->journal_nstates = 0;
+    me->checkpoint = me->undo_floor = 0;
     while (me->nstates > 0) {
         me->nstates--;
-	me->ourgame->free_game(me->states[me->nstates].state);
+        if (me->states[me->nstates].state)
+            me->ourgame->free_game(me->states[me->nstates].state);
 	sfree(me->states[me->nstates].movestr);
     }
 
@@ -290,12 +503,24 @@ static void midend_free_preset_menu(midend *me, struct preset_menu *menu)
     }
 }
 
+static void midend_free_pool_entry(struct midend_pool_entry *ent)
+{
+    sfree(ent->cparstr);
+    sfree(ent->seedstr);
+    sfree(ent->desc);
+    sfree(ent->aux_info);
+}
+
 void midend_free(midend *me)
 {
     int i;
 
     midend_free_game(me);
 
+    for (i = 0; i < me->npool; i++)
+        midend_free_pool_entry(&me->pool[i]);
+    sfree(me->pool);
+
     for (i = 0; i < me->n_encoded_presets; i++)
         sfree(me->encoded_presets[i]);
     sfree(me->encoded_presets);
@@ -389,7 +614,7 @@ void midend_size(midend *me, int *x, int *y, bool user_size,
     if (me->drawstate && me->tilesize > 0) {
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
         me->drawstate = me->ourgame->new_drawstate(me->drawing,
-                                                   me->states[0].state);
+                                                   midend_state(me, 0));
         me->first_draw = true;
     }
 
@@ -448,6 +673,7 @@ int midend_tilesize(midend *me) { return me->tilesize; }
 
 void midend_set_params(midend *me, game_params *params)
 {
+    me->newgame_serial++;              /* cancel any pending generation */
     me->ourgame->free_params(me->params);
     me->params = me->ourgame->dup_params(params);
 }
@@ -482,7 +708,7 @@ static void assert_printable_ascii(char const *s)
 static void midend_set_timer(midend *me)
 {
     me->timing = (me->ourgame->is_timed &&
-		  me->ourgame->timing_state(me->states[me->statepos-1].state,
+		  me->ourgame->timing_state(midend_state(me, me->statepos-1),
 					    me->ui));
     if (me->timing || me->flash_time || me->anim_time)
 	activate_timer(me->frontend);
@@ -495,7 +721,7 @@ void midend_force_redraw(midend *me)
     if (me->drawstate)
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
     me->drawstate = me->ourgame->new_drawstate(me->drawing,
-					       me->states[0].state);
+					       midend_state(me, 0));
     me->first_draw = true;
     midend_size_new_drawstate(me);
     midend_redraw(me);
@@ -528,8 +754,112 @@ static bool midend_serialise_buf_read(void *ctx, void *buf, int len)
     return true;
 }
 
-void midend_new_game(midend *me)
+/*
+ * Starting a new game is split into three steps, so that front ends
+ * which can afford to may run the (potentially slow) middle one in
+ * the background:
+ *
+ *  - midend_new_game_start decides on the params and random seed, on
+ *    the calling thread, and packages them up.
+ *  - midend_generation_run calls the game's new_desc. It touches
+ *    nothing but the midend_generation, so it's safe to run on any
+ *    thread, concurrently with anything else the midend is doing.
+ *  - midend_new_game_finish installs the result, back on the thread
+ *    that owns the midend. It returns false (and installs nothing) if
+ *    the generation was cancelled or superseded in the meantime.
+ *
+ * midend_new_game just does all three in a row.
+ */
+midend_generation *midend_new_game_start(midend *me)
+{
+    midend_generation *gen = snew(midend_generation);
+
+    gen->ourgame = me->ourgame;
+    gen->interactive = (me->drawing != NULL);
+    gen->desc = gen->aux_info = NULL;
+    gen->curparams = NULL;
+    gen->seedstr = NULL;
+    gen->serial = ++me->newgame_serial;
+
+    if (me->genmode == GOT_DESC)
+        return gen;                    /* nothing to generate */
+
+    if (me->genmode == GOT_SEED) {
+        gen->seedstr = dupstr(me->seedstr);
+        gen->curparams = me->ourgame->dup_params(me->curparams);
+    } else if (midend_pool_take(me, gen)) {
+        /* Already generated, so midend_generation_run has nothing to do. */
+    } else {
+        /*
+         * Generate a new random seed. 15 digits comes to about
+         * 48 bits, which should be more than enough.
+         * 
+         * I'll avoid putting a leading zero on the number,
+         * just in case it confuses anybody who thinks it's
+         * processed as an integer rather than a string.
+         */
+        char newseed[16];
+        int i;
+        newseed[15] = '\0';
+        newseed[0] = '1' + (char)random_upto(me->random, 9);
+        for (i = 1; i < 15; i++)
+            newseed[i] = '0' + (char)random_upto(me->random, 10);
+        gen->seedstr = dupstr(newseed);
+        gen->curparams = me->ourgame->dup_params(me->params);
+    }
+
+    return gen;
+}
+
+void midend_generation_run(midend_generation *gen)
 {
+    random_state *rs;
+
+    if (!gen->curparams)
+        return;
+
+    if (gen->desc)
+        return;                        /* came out of the pool */
+
+    rs = random_new(gen->seedstr, strlen(gen->seedstr));
+    /*
+     * If this midend has been instantiated without providing a
+     * drawing API, it is non-interactive. This means that it's
+     * being used for bulk game generation, and hence we should
+     * pass the non-interactive flag to new_desc.
+     */
+    gen->desc = gen->ourgame->new_desc(gen->curparams, rs,
+                                       &gen->aux_info, gen->interactive);
+    assert_printable_ascii(gen->desc);
+    random_free(rs);
+}
+
+void midend_generation_free(midend_generation *gen)
+{
+    if (gen->curparams)
+        gen->ourgame->free_params(gen->curparams);
+    sfree(gen->seedstr);
+    sfree(gen->desc);
+    sfree(gen->aux_info);
+    sfree(gen);
+}
+
+/*
+ * Abandon whatever generation is outstanding. Its result will be
+ * discarded by midend_new_game_finish when it turns up.
+ */
+void midend_new_game_cancel(midend *me)
+{
+    me->newgame_serial++;
+}
+
+bool midend_new_game_finish(midend *me, midend_generation *gen)
+{
+    if (gen->serial != me->newgame_serial) {
+        midend_generation_free(gen);
+        return false;
+    }
+
     me->newgame_undo.len = 0;
     if (me->newgame_can_store_undo) {
         /*
@@ -555,54 +885,28 @@ void midend_new_game(midend *me)
 
     assert(me->nstates == 0);
 
-    if (me->genmode == GOT_DESC) {
-	me->genmode = GOT_NOTHING;
-    } else {
-        random_state *rs;
-
-        if (me->genmode == GOT_SEED) {
-            me->genmode = GOT_NOTHING;
-        } else {
-            /*
-             * Generate a new random seed. 15 digits comes to about
-             * 48 bits, which should be more than enough.
-             * 
-             * I'll avoid putting a leading zero on the number,
-             * just in case it confuses anybody who thinks it's
-             * processed as an integer rather than a string.
-             */
-            char newseed[16];
-            int i;
-            newseed[15] = '\0';
-            newseed[0] = '1' + (char)random_upto(me->random, 9);
-            for (i = 1; i < 15; i++)
-                newseed[i] = '0' + (char)random_upto(me->random, 10);
-            sfree(me->seedstr);
-            me->seedstr = dupstr(newseed);
-
-	    if (me->curparams)
-		me->ourgame->free_params(me->curparams);
-	    me->curparams = me->ourgame->dup_params(me->params);
-        }
-
-	sfree(me->desc);
-	sfree(me->privdesc);
+    me->genmode = GOT_NOTHING;
+    if (gen->curparams) {
+        /* Install the generated game, which was done with its own
+         * copies of the seed and params. */
+        sfree(me->seedstr);
+        me->seedstr = gen->seedstr;
+        gen->seedstr = NULL;
+
+        if (me->curparams)
+            me->ourgame->free_params(me->curparams);
+        me->curparams = gen->curparams;
+        gen->curparams = NULL;
+
+        sfree(me->desc);
+        sfree(me->privdesc);
         sfree(me->aux_info);
-	me->aux_info = NULL;
-
-        rs = random_new(me->seedstr, strlen(me->seedstr));
-	/*
-	 * If this midend has been instantiated without providing a
-	 * drawing API, it is non-interactive. This means that it's
-	 * being used for bulk game generation, and hence we should
-	 * pass the non-interactive flag to new_desc.
-	 */
-        me->desc = me->ourgame->new_desc(me->curparams, rs,
-					 &me->aux_info, (me->drawing != NULL));
-	assert_printable_ascii(me->desc);
-	me->privdesc = NULL;
-        random_free(rs);
+        me->desc = gen->desc;
+        me->aux_info = gen->aux_info;
+        me->privdesc = NULL;
+        gen->desc = gen->aux_info = NULL;
     }
+    midend_generation_free(gen);
 
     ensure(me);
 
@@ -645,10 +949,11 @@ void midend_new_game(midend *me)
 
     me->states[me->nstates].movestr = NULL;
     me->states[me->nstates].movetype = NEWGAME;
+    me->states[me->nstates].lastused = ++me->state_clock;
     me->nstates++;
     me->statepos = 1;
     me->drawstate = me->ourgame->new_drawstate(me->drawing,
-					       me->states[0].state);
+					       midend_state(me, 0));
     me->first_draw = true;
     midend_size_new_drawstate(me);
     me->elapsed = 0.0F;
@@ -656,7 +961,7 @@ void midend_new_game(midend *me)
     me->anim_pos = me->anim_time = 0.0F;
     if (me->ui)
         me->ourgame->free_ui(me->ui);
-    me->ui = me->ourgame->new_ui(me->states[0].state);
+    me->ui = me->ourgame->new_ui(midend_state(me, 0));
     midend_apply_prefs(me, me->ui);
     midend_set_timer(me);
     me->pressed_mouse_button = 0;
@@ -665,6 +970,15 @@ void midend_new_game(midend *me)
         me->game_id_change_notify_function(me->game_id_change_notify_ctx);
 
     me->newgame_can_store_undo = true;
+
+    return true;
+}
+
+void midend_new_game(midend *me)
+{
+    midend_generation *gen = midend_new_game_start(me);
+    midend_generation_run(gen);
+    midend_new_game_finish(me, gen);
 }
 
 const char *midend_load_prefs(
@@ -683,7 +997,9 @@ void midend_save_prefs(midend *me,
 
 bool midend_can_undo(midend *me)
 {
-    return (me->statepos > 1 || me->newgame_undo.len);
+    if (me->statepos > 1)
+        return me->statepos-1 > me->undo_floor;
+    return me->newgame_undo.len != 0;
 }
 
 bool midend_can_redo(midend *me)
@@ -752,10 +1068,13 @@ static bool midend_undo(midend *me)
     const char *deserialise_error;
 
     if (me->statepos > 1) {
+        if (me->statepos-2 < me->undo_floor ||
+            !midend_materialise_state(me, me->statepos-2))
+            return false;              /* see midend_materialise_state */
         if (me->ui)
             me->ourgame->changed_state(me->ui,
-                                       me->states[me->statepos-1].state,
-                                       me->states[me->statepos-2].state);
+                                       midend_state(me, me->statepos-1),
+                                       midend_state(me, me->statepos-2));
 	me->statepos--;
         me->dir = -1;
         return true;
@@ -826,10 +1145,12 @@ static bool midend_redo(midend *me)
     const char *deserialise_error;
 
     if (me->statepos < me->nstates) {
+        if (!midend_materialise_state(me, me->statepos))
+            return false;              /* bad move in a loaded redo chain */
         if (me->ui)
             me->ourgame->changed_state(me->ui,
-                                       me->states[me->statepos-1].state,
-                                       me->states[me->statepos].state);
+                                       midend_state(me, me->statepos-1),
+                                       midend_state(me, me->statepos));
 	me->statepos++;
         me->dir = +1;
         return true;
@@ -909,8 +1230,8 @@ static void midend_finish_move(midend *me)
          (me->dir < 0 && me->statepos < me->nstates &&
           !special(me->states[me->statepos].movetype)))) {
 	flashtime = me->ourgame->flash_length(me->oldstate ? me->oldstate :
-					      me->states[me->statepos-2].state,
-					      me->states[me->statepos-1].state,
+					      midend_state(me, me->statepos-2),
+					      midend_state(me, me->statepos-1),
 					      me->oldstate ? me->dir : +1,
 					      me->ui);
 	if (flashtime > 0) {
@@ -962,21 +1283,23 @@ void midend_restart_game(midend *me)
     me->states[me->nstates].state = s;
     me->states[me->nstates].movestr = dupstr(me->desc);
     me->states[me->nstates].movetype = RESTART;
+    me->states[me->nstates].lastused = ++me->state_clock;
     me->statepos = ++me->nstates;
     if (me->ui)
         me->ourgame->changed_state(me->ui,
-                                   me->states[me->statepos-2].state,
-                                   me->states[me->statepos-1].state);
+                                   midend_state(me, me->statepos-2),
+                                   midend_state(me, me->statepos-1));
     me->flash_pos = me->flash_time = 0.0F;
     midend_finish_move(me);
     midend_redraw(me);
     midend_set_timer(me);
+    midend_trim_states(me);
 }
 
 static int midend_really_process_key(midend *me, int x, int y, int button)
 {
     game_state *oldstate =
-        me->ourgame->dup_game(me->states[me->statepos - 1].state);
+        me->ourgame->dup_game(midend_state(me, me->statepos - 1));
     int type = MOVE;
     bool gottype = false;
     int ret = PKR_NO_EFFECT;
@@ -986,7 +1309,7 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
 
     if (!IS_UI_FAKE_KEY(button)) {
         movestr = me->ourgame->interpret_move(
-            me->states[me->statepos-1].state,
+            midend_state(me, me->statepos-1),
             me->ui, me->drawstate, x, y, button);
     }
 
@@ -1032,15 +1355,15 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
     } else {
         ret = PKR_SOME_EFFECT;
 	if (movestr == MOVE_UI_UPDATE)
-	    s = me->states[me->statepos-1].state;
+	    s = midend_state(me, me->statepos-1);
 	else {
 	    assert_printable_ascii(movestr);
-	    s = me->ourgame->execute_move(me->states[me->statepos-1].state,
+	    s = me->ourgame->execute_move(midend_state(me, me->statepos-1),
 					  movestr);
 	    assert(s != NULL);
 	}
 
-        if (s == me->states[me->statepos-1].state) {
+        if (s == midend_state(me, me->statepos-1)) {
             /*
              * make_move() is allowed to return its input state to
              * indicate that although no move has been made, the UI
@@ -1057,12 +1380,13 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
             me->states[me->nstates].state = s;
             me->states[me->nstates].movestr = movestr;
             me->states[me->nstates].movetype = MOVE;
+            me->states[me->nstates].lastused = ++me->state_clock;
             me->statepos = ++me->nstates;
             me->dir = +1;
 	    if (me->ui)
 		me->ourgame->changed_state(me->ui,
-					   me->states[me->statepos-2].state,
-					   me->states[me->statepos-1].state);
+					   midend_state(me, me->statepos-2),
+					   midend_state(me, me->statepos-1));
         } else {
             goto done;
         }
@@ -1079,7 +1403,7 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
         anim_time = 0;
     } else {
         anim_time = me->ourgame->anim_length(oldstate,
-                                             me->states[me->statepos-1].state,
+                                             midend_state(me, me->statepos-1),
                                              me->dir, me->ui);
     }
 
@@ -1098,6 +1422,7 @@ static int midend_really_process_key(midend *me, int x, int y, int button)
 
     done:
     if (oldstate) me->ourgame->free_game(oldstate);
+    midend_trim_states(me);
     return ret;
 }
 
@@ -1295,7 +1620,7 @@ const char *midend_current_key_label(midend *me, int button)
     assert(IS_CURSOR_SELECT(button));
     if (!me->ourgame->current_key_label) return "";
     return me->ourgame->current_key_label(
-        me->ui, me->states[me->statepos-1].state, button);
+        me->ui, midend_state(me, me->statepos-1), button);
 }
 
 void midend_redraw(midend *me)
@@ -1325,11 +1650,11 @@ void midend_redraw(midend *me)
             me->anim_pos < me->anim_time) {
             assert(me->dir != 0);
             me->ourgame->redraw(me->drawing, me->drawstate, me->oldstate,
-				me->states[me->statepos-1].state, me->dir,
+				midend_state(me, me->statepos-1), me->dir,
 				me->ui, me->anim_pos, me->flash_pos);
         } else {
             me->ourgame->redraw(me->drawing, me->drawstate, NULL,
-				me->states[me->statepos-1].state, +1 /*shrug*/,
+				midend_state(me, me->statepos-1), +1 /*shrug*/,
 				me->ui, 0.0, me->flash_pos);
         }
 
@@ -1668,7 +1993,7 @@ bool midend_get_cursor_location(midend *me,
     if(me->ourgame->get_cursor_location)
         me->ourgame->get_cursor_location(me->ui,
                                          me->drawstate,
-                                         me->states[me->statepos-1].state,
+                                         midend_state(me, me->statepos-1),
                                          me->params,
                                          &x, &y, &w, &h);
 
@@ -1697,6 +2022,7 @@ void midend_supersede_game_desc(midend *me, const char *desc,
     sfree(me->privdesc);
     me->desc = dupstr(desc);
     me->privdesc = privdesc ? dupstr(privdesc) : NULL;
+    me->journal_nstates = 0;
     if (me->game_id_change_notify_function)
         me->game_id_change_notify_function(me->game_id_change_notify_ctx);
 }
@@ -1948,6 +2274,7 @@ static const char *midend_game_id_int(midend *me, const char *id, int defmode)
     }
 
     me->newgame_can_store_undo = false;
+    me->newgame_serial++;              /* cancel any pending generation */
 
     return NULL;
 }
@@ -2032,7 +2359,7 @@ char *midend_text_format(midend *me)
 {
     if (me->ourgame->can_format_as_text_ever && me->statepos > 0 &&
 	me->ourgame->can_format_as_text_now(me->params))
-	return me->ourgame->text_format(me->states[me->statepos-1].state);
+	return me->ourgame->text_format(midend_state(me, me->statepos-1));
     else
 	return NULL;
 }
@@ -2050,8 +2377,8 @@ const char *midend_solve(midend *me)
 	return "No game set up to solve";   /* _shouldn't_ happen! */
 
     msg = NULL;
-    movestr = me->ourgame->solve(me->states[0].state,
-				 me->states[me->statepos-1].state,
+    movestr = me->ourgame->solve(midend_state(me, 0),
+				 midend_state(me, me->statepos-1),
 				 me->aux_info, &msg);
     assert(movestr != MOVE_UI_UPDATE);
     if (!movestr) {
@@ -2060,7 +2387,7 @@ const char *midend_solve(midend *me)
 	return msg;
     }
     assert_printable_ascii(movestr);
-    s = me->ourgame->execute_move(me->states[me->statepos-1].state, movestr);
+    s = me->ourgame->execute_move(midend_state(me, me->statepos-1), movestr);
     assert(s);
 
     /*
@@ -2072,17 +2399,18 @@ const char *midend_solve(midend *me)
     me->states[me->nstates].state = s;
     me->states[me->nstates].movestr = movestr;
     me->states[me->nstates].movetype = SOLVE;
+    me->states[me->nstates].lastused = ++me->state_clock;
     me->statepos = ++me->nstates;
     if (me->ui)
         me->ourgame->changed_state(me->ui,
-                                   me->states[me->statepos-2].state,
-                                   me->states[me->statepos-1].state);
+                                   midend_state(me, me->statepos-2),
+                                   midend_state(me, me->statepos-1));
     me->dir = +1;
     if (me->ourgame->flags & SOLVE_ANIMATES) {
-	me->oldstate = me->ourgame->dup_game(me->states[me->statepos-2].state);
+	me->oldstate = me->ourgame->dup_game(midend_state(me, me->statepos-2));
         me->anim_time =
-	    me->ourgame->anim_length(me->states[me->statepos-2].state,
-				     me->states[me->statepos-1].state,
+	    me->ourgame->anim_length(midend_state(me, me->statepos-2),
+				     midend_state(me, me->statepos-1),
 				     +1, me->ui);
         me->anim_pos = 0.0;
     } else {
@@ -2092,6 +2420,7 @@ const char *midend_solve(midend *me)
     if (me->drawing)
         midend_redraw(me);
     midend_set_timer(me);
+    midend_trim_states(me);
     return NULL;
 }
 
@@ -2109,7 +2438,7 @@ int midend_status(midend *me)
     if (me->statepos == 0)
         return +1;
 
-    return me->ourgame->status(me->states[me->statepos-1].state);
+    return me->ourgame->status(midend_state(me, me->statepos-1));
 }
 
 char *midend_rewrite_statusbar(midend *me, const char *text)
@@ -2145,6 +2474,26 @@ char *midend_rewrite_statusbar(midend *me, const char *text)
 #define SERIALISE_MAGIC "Simon Tatham's Portable Puzzle Collection"
 #define SERIALISE_VERSION "1"
 
+/*
+ * Whether a save file should carry a checkpoint of state i: every
+ * CHECKPOINT_INTERVAL'th one before the current state, and (if
+ * 'current', for a file written in full) the current state itself,
+ * but only those we have to hand, since building a state just to
+ * save it would cost what the checkpoint is meant to save. Appends
+ * leave out the current state, which would cost a whole board per
+ * move; a load then still only replays the moves since the last of
+ * the every-CHECKPOINT_INTERVAL'th ones.
+ */
+#define CHECKPOINT_INTERVAL 64
+
+static bool midend_wants_checkpoint(midend *me, int i, bool current)
+{
+    return (me->ourgame->encode_state && i < me->statepos &&
+            me->states[i].state && me->states[i].movetype != RESTART &&
+            ((current && i == me->statepos-1) ||
+             i % CHECKPOINT_INTERVAL == 0));
+}
+
 void midend_serialise(midend *me,
                       void (*write)(void *ctx, const void *buf, int len),
                       void *wctx)
@@ -2296,9 +2645,20 @@ void midend_serialise(midend *me,
      * constructed from either privdesc or desc), enough
      * information for execute_move() to reconstruct it from the
      * previous one.
+     *
+     * If the game can encode its states, some of them are also
+     * written out in full as checkpoints, so that loading the file
+     * needn't replay every move to get back to where we were. Each
+     * CHECKPNT goes just before the move that leads to it, so that
+     * it's read even when it's for the last state in the file.
      */
     for (i = 1; i < me->nstates; i++) {
         assert(me->states[i].movetype != NEWGAME);   /* only state 0 */
+        if (midend_wants_checkpoint(me, i, true)) {
+            char *s = me->ourgame->encode_state(me->states[i].state);
+            wr("CHECKPNT", s);
+            sfree(s);
+        }
         switch (me->states[i].movetype) {
           case MOVE:
             wr("MOVE", me->states[i].movestr);
@@ -2315,6 +2675,41 @@ void midend_serialise(midend *me,
 #undef wr
 }
 
+/*
+ * Build the state for the last checkpoint in data before the current
+ * position that the game will accept, and return its index, or 0 if
+ * there's no such checkpoint. A checkpoint is decoded relative to the
+ * state it's a later version of: the one built from the most recent
+ * restart move before it, or from the game description.
+ */
+static int midend_load_checkpoint(midend *me, struct deserialise_data *data)
+{
+    int i, r;
+
+    if (!me->ourgame->decode_state)
+        return 0;
+
+    for (i = data->statepos-1; i > 0; i--) {
+        if (!data->checkpoints[i] || data->states[i].movetype == RESTART)
+            continue;
+        r = i;
+        while (r > 0 && data->states[r].movetype != RESTART)
+            r--;
+        if (r > 0)
+            data->states[r].state = me->ourgame->new_game(
+                me, data->cparams, data->states[r].movestr);
+        data->states[i].state = me->ourgame->decode_state(
+            data->states[r].state, data->checkpoints[i]);
+        if (data->states[i].state)
+            return i;
+        if (r > 0) {
+            me->ourgame->free_game(data->states[r].state);
+            data->states[r].state = NULL;
+        }
+    }
+    return 0;
+}
+
 /*
  * Internal version of midend_deserialise, taking an extra check
  * function to be called just before beginning to install things in
@@ -2329,7 +2724,7 @@ static const char *midend_deserialise_internal(
     void *cctx)
 {
     struct deserialise_data data;
-    int gotstates = 0;
+    int gotstates = 0, first;
     bool started = false;
     int i;
 
@@ -2343,6 +2738,7 @@ static const char *midend_deserialise_internal(
     data.params = data.cparams = NULL;
     data.ui = NULL;
     data.states = NULL;
+    data.checkpoints = NULL;
     data.nstates = 0;
     data.statepos = -1;
 
@@ -2487,10 +2883,13 @@ static const char *midend_deserialise_internal(
                     goto cleanup;
                 }
                 data.states = snewn(data.nstates, struct midend_state_entry);
+                data.checkpoints = snewn(data.nstates, char *);
                 for (i = 0; i < data.nstates; i++) {
                     data.states[i].state = NULL;
                     data.states[i].movestr = NULL;
                     data.states[i].movetype = NEWGAME;
+                    data.states[i].lastused = 0;
+                    data.checkpoints[i] = NULL;
                 }
             } else if (!strcmp(key, "STATEPOS")) {
                 data.statepos = atoi(val);
@@ -2515,6 +2914,13 @@ static const char *midend_deserialise_internal(
                     data.states[gotstates].movetype = RESTART;
                 data.states[gotstates].movestr = val;
                 val = NULL;
+            } else if (!strcmp(key, "CHECKPNT")) {
+                /* For the state the next move leads to. */
+                if (data.states && gotstates+1 < data.nstates) {
+                    sfree(data.checkpoints[gotstates+1]);
+                    data.checkpoints[gotstates+1] = val;
+                    val = NULL;
+                }
             }
         }
 
@@ -2574,8 +2980,40 @@ static const char *midend_deserialise_internal(
     data.states[0].state = me->ourgame->new_game(
         me, data.cparams, data.privdesc ? data.privdesc : data.desc);
 
+    /*
+     * Restart moves are cheap to check, so they are all checked now.
+     */
     for (i = 1; i < data.nstates; i++) {
         assert(data.states[i].movetype != NEWGAME);
+        if (data.states[i].movetype == RESTART &&
+            me->ourgame->validate_desc(data.cparams,
+                                       data.states[i].movestr)) {
+            ret = "Save file contained an invalid restart move";
+            goto cleanup;
+        }
+    }
+
+    /*
+     * Only the states from the last usable checkpoint up to the
+     * current position are built now. The ones before the checkpoint
+     * and the redo chain after the current position are left for
+     * midend_materialise_state to build if and when the user gets
+     * that far, so that resuming a game costs nothing for the moves
+     * on either side. A move there which turns out to be invalid
+     * just stops undo or redo early, rather than failing the whole
+     * load.
+     *
+     * If the midend has a history budget, states before the current
+     * one are dropped as soon as the next one has been built from
+     * them, unless they would be kept anyway, so that loading a long
+     * game doesn't briefly hold the whole of it in memory.
+     */
+    first = midend_load_checkpoint(me, &data);
+    for (i = 0; i < data.nstates; i++)
+        sfree(data.checkpoints[i]);
+    sfree(data.checkpoints);
+    data.checkpoints = NULL;           /* we've finished with them */
+    for (i = first+1; i < data.statepos; i++) {
         switch (data.states[i].movetype) {
           case MOVE:
           case SOLVE:
@@ -2587,15 +3025,16 @@ static const char *midend_deserialise_internal(
             }
             break;
           case RESTART:
-            if (me->ourgame->validate_desc(
-                    data.cparams, data.states[i].movestr)) {
-                ret = "Save file contained an invalid restart move";
-                goto cleanup;
-            }
             data.states[i].state = me->ourgame->new_game(
                 me, data.cparams, data.states[i].movestr);
             break;
         }
+        if (i-1 < data.statepos-2 && i-1 != first &&
+            !history_pinned(me->snapshot_interval, i-1,
+                            data.states[i-1].movetype)) {
+            me->ourgame->free_game(data.states[i-1].state);
+            data.states[i-1].state = NULL;
+        }
     }
 
     data.ui = me->ourgame->new_ui(data.states[0].state);
@@ -2639,6 +3078,7 @@ static const char *midend_deserialise_internal(
     }
 
     me->genmode = GOT_NOTHING;
+    me->newgame_serial++;              /* cancel any pending generation */
 
     me->statesize = data.nstates;
     data.nstates = me->nstates;
@@ -2650,6 +3090,9 @@ static const char *midend_deserialise_internal(
         data.states = tmp;
     }
     me->statepos = data.statepos;
+    me->checkpoint = first;
+    me->undo_floor = 0;
+    me->journal_nstates = 0;
 
     /*
      * Don't save the "new game undo/redo" state.  So "new game" twice or
@@ -2694,11 +3137,12 @@ static const char *midend_deserialise_internal(
         me->ourgame->free_drawstate(me->drawing, me->drawstate);
     me->drawstate =
         me->ourgame->new_drawstate(me->drawing,
-				   me->states[me->statepos-1].state);
+				   midend_state(me, me->statepos-1));
     me->first_draw = true;
     midend_size_new_drawstate(me);
     if (me->game_id_change_notify_function)
         me->game_id_change_notify_function(me->game_id_change_notify_ctx);
+    midend_trim_states(me);
 
     ret = NULL;                        /* success! */
 
@@ -2727,6 +3171,13 @@ static const char *midend_deserialise_internal(
         }
         sfree(data.states);
     }
+    if (data.checkpoints) {
+        int i;
+
+        for (i = 0; i < data.nstates; i++)
+            sfree(data.checkpoints[i]);
+        sfree(data.checkpoints);
+    }
 
     return ret;
 }
@@ -2737,6 +3188,589 @@ const char *midend_deserialise(
     return midend_deserialise_internal(me, read, rctx, NULL, NULL);
 }
 
+/*
+ * The binary save format (see savebin.c), and appending to it.
+ */
+void midend_serialise_binary(midend *me,
+                             void (*write)(void *ctx, const void *buf, int len),
+                             void *wctx, bool compress)
+{
+    struct midend_serialise_buf ser;
+    struct midend_serialise_buf_read_ctx rctx;
+    const char *err;
+
+    ser.buf = NULL;
+    ser.len = ser.size = 0;
+    midend_serialise(me, midend_serialise_buf_write, &ser);
+
+    rctx.ser = &ser;
+    rctx.len = ser.len;
+    rctx.pos = 0;
+    err = savefile_text_to_binary(midend_serialise_buf_read, &rctx,
+                                  write, wctx, compress);
+    assert(!err);                   /* we just wrote it, so it must parse */
+    (void)err;
+    sfree(ser.buf);
+
+    me->journal_nstates = me->nstates;
+    me->journal_statepos = me->statepos;
+}
+
+bool midend_serialise_append(midend *me,
+                             void (*write)(void *ctx, const void *buf, int len),
+                             void *wctx, bool compress)
+{
+    char buf[80];
+    int i;
+
+    if (me->journal_nstates == 0)
+        return false;
+
+    /*
+     * Nothing to add if the undo chain hasn't changed since the last
+     * append (a cursor move, say, or a key the game ignored). The UI
+     * and TIME records then wait for the next real move.
+     */
+    if (me->journal_nstates == me->nstates &&
+        me->journal_statepos == me->statepos)
+        return true;
+
+    /*
+     * Cut the file's undo chain back to what we still agree with,
+     * bring the records that change from move to move up to date,
+     * and add the new moves. STATEPOS goes last, because that's how
+     * savefile_binary_to_text knows this append reached the disk in
+     * full.
+     */
+    sprintf(buf, "%d", me->journal_nstates);
+    savefile_binary_record(write, wctx, "TRUNCATE", buf, strlen(buf), false);
+
+    if (me->ui && me->ourgame->encode_ui) {
+        char *s = me->ourgame->encode_ui(me->ui);
+        if (s) {
+            savefile_binary_record(write, wctx, "UI", s, strlen(s), compress);
+            sfree(s);
+        }
+    }
+    if (me->ourgame->is_timed) {
+        sprintf(buf, "%g", me->elapsed);
+        savefile_binary_record(write, wctx, "TIME", buf, strlen(buf), false);
+    }
+
+    for (i = me->journal_nstates; i < me->nstates; i++) {
+        const char *key = (me->states[i].movetype == SOLVE ? "SOLVE" :
+                           me->states[i].movetype == RESTART ? "RESTART" :
+                           "MOVE");
+        assert(me->states[i].movetype != NEWGAME);
+        if (midend_wants_checkpoint(me, i, false)) {
+            char *s = me->ourgame->encode_state(me->states[i].state);
+            savefile_binary_record(write, wctx, "CHECKPNT", s, strlen(s),
+                                   compress);
+            sfree(s);
+        }
+        savefile_binary_record(write, wctx, key, me->states[i].movestr,
+                               strlen(me->states[i].movestr), compress);
+    }
+
+    sprintf(buf, "%d", me->nstates);
+    savefile_binary_record(write, wctx, "NSTATES", buf, strlen(buf), false);
+    sprintf(buf, "%d", me->statepos);
+    savefile_binary_record(write, wctx, "STATEPOS", buf, strlen(buf), false);
+
+    me->journal_nstates = me->nstates;
+    me->journal_statepos = me->statepos;
+    return true;
+}
+
+const char *midend_deserialise_binary(
+    midend *me, bool (*read)(void *ctx, void *buf, int len), void *rctx)
+{
+    struct midend_serialise_buf ser;
+    struct midend_serialise_buf_read_ctx trctx;
+    const char *err;
+
+    ser.buf = NULL;
+    ser.len = ser.size = 0;
+    err = savefile_binary_to_text(read, rctx, midend_serialise_buf_write, &ser);
+    if (!err) {
+        trctx.ser = &ser;
+        trctx.len = ser.len;
+        trctx.pos = 0;
+        err = midend_deserialise(me, midend_serialise_buf_read, &trctx);
+        if (!err) {
+            me->journal_nstates = me->nstates;
+            me->journal_statepos = me->statepos;
+        }
+    }
+    sfree(ser.buf);
+    return err;
+}
+
+/*
+ * The pool of pre-generated games.
+ *
+ * A front end that has idle time (or idle cores) to spare can ask
+ * for a pool of games to be kept ready for the current parameters,
+ * so that midend_new_game is instant. Each entry keeps the seed and
+ * the params it was really generated from, so once it has been
+ * handed out, midend_get_game_id and midend_get_random_seed say
+ * exactly what they would have if it had been generated on demand.
+ */
+void midend_set_pool_size(midend *me, int n)
+{
+    me->pool_target = n;
+}
+
+static int midend_pool_count(midend *me, const char *cparstr)
+{
+    int i, n = 0;
+    for (i = 0; i < me->npool; i++)
+        if (!strcmp(me->pool[i].cparstr, cparstr))
+            n++;
+    return n;
+}
+
+static void midend_pool_append(midend *me, char *cparstr, char *seedstr,
+                               char *desc, char *aux_info)
+{
+    struct midend_pool_entry *ent;
+
+    if (me->npool >= me->poolsize) {
+        me->poolsize = me->npool * 5 / 4 + 8;
+        me->pool = sresize(me->pool, me->poolsize,
+                           struct midend_pool_entry);
+    }
+    ent = &me->pool[me->npool++];
+    ent->cparstr = cparstr;
+    ent->seedstr = seedstr;
+    ent->desc = desc;
+    ent->aux_info = aux_info;
+}
+
+/*
+ * Fill in gen from the oldest pool entry for the current params, if
+ * there is one, and remove it from the pool.
+ */
+static bool midend_pool_take(midend *me, midend_generation *gen)
+{
+    char *cparstr;
+    int i;
+
+    if (!me->npool || !me->pool_target)
+        return false;                  /* nothing there, or pool is off */
+
+    cparstr = encode_params(me, me->params, true);
+    for (i = 0; i < me->npool; i++)
+        if (!strcmp(me->pool[i].cparstr, cparstr))
+            break;
+    sfree(cparstr);
+    if (i == me->npool)
+        return false;
+
+    gen->curparams = me->ourgame->default_params();
+    me->ourgame->decode_params(gen->curparams, me->pool[i].cparstr);
+    gen->seedstr = me->pool[i].seedstr;
+    gen->desc = me->pool[i].desc;
+    gen->aux_info = me->pool[i].aux_info;
+    sfree(me->pool[i].cparstr);
+    memmove(me->pool + i, me->pool + i + 1,
+            (me->npool - i - 1) * sizeof(*me->pool));
+    me->npool--;
+    return true;
+}
+
+/*
+ * Returns a generation which, once run, should be passed to
+ * midend_pool_add; or NULL if the pool is already full for the
+ * current params.
+ */
+midend_generation *midend_pool_refill_start(midend *me)
+{
+    midend_generation *gen;
+    char *cparstr = encode_params(me, me->params, true);
+    int have = midend_pool_count(me, cparstr);
+    char newseed[16];
+    int i;
+
+    sfree(cparstr);
+    if (have >= me->pool_target)
+        return NULL;
+
+    /* Same recipe for a seed as midend_new_game_start. */
+    newseed[15] = '\0';
+    newseed[0] = '1' + (char)random_upto(me->random, 9);
+    for (i = 1; i < 15; i++)
+        newseed[i] = '0' + (char)random_upto(me->random, 10);
+
+    gen = snew(midend_generation);
+    gen->ourgame = me->ourgame;
+    gen->interactive = (me->drawing != NULL);
+    gen->desc = gen->aux_info = NULL;
+    gen->seedstr = dupstr(newseed);
+    gen->curparams = me->ourgame->dup_params(me->params);
+    gen->serial = -1;                  /* never finished as a game */
+    return gen;
+}
+
+void midend_pool_add(midend *me, midend_generation *gen)
+{
+    char *cparstr;
+
+    assert(gen->curparams && gen->desc);
+    cparstr = encode_params(me, gen->curparams, true);
+    if (midend_pool_count(me, cparstr) >= me->pool_target) {
+        sfree(cparstr);                /* someone beat us to it */
+    } else {
+        midend_pool_append(me, cparstr, gen->seedstr, gen->desc,
+                           gen->aux_info);
+        gen->seedstr = gen->desc = gen->aux_info = NULL;
+    }
+    midend_generation_free(gen);
+}
+
+#define POOL_MAGIC "Simon Tatham's Portable Puzzle Collection pool"
+#define POOL_VERSION "1"
+
+/*
+ * Write the pool out in the same line format as a saved game, so
+ * that it can be spooled to disk and reloaded by a later run.
+ */
+void midend_serialise_pool(midend *me,
+                           void (*write)(void *ctx, const void *buf, int len),
+                           void *wctx)
+{
+    int i;
+
+#define wr(h,s) do { \
+    char hbuf[80]; \
+    const char *str = (s); \
+    char lbuf[9];                               \
+    copy_left_justified(lbuf, sizeof(lbuf), h); \
+    sprintf(hbuf, "%s:%d:", lbuf, (int)strlen(str)); \
+    write(wctx, hbuf, strlen(hbuf)); \
+    write(wctx, str, strlen(str)); \
+    write(wctx, "\n", 1); \
+} while (0)
+
+    wr("POOLFILE", POOL_MAGIC);
+    wr("VERSION", POOL_VERSION);
+    wr("GAME", me->ourgame->name);
+
+    for (i = 0; i < me->npool; i++) {
+        struct midend_pool_entry *ent = &me->pool[i];
+
+        wr("CPARAMS", ent->cparstr);
+        wr("SEED", ent->seedstr);
+        wr("DESC", ent->desc);
+        if (ent->aux_info) {
+            /* Obfuscated for the same reason as in a saved game. */
+            int len = strlen(ent->aux_info);
+            unsigned char *s1 = snewn(len, unsigned char);
+            char *s2;
+            memcpy(s1, ent->aux_info, len);
+            obfuscate_bitmap(s1, len*8, false);
+            s2 = bin2hex(s1, len);
+            wr("AUXINFO", s2);
+            sfree(s2);
+            sfree(s1);
+        }
+    }
+
+#undef wr
+}
+
+/*
+ * Read one `KEYWORD:len:value' line of the kind written by
+ * midend_serialise. Returns false on EOF or malformed input.
+ */
+static bool midend_read_record(bool (*read)(void *ctx, void *buf, int len),
+                               void *rctx, char *key, char **val)
+{
+    char c;
+    int len;
+
+    do {
+        if (!read(rctx, key, 1))
+            return false;
+    } while (key[0] == '\r' || key[0] == '\n');
+    if (!read(rctx, key+1, 8) || key[8] != ':')
+        return false;
+    len = strcspn(key, ": ");
+    key[len] = '\0';
+
+    len = 0;
+    while (1) {
+        if (!read(rctx, &c, 1))
+            return false;
+        if (c == ':')
+            break;
+        if (c < '0' || c > '9' || len >= (INT_MAX - 10) / 10)
+            return false;
+        len = (len * 10) + (c - '0');
+    }
+
+    *val = snewn(len+1, char);
+    if (!read(rctx, *val, len)) {
+        sfree(*val);
+        return false;
+    }
+    (*val)[len] = '\0';
+    return true;
+}
+
+/*
+ * Read back a pool written by midend_serialise_pool, adding its
+ * entries to the current pool. Every entry is checked with
+ * validate_params and validate_desc before anything is installed;
+ * returns NULL on success or an error message.
+ */
+const char *midend_deserialise_pool(
+    midend *me, bool (*read)(void *ctx, void *buf, int len), void *rctx)
+{
+    struct midend_pool_entry *ents = NULL, *ent = NULL;
+    int nents = 0, entsize = 0, i;
+    const char *ret = "Data does not appear to be a pool file";
+    bool started = false;
+    char key[9], *val;
+
+    while (midend_read_record(read, rctx, key, &val)) {
+        if (!started) {
+            if (strcmp(key, "POOLFILE") || strcmp(val, POOL_MAGIC)) {
+                sfree(val);
+                goto cleanup;
+            }
+            started = true;
+        } else if (!strcmp(key, "VERSION")) {
+            if (strcmp(val, POOL_VERSION)) {
+                ret = "Cannot handle this version of the pool file format";
+                sfree(val);
+                goto cleanup;
+            }
+        } else if (!strcmp(key, "GAME")) {
+            if (strcmp(val, me->ourgame->name)) {
+                ret = "Pool file is from a different game";
+                sfree(val);
+                goto cleanup;
+            }
+        } else if (!strcmp(key, "CPARAMS")) {
+            if (nents >= entsize) {
+                entsize = nents * 5 / 4 + 8;
+                ents = sresize(ents, entsize, struct midend_pool_entry);
+            }
+            ent = &ents[nents++];
+            ent->cparstr = val;
+            ent->seedstr = ent->desc = ent->aux_info = NULL;
+            val = NULL;
+        } else if (ent && !strcmp(key, "SEED")) {
+            sfree(ent->seedstr);
+            ent->seedstr = val;
+            val = NULL;
+        } else if (ent && !strcmp(key, "DESC")) {
+            sfree(ent->desc);
+            ent->desc = val;
+            val = NULL;
+        } else if (ent && !strcmp(key, "AUXINFO")) {
+            int len = strlen(val) / 2;
+            unsigned char *tmp = hex2bin(val, len);
+            obfuscate_bitmap(tmp, len*8, true);
+            sfree(ent->aux_info);
+            ent->aux_info = snewn(len + 1, char);
+            memcpy(ent->aux_info, tmp, len);
+            ent->aux_info[len] = '\0';
+            sfree(tmp);
+        }
+        sfree(val);
+    }
+    if (!started)
+        goto cleanup;
+
+    for (i = 0; i < nents; i++) {
+        game_params *params;
+        bool ok;
+
+        ent = &ents[i];
+        if (!ent->seedstr || !ent->desc) {
+            ret = "Pool file entry is incomplete";
+            goto cleanup;
+        }
+        params = me->ourgame->default_params();
+        me->ourgame->decode_params(params, ent->cparstr);
+        ok = (!me->ourgame->validate_params(params, true) &&
+              !me->ourgame->validate_desc(params, ent->desc));
+        me->ourgame->free_params(params);
+        if (!ok) {
+            ret = "Pool file contains an invalid game";
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < nents; i++)
+        midend_pool_append(me, ents[i].cparstr, ents[i].seedstr,
+                           ents[i].desc, ents[i].aux_info);
+    sfree(ents);
+    return NULL;
+
+  cleanup:
+    for (i = 0; i < nents; i++)
+        midend_free_pool_entry(&ents[i]);
+    sfree(ents);
+    return ret;
+}
+
+/*
+ * Racing generation attempts.
+ *
+ * Some generators make an attempt at a puzzle, throw it away if it
+ * came out at the wrong difficulty, and try again. Those attempts
+ * are independent, so if the front end can lend us some threads we
+ * can make several at once. To keep a given random seed producing
+ * the same puzzle however many threads there are, attempt number i
+ * always gets its own random_state derived from the caller's state
+ * and i, and the winner is the lowest-numbered attempt to succeed,
+ * not the first to finish.
+ */
+static const struct parallel_runner *parallel_runner = NULL;
+
+void set_parallel_runner(const struct parallel_runner *runner)
+{
+    parallel_runner = runner;
+}
+
+const struct parallel_runner *get_parallel_runner(void)
+{
+    return parallel_runner;
+}
+
+#define RACE_SEED_WORDS 4
+
+struct race {
+    random_state *rs;                  /* attempt 0's stream */
+    unsigned long seed[RACE_SEED_WORDS]; /* where the others come from */
+    void *(*attempt)(void *actx, random_state *rs);
+    void (*free_result)(void *result);
+    void *actx;
+    int maxattempts;                   /* or 0 for no limit */
+
+    void *lock;                        /* protects everything below */
+    int next;                          /* next attempt not yet claimed */
+    int winner;                        /* lowest success so far, or -1 */
+    void *result;                      /* ... and what it produced */
+};
+
+static random_state *race_stream(struct race *race, int index)
+{
+    unsigned char buf[4 * (RACE_SEED_WORDS + 1)];
+    int i, j;
+
+    for (i = 0; i <= RACE_SEED_WORDS; i++) {
+        unsigned long w = (i < RACE_SEED_WORDS ? race->seed[i] :
+                           (unsigned long)index);
+        for (j = 0; j < 4; j++)
+            buf[4*i+j] = (unsigned char)(w >> (8*j));
+    }
+    return random_new((const char *)buf, sizeof(buf));
+}
+
+/*
+ * Make attempt number index. The first uses the caller's own
+ * random_state, so that whenever it succeeds the puzzle is exactly
+ * the one the generator made before it raced attempts at all.
+ */
+static void *race_attempt(struct race *race, int index)
+{
+    random_state *rs;
+    void *result;
+
+    if (index == 0)
+        return race->attempt(race->actx, race->rs);
+    rs = race_stream(race, index);
+    result = race->attempt(race->actx, rs);
+    random_free(rs);
+    return result;
+}
+
+static bool race_unfinished(struct race *race)
+{
+    if (race->maxattempts && race->next >= race->maxattempts)
+        return false;
+    return race->winner < 0 || race->next < race->winner;
+}
+
+static void race_worker(void *vrace)
+{
+    struct race *race = (struct race *)vrace;
+    const struct parallel_runner *pr = parallel_runner;
+
+    pr->lock(race->lock);
+    while (race_unfinished(race)) {
+        int index = race->next++;
+        void *result;
+
+        pr->unlock(race->lock);
+        result = race_attempt(race, index);
+        pr->lock(race->lock);
+
+        if (result) {
+            if (race->winner < 0 || index < race->winner) {
+                if (race->result)
+                    race->free_result(race->result);
+                race->winner = index;
+                race->result = result;
+            } else {
+                race->free_result(result);
+            }
+        }
+    }
+    pr->unlock(race->lock);
+}
+
+/*
+ * Call attempt() until it returns non-NULL (or maxattempts times, if
+ * that's nonzero), and return the result of the lowest-numbered
+ * attempt that succeeded, or NULL. Attempts may run concurrently, so
+ * attempt() must not modify anything reachable from actx, and any
+ * result that loses the race is passed to free_result().
+ */
+void *race_attempts(random_state *rs,
+                    void *(*attempt)(void *actx, random_state *rs),
+                    void (*free_result)(void *result), void *actx,
+                    int maxattempts)
+{
+    const struct parallel_runner *pr = parallel_runner;
+    struct race race;
+    random_state *seeder;
+    int i;
+
+    /*
+     * The other attempts' streams are seeded from a copy of rs,
+     * leaving rs itself untouched for attempt 0.
+     */
+    seeder = random_copy(rs);
+    for (i = 0; i < RACE_SEED_WORDS; i++)
+        race.seed[i] = random_bits(seeder, 32);
+    random_free(seeder);
+    race.rs = rs;
+    race.attempt = attempt;
+    race.free_result = free_result;
+    race.actx = actx;
+    race.maxattempts = maxattempts;
+    race.next = 0;
+    race.winner = -1;
+    race.result = NULL;
+
+    if (!pr || pr->nworkers < 2) {
+        /* Serially, the first success is the lowest-numbered one. */
+        while (!race.result && race_unfinished(&race))
+            race.result = race_attempt(&race, race.next++);
+        return race.result;
+    }
+
+    race.lock = pr->lock_new();
+    pr->run(race_worker, &race, pr->nworkers);
+    pr->lock_free(race.lock);
+    return race.result;
+}
+
 /*
  * This function examines a saved game file just far enough to
  * determine which game type it contains. It returns NULL on success
@@ -2858,12 +3892,12 @@ const char *midend_print_puzzle(midend *me, document *doc, bool with_soln)
 	    return "This game does not support the Solve operation";
 
 	msg = "Solve operation failed";/* game _should_ overwrite on error */
-	movestr = me->ourgame->solve(me->states[0].state,
-				     me->states[me->statepos-1].state,
+	movestr = me->ourgame->solve(midend_state(me, 0),
+				     midend_state(me, me->statepos-1),
 				     me->aux_info, &msg);
 	if (!movestr)
 	    return msg;
-	soln = me->ourgame->execute_move(me->states[me->statepos-1].state,
+	soln = me->ourgame->execute_move(midend_state(me, me->statepos-1),
 					 movestr);
 	assert(soln);
 
@@ -2877,11 +3911,11 @@ const char *midend_print_puzzle(midend *me, document *doc, bool with_soln)
      * want to keep, and we don't have to bother freeing soln if it
      * was non-NULL.
      */
-    game_ui *ui = me->ourgame->new_ui(me->states[0].state);
+    game_ui *ui = me->ourgame->new_ui(midend_state(me, 0));
     midend_apply_prefs(me, ui);
     document_add_puzzle(doc, me->ourgame,
 			me->ourgame->dup_params(me->curparams), ui,
-			me->ourgame->dup_game(me->states[0].state), soln);
+			me->ourgame->dup_game(midend_state(me, 0)), soln);
 
     return NULL;
 }
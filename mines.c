@@ -2513,6 +2513,7 @@ static const char *current_key_label(const game_ui *ui,
 struct game_drawstate {
     int w, h, tilesize, bg;
     bool started;
+    tile_cache *tiles;          /* keyed on draw_tile's v and bg */
     signed char *grid;
     /*
      * Items in this `grid' array have all the same values as in
@@ -2824,6 +2825,8 @@ static void game_set_size(drawing *dr, game_drawstate *ds,
                           const game_params *params, int tilesize)
 {
     ds->tilesize = tilesize;
+    tile_cache_free(dr, ds->tiles);
+    ds->tiles = tile_cache_new(dr, TILE_SIZE, TILE_SIZE);
 }
 
 static float *game_colours(frontend *fe, int *ncolours)
@@ -2921,6 +2924,7 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
     ds->h = state->h;
     ds->started = false;
     ds->tilesize = 0;                  /* not decided yet */
+    ds->tiles = NULL;
     ds->grid = snewn(ds->w * ds->h, signed char);
     ds->bg = -1;
     ds->cur_x = ds->cur_y = -1;
@@ -2932,6 +2936,7 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
 
 static void game_free_drawstate(drawing *dr, game_drawstate *ds)
 {
+    tile_cache_free(dr, ds->tiles);
     sfree(ds->grid);
     sfree(ds);
 }
@@ -2939,6 +2944,17 @@ static void game_free_drawstate(drawing *dr, game_drawstate *ds)
 static void draw_tile(drawing *dr, game_drawstate *ds,
                       int x, int y, int v, int bg)
 {
+    /*
+     * Everything drawn below depends only on v and bg, and stays
+     * inside the tile.
+     */
+    unsigned long key = (unsigned long)(v + 128) | ((unsigned long)bg << 8);
+
+    if (tile_cache_draw(dr, ds->tiles, key, x, y)) {
+        draw_update(dr, x, y, TILE_SIZE, TILE_SIZE);
+        return;
+    }
+
     if (v < 0) {
         int coords[12];
 	int hl = 0;
@@ -3068,6 +3084,7 @@ static void draw_tile(drawing *dr, game_drawstate *ds,
 	}
     }
 
+    tile_cache_store(dr, ds->tiles, key, x, y);
     draw_update(dr, x, y, TILE_SIZE, TILE_SIZE);
 }
 
@@ -3307,6 +3324,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     NULL, NULL, /* get_prefs, set_prefs */
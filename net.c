@@ -2137,6 +2137,7 @@ struct game_drawstate {
     int width, height;
     int tilesize;
     unsigned long *visible, *to_draw;
+    tile_cache *tiles;          /* keyed on the tile word, for still tiles */
 };
 
 /* ----------------------------------------------------------------------
@@ -2539,6 +2540,7 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
     ds->visible = snewn(ncells, unsigned long);
     ds->to_draw = snewn(ncells, unsigned long);
     ds->tilesize = 0;                  /* undecided yet */
+    ds->tiles = NULL;
     for (i = 0; i < ncells; i++)
         ds->visible[i] = -1;
 
@@ -2551,6 +2553,7 @@ static game_drawstate *game_new_drawstate(drawing *dr, const game_state *state)
 
 static void game_free_drawstate(drawing *dr, game_drawstate *ds)
 {
+    tile_cache_free(dr, ds->tiles);
     sfree(ds->visible);
     sfree(ds->to_draw);
     sfree(ds);
@@ -2571,6 +2574,8 @@ static void game_set_size(drawing *dr, game_drawstate *ds,
                           const game_params *params, int tilesize)
 {
     ds->tilesize = tilesize;
+    tile_cache_free(dr, ds->tiles);
+    ds->tiles = tile_cache_new(dr, TILE_SIZE, TILE_SIZE);
 }
 
 static float *game_colours(frontend *fe, int *ncolours)
@@ -2711,6 +2716,7 @@ static void draw_tile(drawing *dr, game_drawstate *ds, int x, int y,
     int bg, d, dsh, pass;
     int cx, cy, radius;
     float matrix[4];
+    bool cacheable;
 
     tx = WINDOW_OFFSET + TILE_SIZE * x + border_br;
     ty = WINDOW_OFFSET + TILE_SIZE * y + border_br;
@@ -2733,6 +2739,19 @@ static void draw_tile(drawing *dr, game_drawstate *ds, int x, int y,
     }
     clipw = clipX - clipx;
     cliph = clipY - clipy;
+
+    /*
+     * A tile inside the grid that isn't mid-rotation is drawn
+     * entirely from the tile word, so we can reuse an earlier
+     * drawing of the same word.
+     */
+    cacheable = (x >= 0 && x < ds->width && y >= 0 && y < ds->height &&
+                 !(tile & TILE_ROTATING));
+    if (cacheable && tile_cache_draw(dr, ds->tiles, tile, tx, ty)) {
+        draw_update(dr, clipx, clipy, clipw, cliph);
+        return;
+    }
+
     clip(dr, clipx, clipy, clipw, cliph);
 
     /*
@@ -2913,6 +2932,9 @@ static void draw_tile(drawing *dr, game_drawstate *ds, int x, int y,
             draw_rect(dr, tx+TILE_SIZE-bbr, ty+TILE_SIZE-bbr, bbr, bbr, col);
     }
 
+    if (cacheable)
+        tile_cache_store(dr, ds->tiles, tile, tx, ty);
+
     /*
      * Unclip and draw update, to finish.
      */
@@ -3337,6 +3359,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     false, NULL, NULL, /* can_format_as_text_now, text_format */
     get_prefs, set_prefs,
@@ -2,9 +2,14 @@
  * nullfe.c: Null front-end code containing a bunch of boring stub
  * functions. Used to ensure successful linking when building the
  * various stand-alone solver binaries.
+ *
+ * A drawing made with a non-NULL handle takes it to be a struct
+ * draw_stats, and counts what's drawn into it, so a tool can see
+ * what a back end's redraw asks for without anything to draw on.
  */
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "puzzles.h"
 
@@ -14,32 +19,52 @@ void get_random_seed(void **randseed, int *randseedsize)
 void deactivate_timer(frontend *fe) {}
 void activate_timer(frontend *fe) {}
 drawing *drawing_new(const drawing_api *api, midend *me, void *handle)
-{ return snew(drawing); }
+{ drawing *dr = snew(drawing); dr->api = api; dr->handle = handle; return dr; }
 void drawing_free(drawing *dr) { sfree(dr); }
+static void count(drawing *dr, int kind)
+{ if (dr && dr->handle) ((struct draw_stats *)dr->handle)->prims[kind]++; }
 void draw_text(drawing *dr, int x, int y, int fonttype, int fontsize,
-               int align, int colour, const char *text) {}
-void draw_rect(drawing *dr, int x, int y, int w, int h, int colour) {}
+               int align, int colour, const char *text)
+{
+    count(dr, DRAWSTAT_TEXT);
+    if (dr && dr->handle)
+        ((struct draw_stats *)dr->handle)->text_chars += strlen(text);
+}
+void draw_rect(drawing *dr, int x, int y, int w, int h, int colour)
+{ count(dr, DRAWSTAT_RECT); }
 #ifndef STANDALONE_POLYGON
-void draw_line(drawing *dr, int x1, int y1, int x2, int y2, int colour) {}
+void draw_line(drawing *dr, int x1, int y1, int x2, int y2, int colour)
+{ count(dr, DRAWSTAT_LINE); }
 #endif
 void draw_thick_line(drawing *dr, float thickness,
-		     float x1, float y1, float x2, float y2, int colour) {}
+		     float x1, float y1, float x2, float y2, int colour)
+{ count(dr, DRAWSTAT_THICK_LINE); }
 void draw_polygon(drawing *dr, const int *coords, int npoints,
-                  int fillcolour, int outlinecolour) {}
+                  int fillcolour, int outlinecolour)
+{ count(dr, DRAWSTAT_POLYGON); }
 void draw_circle(drawing *dr, int cx, int cy, int radius,
-                 int fillcolour, int outlinecolour) {}
+                 int fillcolour, int outlinecolour)
+{ count(dr, DRAWSTAT_CIRCLE); }
 char *text_fallback(drawing *dr, const char *const *strings, int nstrings)
 { return dupstr(strings[0]); }
-void clip(drawing *dr, int x, int y, int w, int h) {}
+void clip(drawing *dr, int x, int y, int w, int h) { count(dr, DRAWSTAT_CLIP); }
 void unclip(drawing *dr) {}
 void start_draw(drawing *dr) {}
-void draw_update(drawing *dr, int x, int y, int w, int h) {}
+void draw_update(drawing *dr, int x, int y, int w, int h)
+{ if (dr && dr->handle) ((struct draw_stats *)dr->handle)->pixels += w * h; }
 void end_draw(drawing *dr) {}
 struct blitter { char dummy; };
 blitter *blitter_new(drawing *dr, int w, int h) { return snew(blitter); }
 void blitter_free(drawing *dr, blitter *bl) { sfree(bl); }
 void blitter_save(drawing *dr, blitter *bl, int x, int y) {}
-void blitter_load(drawing *dr, blitter *bl, int x, int y) {}
+void blitter_load(drawing *dr, blitter *bl, int x, int y)
+{ count(dr, DRAWSTAT_BLIT); }
+tile_cache *tile_cache_new(drawing *dr, int w, int h) { return NULL; }
+void tile_cache_free(drawing *dr, tile_cache *tc) {}
+bool tile_cache_draw(drawing *dr, tile_cache *tc, unsigned long key,
+                     int x, int y) { return false; }
+void tile_cache_store(drawing *dr, tile_cache *tc, unsigned long key,
+                      int x, int y) {}
 int print_mono_colour(drawing *dr, int grey) { return 0; }
 int print_grey_colour(drawing *dr, float grey) { return 0; }
 int print_hatched_colour(drawing *dr, int hatch) { return 0; }
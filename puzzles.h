@@ -92,6 +92,7 @@ enum {
 typedef struct frontend frontend;
 typedef struct config_item config_item;
 typedef struct midend midend;
+typedef struct midend_generation midend_generation;
 typedef struct random_state random_state;
 typedef struct game_params game_params;
 typedef struct game_state game_state;
@@ -99,6 +100,7 @@ typedef struct game_ui game_ui;
 typedef struct game_drawstate game_drawstate;
 typedef struct game game;
 typedef struct blitter blitter;
+typedef struct tile_cache tile_cache;
 typedef struct document document;
 typedef struct drawing_api drawing_api;
 typedef struct drawing drawing;
@@ -283,6 +285,12 @@ blitter *blitter_new(drawing *dr, int w, int h);
 void blitter_free(drawing *dr, blitter *bl);
 void blitter_save(drawing *dr, blitter *bl, int x, int y);
 void blitter_load(drawing *dr, blitter *bl, int x, int y);
+tile_cache *tile_cache_new(drawing *dr, int w, int h);
+void tile_cache_free(drawing *dr, tile_cache *tc);
+bool tile_cache_draw(drawing *dr, tile_cache *tc, unsigned long key,
+                     int x, int y);
+void tile_cache_store(drawing *dr, tile_cache *tc, unsigned long key,
+                      int x, int y);
 void print_begin_doc(drawing *dr, int pages);
 void print_begin_page(drawing *dr, int number);
 void print_begin_puzzle(drawing *dr, float xm, float xc,
@@ -316,6 +324,21 @@ void midend_size(midend *me, int *x, int *y, bool user_size,
                  double device_pixel_ratio);
 void midend_reset_tilesize(midend *me);
 void midend_new_game(midend *me);
+midend_generation *midend_new_game_start(midend *me);
+void midend_generation_run(midend_generation *gen);
+bool midend_new_game_finish(midend *me, midend_generation *gen);
+void midend_generation_free(midend_generation *gen);
+void midend_new_game_cancel(midend *me);
+void midend_set_pool_size(midend *me, int n);
+midend_generation *midend_pool_refill_start(midend *me);
+void midend_pool_add(midend *me, midend_generation *gen);
+void midend_serialise_pool(midend *me,
+                           void (*write)(void *ctx, const void *buf, int len),
+                           void *wctx);
+const char *midend_deserialise_pool(
+    midend *me, bool (*read)(void *ctx, void *buf, int len), void *rctx);
+void midend_set_history_budget(midend *me, int snapshot_interval,
+                               int max_cached_states);
 void midend_restart_game(midend *me);
 void midend_stop_anim(midend *me);
 enum { PKR_QUIT = 0, PKR_SOME_EFFECT, PKR_NO_EFFECT, PKR_UNUSED };
@@ -351,6 +374,14 @@ void midend_serialise(midend *me,
 const char *midend_deserialise(midend *me,
                                bool (*read)(void *ctx, void *buf, int len),
                                void *rctx);
+void midend_serialise_binary(midend *me,
+                             void (*write)(void *ctx, const void *buf, int len),
+                             void *wctx, bool compress);
+bool midend_serialise_append(midend *me,
+                             void (*write)(void *ctx, const void *buf, int len),
+                             void *wctx, bool compress);
+const char *midend_deserialise_binary(
+    midend *me, bool (*read)(void *ctx, void *buf, int len), void *rctx);
 const char *midend_load_prefs(
     midend *me, bool (*read)(void *ctx, void *buf, int len), void *rctx);
 void midend_save_prefs(midend *me,
@@ -362,6 +393,35 @@ const char *identify_game(char **name,
 void midend_request_id_changes(midend *me, void (*notify)(void *), void *ctx);
 bool midend_get_cursor_location(midend *me, int *x, int *y, int *w, int *h);
 
+/*
+ * Racing independent attempts at generating a puzzle. A front end
+ * with threads to spare registers a runner, whose run() calls
+ * worker(wctx) on up to nworkers threads at once and returns when
+ * they have all returned; without one, attempts are made one at a
+ * time. The latin square solver also borrows it, to search the
+ * branches of a big recursion at once. The atomic_* functions, which
+ * may be NULL, give an int that can be read and written without
+ * taking a lock.
+ */
+struct parallel_runner {
+    int nworkers;
+    void (*run)(void (*worker)(void *wctx), void *wctx, int nworkers);
+    void *(*lock_new)(void);
+    void (*lock)(void *lk);
+    void (*unlock)(void *lk);
+    void (*lock_free)(void *lk);
+    void *(*atomic_new)(int value);
+    int (*atomic_get)(void *at);
+    void (*atomic_set)(void *at, int value);
+    void (*atomic_free)(void *at);
+};
+void set_parallel_runner(const struct parallel_runner *runner);
+const struct parallel_runner *get_parallel_runner(void);
+void *race_attempts(random_state *rs,
+                    void *(*attempt)(void *actx, random_state *rs),
+                    void (*free_result)(void *result), void *actx,
+                    int maxattempts);
+
 /* Printing functions supplied by the mid-end */
 const char *midend_print_puzzle(midend *me, document *doc, bool with_soln);
 int midend_tilesize(midend *me);
@@ -527,6 +587,33 @@ void tdq_add(tdq *tdq, int k);
 int tdq_remove(tdq *tdq);        /* returns -1 if nothing available */
 void tdq_fill(tdq *tdq);         /* add everything to the tdq at once */
 
+/*
+ * setelim.c
+ */
+
+/*
+ * The search at the heart of set elimination in Solo and the latin
+ * square solvers. Given an n-by-n boolean matrix, with n at most 32
+ * and row i passed as a word whose bit j is the entry in column j,
+ * look for sets of between 2 and n-2 columns which at least n minus
+ * that many rows avoid entirely.
+ *
+ * setelim_next returns such sets one at a time, as a word with bit j
+ * set for column j along with a word with bit i set for each row
+ * avoiding them, in the same order as the solvers' original
+ * binary-counting search over `set' arrays (column 0 most
+ * significant) would find them. It returns false when there are no
+ * more.
+ */
+typedef unsigned long setelim_bits;
+typedef struct setelim setelim;
+setelim *setelim_new(int maxn);
+void setelim_free(setelim *se);
+void setelim_start(setelim *se, int n, const setelim_bits *rows);
+bool setelim_next(setelim *se, setelim_bits *set, setelim_bits *rowsok);
+int setelim_popcount(setelim_bits b);
+int setelim_ctz(setelim_bits b);        /* b must be nonzero */
+
 /*
  * laydomino.c
  */
@@ -538,6 +625,54 @@ void domino_layout_prealloc(int w, int h, random_state *rs,
  */
 extern char ver[];
 
+/*
+ * savebin.c
+ */
+bool savefile_is_binary(const void *buf, int len);
+void savefile_binary_header(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx);
+void savefile_binary_record(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    const char *key, const char *val, int len, bool compress);
+const char *savefile_text_to_binary(
+    bool (*read)(void *ctx, void *buf, int len), void *rctx,
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    bool compress);
+const char *savefile_binary_to_text(
+    bool (*read)(void *ctx, void *buf, int len), void *rctx,
+    void (*write)(void *ctx, const void *buf, int len), void *wctx);
+
+/*
+ * drawtrace.c
+ */
+enum { DRAWSTAT_TEXT, DRAWSTAT_RECT, DRAWSTAT_LINE, DRAWSTAT_THICK_LINE,
+       DRAWSTAT_POLYGON, DRAWSTAT_CIRCLE, DRAWSTAT_CLIP, DRAWSTAT_BLIT,
+       DRAWSTAT_NPRIMS };
+struct draw_stats {
+    long prims[DRAWSTAT_NPRIMS];       /* drawing API calls, by kind */
+    long text_chars;
+    long pixels;             /* uploaded, or failing that, draw_update()d */
+    double redraw_ms, raster_ms, upload_ms, present_ms;
+};
+extern const char *const draw_stat_names[DRAWSTAT_NPRIMS];
+typedef struct draw_trace draw_trace;
+draw_trace *draw_trace_new(void);
+void draw_trace_free(draw_trace *tr);
+void draw_trace_span(draw_trace *tr, const char *name, int tid,
+                     double start, double end);
+void draw_trace_counts(draw_trace *tr, const char *name, int tid,
+                       double ts, const struct draw_stats *st);
+void draw_trace_write(draw_trace *tr,
+                      void (*write)(void *ctx, const void *buf, int len),
+                      void *wctx);
+void draw_stats_format(const struct draw_stats *st, char *buf, int len);
+
+/*
+ * batch.c: --generate, --list-presets etc, for front ends without
+ * their own command-line modes.
+ */
+bool batch_main(int argc, char **argv, int *status);
+
 /*
  * random.c
  */
@@ -699,6 +834,9 @@ struct game {
                             const char *desc);
     game_state *(*dup_game)(const game_state *state);
     void (*free_game)(game_state *state);
+    char *(*encode_state)(const game_state *state);
+    game_state *(*decode_state)(const game_state *initial,
+                                const char *encoding);
     bool can_solve;
     char *(*solve)(const game_state *orig, const game_state *curr,
                    const char *aux, const char **error);
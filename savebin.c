@@ -0,0 +1,425 @@
+/*
+ * savebin.c: a compact binary container for saved games, convertible
+ * to and from the text format midend_serialise writes.
+ *
+ * The text format spends 10 or so bytes of header on every record
+ * and has to be rewritten in full whenever anything changes. The
+ * binary form stores the same records, in the same order, as
+ *
+ *  - a one-byte key code: an index into savebin_keys[] below, or 0
+ *    followed by a length byte and the key itself for a key not in
+ *    the table. The top bit is set if the value is compressed.
+ *  - the value length, as an unsigned LEB128 varint.
+ *  - for a compressed value, its compressed length as a second
+ *    varint, then the zlib stream; otherwise the value itself.
+ *
+ * after an 8-byte header giving a magic number and format version.
+ *
+ * A binary save can also be extended in place. The records a front
+ * end appends (see midend_serialise_append) are read as a journal
+ * on top of what came before: a key seen for the second time
+ * replaces the earlier value where it stood, MOVE, SOLVE and RESTART
+ * records (and the CHECKPNT records that go just before some of
+ * them) accumulate in order, and the binary-only TRUNCATE record
+ * discards all but the first n-1 of the moves so far (i.e. cuts the
+ * undo chain to n states), along with the checkpoints for the states
+ * it discards. Converting back to text replays the
+ * journal, so a file converted from text converts back to the
+ * identical bytes, and an appended-to file converts to exactly what
+ * midend_serialise would have written at the time of the last
+ * append. Since every append starts with a TRUNCATE and ends with a
+ * STATEPOS, an append that was cut short (by a crash, say) is
+ * recognisable as such and ignored, leaving the file as it was
+ * before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "puzzles.h"
+
+#define SAVEBIN_VERSION 1
+static const unsigned char savebin_magic[7] = {
+    0x89, 'S', 'G', 'T', 'S', 'A', 'V'
+};
+
+/*
+ * Never reorder or remove entries here: the index is what goes in the
+ * file. New keys go on the end (and don't need a version bump, since
+ * older readers fall back to nothing worse than an error).
+ */
+static const char *const savebin_keys[] = {
+    NULL, /* 0 means a literal key follows */
+    "SAVEFILE", "VERSION", "GAME", "PARAMS", "CPARAMS", "SEED",
+    "HEXSEED", "DESC", "PRIVDESC", "AUXINFO", "UI", "TIME", "NSTATES",
+    "STATEPOS", "MOVE", "SOLVE", "RESTART", "TRUNCATE", "CHECKPNT",
+};
+#define N_SAVEBIN_KEYS lenof(savebin_keys)
+#define SAVEBIN_COMPRESSED 0x80
+
+/* Values shorter than this aren't worth trying to compress. */
+#define SAVEBIN_COMPRESS_MIN 64
+
+bool savefile_is_binary(const void *buf, int len)
+{
+    return (len >= (int)sizeof(savebin_magic) &&
+            !memcmp(buf, savebin_magic, sizeof(savebin_magic)));
+}
+
+static void savebin_write_varint(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    unsigned long val)
+{
+    unsigned char buf[(sizeof(unsigned long) * CHAR_BIT + 6) / 7];
+    int len = 0;
+
+    do {
+        buf[len] = val & 0x7F;
+        val >>= 7;
+        if (val)
+            buf[len] |= 0x80;
+        len++;
+    } while (val);
+    write(wctx, buf, len);
+}
+
+static bool savebin_read_varint(
+    bool (*read)(void *ctx, void *buf, int len), void *rctx, int *out)
+{
+    unsigned long val = 0;
+    int shift = 0;
+    unsigned char c;
+
+    do {
+        if (shift > 28 || !read(rctx, &c, 1))
+            return false;
+        val |= (unsigned long)(c & 0x7F) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    if (val > INT_MAX / 2)
+        return false;
+    *out = val;
+    return true;
+}
+
+void savefile_binary_header(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx)
+{
+    unsigned char version = SAVEBIN_VERSION;
+
+    write(wctx, savebin_magic, sizeof(savebin_magic));
+    write(wctx, &version, 1);
+}
+
+void savefile_binary_record(
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    const char *key, const char *val, int len, bool compress)
+{
+    unsigned char code = 0;
+    int i;
+
+    for (i = 1; i < N_SAVEBIN_KEYS; i++)
+        if (!strcmp(key, savebin_keys[i])) {
+            code = i;
+            break;
+        }
+
+#ifdef HAVE_ZLIB
+    if (compress && len >= SAVEBIN_COMPRESS_MIN) {
+        uLongf zlen = compressBound(len);
+        unsigned char *zbuf = snewn(zlen, unsigned char);
+
+        if (compress2(zbuf, &zlen, (const Bytef *)val, len,
+                      Z_BEST_COMPRESSION) == Z_OK && zlen < (uLongf)len) {
+            code |= SAVEBIN_COMPRESSED;
+            write(wctx, &code, 1);
+            if (!(code & ~SAVEBIN_COMPRESSED)) {
+                unsigned char klen = strlen(key);
+                write(wctx, &klen, 1);
+                write(wctx, key, klen);
+            }
+            savebin_write_varint(write, wctx, len);
+            savebin_write_varint(write, wctx, zlen);
+            write(wctx, zbuf, zlen);
+            sfree(zbuf);
+            return;
+        }
+        sfree(zbuf);
+    }
+#else
+    (void)compress;
+#endif
+
+    write(wctx, &code, 1);
+    if (!code) {
+        unsigned char klen = strlen(key);
+        write(wctx, &klen, 1);
+        write(wctx, key, klen);
+    }
+    savebin_write_varint(write, wctx, len);
+    write(wctx, val, len);
+}
+
+const char *savefile_text_to_binary(
+    bool (*read)(void *ctx, void *buf, int len), void *rctx,
+    void (*write)(void *ctx, const void *buf, int len), void *wctx,
+    bool compress)
+{
+    bool started = false;
+
+    /*
+     * This parses the text records exactly as midend_deserialise
+     * does, but without interpreting them.
+     */
+    while (1) {
+        char key[9], c, *val;
+        int len;
+
+        do {
+            if (!read(rctx, key, 1)) {
+                if (!started)
+                    return "Data does not appear to be a saved game file";
+                return NULL;       /* EOF between records: we're done */
+            }
+        } while (key[0] == '\r' || key[0] == '\n');
+
+        if (!read(rctx, key+1, 8) || key[8] != ':')
+            return "Data was incorrectly formatted for a saved game file";
+        len = strcspn(key, ": ");
+        assert(len <= 8);
+        key[len] = '\0';
+
+        len = 0;
+        while (1) {
+            if (!read(rctx, &c, 1))
+                return "Data was incorrectly formatted for a saved game file";
+            if (c == ':')
+                break;
+            else if (c >= '0' && c <= '9' && len < (INT_MAX - 10) / 10)
+                len = (len * 10) + (c - '0');
+            else
+                return "Data was incorrectly formatted for a saved game file";
+        }
+
+        val = snewn(len+1, char);
+        if (!read(rctx, val, len)) {
+            sfree(val);
+            return "Data was incorrectly formatted for a saved game file";
+        }
+
+        if (!started) {
+            if (strcmp(key, "SAVEFILE")) {
+                sfree(val);
+                return "Data does not appear to be a saved game file";
+            }
+            savefile_binary_header(write, wctx);
+            started = true;
+        }
+        savefile_binary_record(write, wctx, key, val, len, compress);
+        sfree(val);
+    }
+}
+
+struct savebin_record {
+    char key[9];
+    char *val;
+    int len;
+};
+
+static bool savebin_is_move(const char *key)
+{
+    return (!strcmp(key, "MOVE") || !strcmp(key, "SOLVE") ||
+            !strcmp(key, "RESTART"));
+}
+
+/* A checkpoint goes with the move after it. */
+static bool savebin_is_checkpoint(const char *key)
+{
+    return !strcmp(key, "CHECKPNT");
+}
+
+/*
+ * Read one record. Returns NULL on success, or an error message; at a
+ * clean end of file, returns NULL with *key set to the empty string.
+ */
+static const char *savebin_read_record(
+    bool (*read)(void *ctx, void *buf, int len), void *rctx,
+    struct savebin_record *rec)
+{
+    unsigned char code, klen;
+    int len;
+
+    rec->key[0] = '\0';
+    rec->val = NULL;
+    if (!read(rctx, &code, 1))
+        return NULL;
+
+    if (code & ~SAVEBIN_COMPRESSED) {
+        if ((code & ~SAVEBIN_COMPRESSED) >= N_SAVEBIN_KEYS)
+            return "Unrecognised record in binary saved game file";
+        strcpy(rec->key, savebin_keys[code & ~SAVEBIN_COMPRESSED]);
+    } else {
+        if (!read(rctx, &klen, 1) || klen < 1 || klen > 8 ||
+            !read(rctx, rec->key, klen))
+            return "Data was incorrectly formatted for a saved game file";
+        rec->key[klen] = '\0';
+    }
+
+    if (!savebin_read_varint(read, rctx, &len))
+        return "Data was incorrectly formatted for a saved game file";
+    rec->val = snewn(len+1, char);
+    rec->len = len;
+
+    if (code & SAVEBIN_COMPRESSED) {
+#ifdef HAVE_ZLIB
+        int zlen;
+        unsigned char *zbuf;
+        uLongf outlen = len;
+        bool ok;
+
+        if (!savebin_read_varint(read, rctx, &zlen))
+            return "Data was incorrectly formatted for a saved game file";
+        zbuf = snewn(zlen, unsigned char);
+        ok = (read(rctx, zbuf, zlen) &&
+              uncompress((Bytef *)rec->val, &outlen, zbuf, zlen) == Z_OK &&
+              outlen == (uLongf)len);
+        sfree(zbuf);
+        if (!ok)
+            return "Data was incorrectly formatted for a saved game file";
+#else
+        return "This build cannot read compressed saved game files";
+#endif
+    } else if (!read(rctx, rec->val, len)) {
+        return "Data was incorrectly formatted for a saved game file";
+    }
+    rec->val[len] = '\0';
+    return NULL;
+}
+
+const char *savefile_binary_to_text(
+    bool (*read)(void *ctx, void *buf, int len), void *rctx,
+    void (*write)(void *ctx, const void *buf, int len), void *wctx)
+{
+    struct savebin_record *recs = NULL, *out = NULL;
+    int nrecs = 0, recsize = 0, nout = 0, group = -1, i, j;
+    bool tolerant = false;
+    unsigned char hdr[sizeof(savebin_magic) + 1];
+    const char *ret = NULL;
+
+    if (!read(rctx, hdr, sizeof(hdr)) ||
+        !savefile_is_binary(hdr, sizeof(hdr)))
+        return "Data does not appear to be a binary saved game file";
+    if (hdr[sizeof(savebin_magic)] != SAVEBIN_VERSION)
+        return "Cannot handle this version of the binary saved game format";
+
+    /*
+     * First read in every record as it stands.
+     */
+    while (1) {
+        const char *err;
+
+        if (nrecs >= recsize) {
+            recsize = nrecs * 5 / 4 + 16;
+            recs = sresize(recs, recsize, struct savebin_record);
+        }
+        err = savebin_read_record(read, rctx, &recs[nrecs]);
+        if (err) {
+            sfree(recs[nrecs].val);
+            if (!tolerant) {
+                ret = err;
+                goto cleanup;
+            }
+            /*
+             * Something went wrong after the first STATEPOS, which is
+             * where appends begin: an append that didn't reach the
+             * disk in full before a crash, presumably. Stop here, and
+             * throw away whatever we've seen of it below. (If it was
+             * really the original file that was cut short, it won't
+             * have enough moves in it, and midend_deserialise will
+             * say so.)
+             */
+            break;
+        }
+        if (!recs[nrecs].key[0])
+            break;                     /* EOF between records: we're done */
+        if (!strcmp(recs[nrecs].key, "TRUNCATE")) {
+            group = nrecs;
+        } else if (!strcmp(recs[nrecs].key, "STATEPOS")) {
+            group = -1;     /* always the last record of an append */
+            tolerant = true;
+        }
+        nrecs++;
+    }
+    if (group >= 0) {
+        for (i = group; i < nrecs; i++)
+            sfree(recs[i].val);
+        nrecs = group;
+    }
+
+    /*
+     * Now replay them as a journal.
+     */
+    out = snewn(nrecs, struct savebin_record);
+    for (i = 0; i < nrecs; i++) {
+        struct savebin_record *rec = &recs[i];
+
+        if (!strcmp(rec->key, "TRUNCATE")) {
+            int keep = atoi(rec->val) - 1, nmoves = 0, k;
+
+            for (j = k = 0; j < nout; j++) {
+                bool kept = true;
+                if (savebin_is_checkpoint(out[j].key))
+                    kept = nmoves < keep;
+                else if (savebin_is_move(out[j].key))
+                    kept = nmoves++ < keep;
+                if (kept)
+                    out[k++] = out[j];
+            }
+            nout = k;
+            continue;
+        }
+
+        if (!savebin_is_move(rec->key) &&
+            !savebin_is_checkpoint(rec->key)) {
+            for (j = 0; j < nout; j++)
+                if (!strcmp(out[j].key, rec->key))
+                    break;
+            if (j < nout) {
+                out[j] = *rec;
+                continue;
+            }
+        }
+        out[nout++] = *rec;
+    }
+
+    if (nout == 0 || strcmp(out[0].key, "SAVEFILE")) {
+        ret = "Data does not appear to be a saved game file";
+        goto cleanup;
+    }
+
+    for (i = 0; i < nout; i++) {
+        char hbuf[80], lbuf[9];
+
+        copy_left_justified(lbuf, sizeof(lbuf), out[i].key);
+        sprintf(hbuf, "%s:%d:", lbuf, out[i].len);
+        write(wctx, hbuf, strlen(hbuf));
+        write(wctx, out[i].val, out[i].len);
+        write(wctx, "\n", 1);
+    }
+
+  cleanup:
+    /* out[] only ever points at values owned by recs[]. */
+    for (i = 0; i < nrecs; i++)
+        sfree(recs[i].val);
+    sfree(recs);
+    sfree(out);
+    return ret;
+}
@@ -5,10 +5,17 @@
 #include <stdio.h>
 #include <sys/time.h>
 #include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_timer.h>
 #include <cairo/cairo.h>
 #include "puzzles.h"
+#include "tree234.h"
 #include "sdl-fe.h"
 
 
@@ -37,15 +44,475 @@ void frontend_default_colour(frontend *fe, float *output) {
         output[0] = output[1] = output[2] = 1.0F;
 }
 
+static void sdl_post_wakeup(frontend *fe) {
+   SDL_Event wake;
+   if (!fe->wake_event) return;
+   memset(&wake, 0, sizeof(wake));
+   wake.type = fe->wake_event;
+   SDL_PushEvent(&wake);
+}
+
+/*
+ * Puzzle generation runs on its own thread, so that F10 on a slow preset
+ * doesn't freeze the screen. The worker reports back through fe->wake_event;
+ * these two live outside the frontend because a worker can still be
+ * grinding through new_desc after main() has torn the frontend down.
+ */
+static SDL_mutex *generation_lock;
+static bool generation_shutdown;
+
+static int sdl_generation_thread(void *ctx) {
+   struct sdl_generation_job *job = (struct sdl_generation_job *)ctx;
+   SDL_Event done;
+
+   midend_generation_run(job->gen);
+
+   SDL_LockMutex(generation_lock);
+   if (!generation_shutdown && job->wake_event) {
+      memset(&done, 0, sizeof(done));
+      done.type = job->wake_event;
+      done.user.code = job->code;
+      done.user.data1 = job->gen;
+      SDL_PushEvent(&done);
+   } else {
+      midend_generation_free(job->gen);
+   }
+   SDL_UnlockMutex(generation_lock);
+   sfree(job);
+   return 0;
+}
+
+// Lend the generators every core we've got for racing attempts (see race_attempts), and
+// the latin solver for searching big recursions. The threads are started once and live
+// as long as the program; run() only hands work to threads that are idle at that moment
+// and does the rest on the calling thread, so it never waits for a thread that's busy
+// elsewhere, and a worker (a racing attempt, say) can itself call run() without
+// starving or deadlocking the pool.
+#define RUNNER_MAX_THREADS 64
+static SDL_mutex *runner_lock;
+static SDL_cond *runner_wake, *runner_done;
+static struct sdl_runner_job *runner_tasks[RUNNER_MAX_THREADS]; // handed out, not yet picked up
+static int runner_ntasks, runner_idle;
+
+static int sdl_runner_thread(void *ctx) {
+   struct sdl_runner_job *job;
+   SDL_LockMutex(runner_lock);
+   while (true) {
+      while (runner_ntasks == 0) SDL_CondWait(runner_wake, runner_lock);
+      job = runner_tasks[--runner_ntasks];
+      SDL_UnlockMutex(runner_lock);
+      job->worker(job->wctx);
+      SDL_LockMutex(runner_lock);
+      if (--job->running == 0) SDL_CondBroadcast(runner_done);
+      runner_idle++;
+   }
+   return 0;
+}
+
+// Start up to nthreads pool threads, and return how many did.
+static int sdl_runner_start(int nthreads) {
+   SDL_Thread *thread;
+   int i;
+
+   runner_lock = SDL_CreateMutex();
+   runner_wake = SDL_CreateCond();
+   runner_done = SDL_CreateCond();
+   if (!runner_lock || !runner_wake || !runner_done) return 0;
+   SDL_LockMutex(runner_lock);
+   for (i = 0; i < min(nthreads, RUNNER_MAX_THREADS); i++) {
+      if (!(thread = SDL_CreateThread(sdl_runner_thread, "worker", NULL))) break;
+      SDL_DetachThread(thread);
+      runner_idle++;
+   }
+   SDL_UnlockMutex(runner_lock);
+   return i;
+}
+
+static void sdl_run_workers(void (*worker)(void *wctx), void *wctx, int nworkers) {
+   struct sdl_runner_job job;
+   int i;
+
+   job.worker = worker;
+   job.wctx = wctx;
+   job.running = 0;
+   if (runner_lock) {
+      SDL_LockMutex(runner_lock);
+      for (i = 1; i < nworkers && runner_idle > 0; i++) {
+         runner_idle--;
+         runner_tasks[runner_ntasks++] = &job;
+         job.running++;
+      }
+      if (job.running) SDL_CondBroadcast(runner_wake);
+      SDL_UnlockMutex(runner_lock);
+   }
+   worker(wctx); // this thread is always a worker, and carries on alone if no others were idle
+   if (runner_lock) {
+      // Under the lock even if nobody else took part, so that their work is all visible.
+      SDL_LockMutex(runner_lock);
+      while (job.running) SDL_CondWait(runner_done, runner_lock);
+      SDL_UnlockMutex(runner_lock);
+   }
+}
+
+static void *sdl_runner_lock_new(void) { return SDL_CreateMutex(); }
+static void sdl_runner_lock(void *lk) { SDL_LockMutex((SDL_mutex *)lk); }
+static void sdl_runner_unlock(void *lk) { SDL_UnlockMutex((SDL_mutex *)lk); }
+static void sdl_runner_lock_free(void *lk) { SDL_DestroyMutex((SDL_mutex *)lk); }
+static void *sdl_runner_atomic_new(int value) {
+   SDL_atomic_t *at = snew(SDL_atomic_t);
+   SDL_AtomicSet(at, value);
+   return at;
+}
+static int sdl_runner_atomic_get(void *at) { return SDL_AtomicGet((SDL_atomic_t *)at); }
+static void sdl_runner_atomic_set(void *at, int value) { SDL_AtomicSet((SDL_atomic_t *)at, value); }
+static void sdl_runner_atomic_free(void *at) { sfree(at); }
+
+static struct parallel_runner sdl_runner = {
+   1, sdl_run_workers,
+   sdl_runner_lock_new, sdl_runner_lock, sdl_runner_unlock, sdl_runner_lock_free,
+   sdl_runner_atomic_new, sdl_runner_atomic_get, sdl_runner_atomic_set, sdl_runner_atomic_free,
+};
+
+static bool sdl_spawn_generation(frontend *fe, midend_generation *gen, int code) {
+   struct sdl_generation_job *job;
+   SDL_Thread *thread;
+
+   if (!generation_lock) return false;
+   job = snew(struct sdl_generation_job);
+   job->gen = gen;
+   job->wake_event = fe->wake_event;
+   job->code = code;
+   thread = SDL_CreateThread(sdl_generation_thread, "generate", job);
+   if (!thread) {
+      sfree(job);
+      return false;
+   }
+   SDL_DetachThread(thread);
+   return true;
+}
+
+static void sdl_start_generation(frontend *fe) {
+   // Starting a new one supersedes any generation still running; the midend
+   // will throw that one's result away when it turns up. If the pool has a
+   // game ready, the worker has nothing to do and hands it straight back.
+   midend_generation *gen = midend_new_game_start(fe->me);
+
+   if (sdl_spawn_generation(fe, gen, WAKE_GENERATED)) {
+      fe->generating++;
+      printf("Generating a new game of '%s'...\n", thegame.name);
+      fflush(stdout);
+   } else {
+      // No threads to be had: do it the old way and just block.
+      midend_generation_run(gen);
+      sdl_finish_generation(fe, gen);
+   }
+}
+
+// Top up the pool for the current preset, one game at a time, whenever
+// nothing else is going on.
+static void sdl_refill_pool(frontend *fe) {
+   midend_generation *gen;
+   if (fe->refilling || fe->generating || fe->timer_running) return;
+   gen = midend_pool_refill_start(fe->me);
+   if (!gen) return;
+   if (sdl_spawn_generation(fe, gen, WAKE_POOLED))
+      fe->refilling = 1;
+   else
+      midend_generation_free(gen); // no background threads, no pool
+}
+
+static char *sdl_prefs_path(const char *suffix) {
+   // Same places gtk.c keeps its preferences.
+   const char *var;
+   char *dir, *path;
+   if ((var = getenv("SGT_PUZZLES_DIR")) != NULL) {
+      dir = dupstr(var);
+   } else if ((var = getenv("XDG_CONFIG_HOME")) != NULL) {
+      dir = snewn(strlen(var) + 20, char);
+      sprintf(dir, "%s/sgt-puzzles", var);
+   } else if ((var = getenv("HOME")) != NULL) {
+      dir = snewn(strlen(var) + 32, char);
+      sprintf(dir, "%s/.config/sgt-puzzles", var);
+   } else {
+      return NULL;
+   }
+   mkdir(dir, 0777); // it's fine if it already exists
+   path = make_prefs_path(dir, "/", &thegame, suffix);
+   sfree(dir);
+   return path;
+}
+
+static bool savefile_read(void *rctx, void *buf, int len) {
+   FILE *fp = (FILE *)rctx;
+   return fread(buf, 1, len, fp) == len;
+}
+
+static void savefile_write(void *wctx, const void *buf, int len) {
+   struct savefile_write_ctx *ctx = (struct savefile_write_ctx *)wctx;
+   if (fwrite(buf, 1, len, ctx->fp) < len)
+      ctx->error = errno;
+}
+
+static void sdl_load_pool(frontend *fe) {
+   char *path;
+   const char *err;
+   FILE *fp;
+   if (!fe->pool_size) return; // leave any spooled games for when the pool is back on
+   if (!(path = sdl_prefs_path(".pool"))) return;
+   if ((fp = fopen(path, "r")) != NULL) {
+      err = midend_deserialise_pool(fe->me, savefile_read, fp);
+      if (err)
+         fprintf(stderr, "Ignoring pool file %s: %s\n", path, err);
+      fclose(fp);
+   }
+   sfree(path);
+}
+
+// Spool the pool to disk, via a temporary file so a power cut can't leave half of one.
+static void sdl_save_pool(frontend *fe) {
+   char *path, *tmp;
+   struct savefile_write_ctx wctx;
+   if (!fe->pool_size) return;
+   path = sdl_prefs_path(".pool");
+   tmp = sdl_prefs_path(".pool.tmp");
+   if (path && tmp && (wctx.fp = fopen(tmp, "w")) != NULL) {
+      wctx.error = 0;
+      midend_serialise_pool(fe->me, savefile_write, &wctx);
+      if (fclose(wctx.fp) != 0) wctx.error = errno;
+      if (wctx.error || rename(tmp, path) != 0)
+         remove(tmp);
+   }
+   sfree(path);
+   sfree(tmp);
+}
+
+/*
+ * Autosave. The game in progress lives in a binary save file (savebin.c) which
+ * is rewritten in full only when a new game starts or the file has grown too
+ * much; otherwise each move just appends what midend_serialise_append gives us.
+ * The UI thread only ever serialises into fe->autosave.pending; the writer
+ * thread does all the file I/O, and batches up the fsyncs.
+ */
+static void sdl_autosave_write(void *wctx, const void *buf, int len) {
+   struct sdl_autosave *as = (struct sdl_autosave *)wctx;
+   if (as->pendlen + len > as->pendsize) {
+      as->pendsize = as->pendlen + len + 1024;
+      as->pending = sresize(as->pending, as->pendsize, char);
+   }
+   memcpy(as->pending + as->pendlen, buf, len);
+   as->pendlen += len;
+}
+
+static int sdl_write_all(int fd, const char *buf, int len) {
+   while (len > 0) {
+      ssize_t ret = write(fd, buf, len);
+      if (ret < 0) {
+         if (errno == EINTR) continue;
+         return -1;
+      }
+      buf += ret;
+      len -= ret;
+   }
+   return 0;
+}
+
+// Replace the save file with buf, so that after a crash it's either all of the
+// old one or all of the new one. Leaves as->fd open on it for appending.
+static int sdl_autosave_replace(struct sdl_autosave *as, const char *buf, int len) {
+   char *dir, *slash;
+   int fd = open(as->tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (fd < 0) return -1;
+   if (sdl_write_all(fd, buf, len) < 0 || fsync(fd) < 0) {
+      close(fd);
+      unlink(as->tmppath);
+      return -1;
+   }
+   close(fd);
+   if (rename(as->tmppath, as->path) < 0) {
+      unlink(as->tmppath);
+      return -1;
+   }
+   // ... and make the rename itself stick.
+   dir = dupstr(as->path);
+   if ((slash = strrchr(dir, '/')) != NULL) {
+      *slash = '\0';
+      if ((fd = open(dir, O_RDONLY)) >= 0) {
+         fsync(fd);
+         close(fd);
+      }
+   }
+   sfree(dir);
+   as->fd = open(as->path, O_WRONLY | O_APPEND);
+   return 0;
+}
+
+static int sdl_autosave_thread(void *ctx) {
+   struct sdl_autosave *as = (struct sdl_autosave *)ctx;
+   char *buf = NULL, *tmp;
+   int len, size = 0, tmpsize, rewrite, remove, err;
+   SDL_LockMutex(as->lock);
+   while (1) {
+      while (!as->pendlen && !as->remove && !as->stop)
+         SDL_CondWait(as->cond, as->lock);
+      if (!as->stop && !as->remove) {
+         // Give the next few moves a chance to share this fsync.
+         Uint64 deadline = SDL_GetTicks64() + AUTOSAVE_BATCH_MS, now;
+         while (!as->stop && (now = SDL_GetTicks64()) < deadline)
+            SDL_CondWaitTimeout(as->cond, as->lock, (Uint32)(deadline - now));
+      }
+      if (!as->pendlen && !as->remove) break; // only got here because of stop
+      // Swap buffers, so the UI can carry on filling the other one.
+      tmp = as->pending; as->pending = buf; buf = tmp;
+      len = as->pendlen; as->pendlen = 0;
+      tmpsize = as->pendsize; as->pendsize = size; size = tmpsize;
+      rewrite = as->rewrite; remove = as->remove;
+      as->rewrite = as->remove = 0;
+      SDL_UnlockMutex(as->lock);
+
+      err = 0;
+      if (remove || rewrite) {
+         if (as->fd >= 0) close(as->fd);
+         as->fd = -1;
+      }
+      if (remove) {
+         unlink(as->path);
+      } else if (rewrite) {
+         err = sdl_autosave_replace(as, buf, len);
+      } else if (as->fd < 0) {
+         err = -1; // nothing to append to
+      } else if (sdl_write_all(as->fd, buf, len) < 0 || fdatasync(as->fd) < 0) {
+         err = -1;
+      }
+      if (err)
+         fprintf(stderr, "Autosave to %s failed: %s\n", as->path, strerror(errno));
+
+      SDL_LockMutex(as->lock);
+      if (err) as->need_full = 1;
+   }
+   SDL_UnlockMutex(as->lock);
+   sfree(buf);
+   if (as->fd >= 0) close(as->fd);
+   as->fd = -1;
+   return 0;
+}
+
+static void sdl_autosave_start(frontend *fe) {
+   struct sdl_autosave *as = &fe->autosave;
+   as->path = sdl_prefs_path(".save");
+   as->tmppath = sdl_prefs_path(".save.tmp");
+   as->fd = -1;
+   as->need_full = 1;
+   if (!as->path || !as->tmppath) return;
+   as->lock = SDL_CreateMutex();
+   as->cond = SDL_CreateCond();
+   if (as->lock && as->cond)
+      as->thread = SDL_CreateThread(sdl_autosave_thread, "autosave", as);
+}
+
+// Flush whatever is still queued, and wait for it to reach the disk.
+static void sdl_autosave_stop(frontend *fe) {
+   struct sdl_autosave *as = &fe->autosave;
+   if (as->thread) {
+      SDL_LockMutex(as->lock);
+      as->stop = 1;
+      SDL_CondSignal(as->cond);
+      SDL_UnlockMutex(as->lock);
+      SDL_WaitThread(as->thread, NULL);
+      as->thread = NULL;
+   }
+   if (as->cond) SDL_DestroyCond(as->cond);
+   if (as->lock) SDL_DestroyMutex(as->lock);
+   sfree(as->pending);
+   sfree(as->path);
+   sfree(as->tmppath);
+}
+
+// Called after anything that might have changed the game. Costs one move's worth of
+// serialising, nothing at all if the undo chain didn't change, and a full rewrite when
+// the file is due one.
+void save_game_to_disk(frontend *fe) {
+   struct sdl_autosave *as = &fe->autosave;
+   if (!as->thread) return;
+   SDL_LockMutex(as->lock);
+   if (midend_status(fe->me) > 0) {
+      // Solved, so there's nothing to come back to.
+      if (!as->need_full || as->pendlen) {
+         as->pendlen = 0;
+         as->rewrite = 0;
+         as->remove = 1;
+         as->need_full = 1;
+      }
+   } else {
+      int before = as->pendlen;
+      bool full = as->need_full || !midend_serialise_append(fe->me, sdl_autosave_write, as, true);
+      if (!full) {
+         if (as->pendlen == before) {
+            // The undo chain hasn't changed (a cursor move, say), so there's nothing to sync.
+            SDL_UnlockMutex(as->lock);
+            return;
+         }
+         as->journal_bytes += as->pendlen - before;
+         full = as->journal_bytes > AUTOSAVE_COMPACT_RATIO * as->full_bytes + AUTOSAVE_COMPACT_SLACK;
+      }
+      if (full) {
+         as->pendlen = 0;
+         midend_serialise_binary(fe->me, sdl_autosave_write, as, true);
+         as->rewrite = 1;
+         as->remove = 0;
+         as->need_full = 0;
+         as->full_bytes = as->pendlen;
+         as->journal_bytes = 0;
+      }
+   }
+   SDL_CondSignal(as->cond);
+   SDL_UnlockMutex(as->lock);
+}
+
+// true if load succeeded, false otherwise.
+int load_game_from_disk(frontend *fe) {
+   struct sdl_autosave *as = &fe->autosave;
+   const char *err;
+   FILE *fp;
+   if (!as->path || (fp = fopen(as->path, "rb")) == NULL) return 0;
+   err = midend_deserialise_binary(fe->me, savefile_read, fp);
+   fclose(fp);
+   if (err) {
+      fprintf(stderr, "Ignoring saved game %s: %s\n", as->path, err);
+      return 0;
+   }
+   // The file may end in half an append from a crash, which the load skipped
+   // but a new append would land after; so start it afresh next time.
+   as->need_full = 1;
+   return 1;
+}
+
+static void sdl_finish_generation(frontend *fe, midend_generation *gen) {
+   char *game_id;
+   if (!midend_new_game_finish(fe->me, gen))
+      return; // cancelled or superseded while it was cooking
+   midend_redraw(fe->me);
+   save_game_to_disk(fe);
+   game_id = midend_get_game_id(fe->me);
+   printf("The GameID for game '%s' is: %s\n",thegame.name, game_id);
+   fflush(stdout);
+   sfree(game_id);
+}
+
 void activate_timer(frontend *fe) { // SDL_AddTimer is a threaded abomination. Not what we want.
-   fe->old_timer_ticks=SDL_GetTicks64();
+   // The midend calls this on every tick while it is animating, so only the
+   // idle -> running transition restarts the clock and pokes the main loop.
+   if (fe->timer_running) return;
+   fe->old_timer_ticks=SDL_GetPerformanceCounter();
    fe->timer_running=1;
+   sdl_post_wakeup(fe);
 //   printf("activating timer.\n");
 }
 
 void deactivate_timer(frontend *fe) {
+   if (!fe->timer_running) return;
    fe->timer_running=0;
    fe->old_timer_ticks=0;
+   sdl_post_wakeup(fe);
 //   printf("deactivating timer.\n");
 }
 
@@ -53,12 +520,12 @@ static void draw_fill(frontend *fe) {
    cairo_fill(fe->cr);
 }
 
-static void draw_fill_preserve(frontend *fe) {
-   cairo_fill_preserve(fe->cr);
+static void draw_fill_preserve(cairo_t *cr) {
+   cairo_fill_preserve(cr);
 }
 
-static void draw_set_colour(frontend *fe, int colour) {
-    cairo_set_source_rgb(fe->cr,
+static void draw_set_colour(frontend *fe, cairo_t *cr, int colour) {
+    cairo_set_source_rgb(cr,
                         fe->colours[3*colour + 0], 
                         fe->colours[3*colour + 1],
                         fe->colours[3*colour + 2]);
@@ -69,186 +536,809 @@ void sdl_drawing_free(drawing* dr) {
    sfree(fe); 
 }
 
+static int sdl_glyph_run_cmp(void *av, void *bv) {
+   const struct sdl_glyph_run *a = (const struct sdl_glyph_run *)av;
+   const struct sdl_glyph_run *b = (const struct sdl_glyph_run *)bv;
+   if (a->fonttype != b->fonttype) return a->fonttype < b->fonttype ? -1 : 1;
+   if (a->fontsize != b->fontsize) return a->fontsize < b->fontsize ? -1 : 1;
+   return strcmp(a->text, b->text);
+}
+
+static void sdl_glyph_cache_clear(frontend *fe) {
+   struct sdl_glyph_run *run;
+   if (!fe->glyphs) return;
+   while ((run = delpos234(fe->glyphs, 0)) != NULL) {
+      if (run->mask) cairo_surface_destroy(run->mask);
+      sfree(run->text);
+      sfree(run);
+   }
+}
+
+// Look up text in the glyph cache, rendering it if it isn't there. The mask holds
+// coverage only, so one entry serves every colour the text is drawn in.
+static struct sdl_glyph_run *sdl_glyph_run(frontend *fe, int fonttype, int fontsize, const char *text) {
+   struct sdl_glyph_run key, *run;
+   int l, t, r, b;
+   key.fonttype = fonttype;
+   key.fontsize = fontsize;
+   key.text = (char *)text;
+   if ((run = find234(fe->glyphs, &key, NULL)) != NULL) return run;
+   if (count234(fe->glyphs) >= GLYPH_CACHE_MAX) {
+      sdl_flush_draw_ops(fe); // they may point into the cache
+      sdl_glyph_cache_clear(fe);
+   }
+
+   run = snew(struct sdl_glyph_run);
+   run->fonttype = fonttype;
+   run->fontsize = fontsize;
+   run->text = dupstr(text);
+   run->mask = NULL;
+   run->ox = run->oy = 0;
+   cairo_set_font_size(fe->cr, fontsize);
+   cairo_text_extents(fe->cr, text, &run->extents);
+   if (run->extents.width > 0 && run->extents.height > 0) {
+      cairo_t *mcr;
+      // A pixel of slack all round, for antialiasing that strays outside the ink.
+      l = (int)floor(run->extents.x_bearing) - 1;
+      t = (int)floor(run->extents.y_bearing) - 1;
+      r = (int)ceil(run->extents.x_bearing + run->extents.width) + 1;
+      b = (int)ceil(run->extents.y_bearing + run->extents.height) + 1;
+      run->mask = cairo_image_surface_create(CAIRO_FORMAT_A8, r - l, b - t);
+      run->ox = -l;
+      run->oy = -t;
+      // Same font and settings as fe->cr, and the same whole-pixel origin as the
+      // text would have had there, so the coverage comes out the same.
+      mcr = cairo_create(run->mask);
+      cairo_select_font_face(mcr, SDL_FONT_FACE, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+      cairo_set_antialias(mcr, CAIRO_ANTIALIAS_GRAY);
+      cairo_set_font_size(mcr, fontsize);
+      cairo_move_to(mcr, run->ox, run->oy);
+      cairo_show_text(mcr, text);
+      cairo_destroy(mcr);
+   }
+   add234(fe->glyphs, run);
+   return run;
+}
+
+/*
+ * The drawing API calls don't draw anything themselves: they append to
+ * fe->ops, and sdl_flush_draw_ops plays the list back into cairo at the end of
+ * the frame (or sooner, if something needs the pixels). Playing back, each
+ * rect or line starts a path that picks up every later rect or line of the same
+ * colour it can reach without jumping over anything it overlaps, so a board of
+ * tiles costs a fill or stroke per colour rather than per tile.
+ */
+static struct sdl_draw_op *sdl_new_draw_op(frontend *fe, int type, int colour) {
+   struct sdl_draw_op *op;
+   if (fe->nops >= fe->opsize) {
+      fe->opsize = fe->nops * 5 / 4 + 256;
+      fe->ops = sresize(fe->ops, fe->opsize, struct sdl_draw_op);
+   }
+   op = &fe->ops[fe->nops++];
+   memset(op, 0, sizeof(*op));
+   op->type = type;
+   op->colour = colour;
+   op->outline = -1;
+   return op;
+}
+
+static void sdl_draw_op_bbox(struct sdl_draw_op *op, double l, double u, double r, double d, double slack) {
+   op->l = (int)floor(l - slack);
+   op->u = (int)floor(u - slack);
+   op->r = (int)ceil(r + slack);
+   op->d = (int)ceil(d + slack);
+}
+
+static bool sdl_draw_ops_overlap(const struct sdl_draw_op *a, const struct sdl_draw_op *b) {
+   return a->l < b->r && b->l < a->r && a->u < b->d && b->u < a->d;
+}
+
 void sdl_draw_text(drawing *dr, int x, int y, int fonttype, int fontsize, int align, int colour, const char *text) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   cairo_text_extents_t extents;
-   int origx=x, origy=y;
+   struct sdl_glyph_run *run;
+   struct sdl_draw_op *op;
    fontsize=fontsize*fe->fontscale;
-   draw_set_colour(fe,colour);
-   cairo_set_font_size(fe->cr, fontsize);
-   cairo_text_extents(fe->cr, text, &extents); 
+   fe->frame.prims[DRAWSTAT_TEXT]++;
+   fe->frame.text_chars += strlen(text);
+   run = sdl_glyph_run(fe, fonttype, fontsize, text);
    if (align & ALIGN_VCENTRE) {
-	   y += extents.height / 2;
+	   y += run->extents.height / 2;
    } else { // ALIGN_VNORMAL
 	   //SGT and Cairo agree that the baseline = vertical origin.
    }
    if (align & ALIGN_HCENTRE) {
-	   x -= extents.x_advance / 2; // extents.width makes a dog's dinner of measuring the width of '1'
+	   x -= run->extents.x_advance / 2; // extents.width makes a dog's dinner of measuring the width of '1'
    } else if (align & ALIGN_HRIGHT) {
-	  x -= extents.x_advance;
+	  x -= run->extents.x_advance;
    } else {//ALIGN_HLEFT
    }
-   cairo_move_to(fe->cr, x, y);
-   cairo_show_text(fe->cr, text);
-   //sdl_draw_circle(dr,origx,origy,2,1,2);
+   if (!run->mask) return;
+   op = sdl_new_draw_op(fe, DRAW_OP_TEXT, colour);
+   op->run = run;
+   op->x1 = x - run->ox;
+   op->y1 = y - run->oy;
+   sdl_draw_op_bbox(op, op->x1, op->y1, op->x1 + cairo_image_surface_get_width(run->mask),
+                    op->y1 + cairo_image_surface_get_height(run->mask), 0);
 }
 
 void sdl_draw_rect(drawing *dr, int x, int y, int w, int h, int colour) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   draw_set_colour(fe, colour);
-   cairo_save(fe->cr);
-   cairo_new_path(fe->cr);
-   cairo_set_antialias(fe->cr, CAIRO_ANTIALIAS_NONE);
-   cairo_rectangle(fe->cr, x, y, w, h);
-   cairo_fill(fe->cr); 
-   cairo_restore(fe->cr);
-   //printf("Drew a rect\n");
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_RECT, colour);
+   fe->frame.prims[DRAWSTAT_RECT]++;
+   op->x1 = x; op->y1 = y; op->x2 = w; op->y2 = h;
+   sdl_draw_op_bbox(op, x, y, x + w, y + h, 0); // not antialiased, so exact
 }
 
 void sdl_draw_line(drawing *dr, int x1, int y1, int x2, int y2, int colour) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   draw_set_colour(fe, colour);
-   cairo_new_path(fe->cr);
-   cairo_move_to(fe->cr, x1 + 0.5, y1 + 0.5);
-   cairo_line_to(fe->cr, x2 + 0.5, y2 + 0.5);
-   cairo_stroke(fe->cr);
-   //printf("Drew a line\n");
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_LINE, colour);
+   fe->frame.prims[DRAWSTAT_LINE]++;
+   op->x1 = x1; op->y1 = y1; op->x2 = x2; op->y2 = y2;
+   // Square caps reach half a pixel past the ends; antialiasing half a pixel more.
+   sdl_draw_op_bbox(op, min(x1, x2), min(y1, y2), max(x1, x2) + 1, max(y1, y2) + 1, 1);
 }
 
 void sdl_draw_thick_line(drawing *dr, float thickness, float x1, float y1, float x2, float y2, int colour) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   draw_set_colour(fe, colour);
-   cairo_save(fe->cr);
-   cairo_set_line_width(fe->cr, thickness);
-   cairo_new_path(fe->cr);
-   cairo_move_to(fe->cr, x1, y1);
-   cairo_line_to(fe->cr, x2, y2);
-   cairo_stroke(fe->cr);
-   cairo_restore(fe->cr);
-   //printf("Drew a THICC line\n");
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_THICK_LINE, colour);
+   fe->frame.prims[DRAWSTAT_THICK_LINE]++;
+   op->fx1 = x1; op->fy1 = y1; op->fx2 = x2; op->fy2 = y2;
+   op->thickness = thickness;
+   // A square cap's corner can stick out thickness/sqrt(2) past the end, on a diagonal.
+   sdl_draw_op_bbox(op, min(x1, x2), min(y1, y2), max(x1, x2), max(y1, y2), thickness * 0.75 + 1);
 }
 
 void sdl_draw_polygon(drawing *dr, const int *coords, int npoints,  int fillcolour, int outlinecolour) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   int i;
-   cairo_new_path(fe->cr);
-   for (i = 0; i < npoints; i++)
-	   cairo_line_to(fe->cr, coords[i*2] + 0.5, coords[i*2 + 1] + 0.5);
-   cairo_close_path(fe->cr);
-   if (fillcolour >= 0) {
-     draw_set_colour(fe, fillcolour);
-	  draw_fill_preserve(fe);
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_POLYGON, fillcolour);
+   int i, l = coords[0], r = coords[0], u = coords[1], d = coords[1];
+   fe->frame.prims[DRAWSTAT_POLYGON]++;
+   op->outline = outlinecolour;
+   op->npoints = npoints;
+   op->coords = snewn(npoints * 2, int);
+   memcpy(op->coords, coords, npoints * 2 * sizeof(int));
+   for (i = 1; i < npoints; i++) {
+      l = min(l, coords[i*2]); r = max(r, coords[i*2]);
+      u = min(u, coords[i*2 + 1]); d = max(d, coords[i*2 + 1]);
    }
-   //assert(outlinecolour >= 0);
-   draw_set_colour(fe, outlinecolour);
-   cairo_stroke(fe->cr);
-   //printf("drew an %i-sided polygon\n", npoints);
+   sdl_draw_op_bbox(op, l, u, r + 1, d + 1, 1);
 }
 
 void sdl_draw_circle(drawing *dr, int cx, int cy, int radius, int fillcolour, int outlinecolour) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   cairo_new_path(fe->cr);
-   cairo_arc(fe->cr, cx + 0.5, cy + 0.5, radius, 0, 2*PI);
-   cairo_close_path(fe->cr);		/* Just in case... */
-   if (fillcolour >= 0) {
-	   draw_set_colour(fe, fillcolour);
-	   draw_fill_preserve(fe);
-   }
-   //assert(outlinecolour >= 0);
-   draw_set_colour(fe, outlinecolour);
-   cairo_stroke(fe->cr);
-   //printf("Drew a circle\n");
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_CIRCLE, fillcolour);
+   fe->frame.prims[DRAWSTAT_CIRCLE]++;
+   op->outline = outlinecolour;
+   op->x1 = cx; op->y1 = cy; op->x2 = radius;
+   sdl_draw_op_bbox(op, cx - radius, cy - radius, cx + radius + 1, cy + radius + 1, 1);
 }
 
 void sdl_clip(drawing *dr, int x, int y, int w, int h) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   //printf("clipped something\n");
-   cairo_new_path(fe->cr);
-   cairo_rectangle(fe->cr, x, y, w, h);
-   cairo_clip(fe->cr);
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_CLIP, -1);
+   fe->frame.prims[DRAWSTAT_CLIP]++;
+   op->x1 = x; op->y1 = y; op->x2 = w; op->y2 = h;
 }
 
 void sdl_unclip(drawing *dr) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   //printf("unclipped a thing\n");
-   cairo_reset_clip(fe->cr);
+   sdl_new_draw_op(fe, DRAW_OP_UNCLIP, -1);
 }
 
-void sdl_start_draw(drawing *dr) {
-   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+static void sdl_path_op(cairo_t *cr, const struct sdl_draw_op *op) {
+   if (op->type == DRAW_OP_RECT) {
+      cairo_rectangle(cr, op->x1, op->y1, op->x2, op->y2);
+   } else {
+      cairo_move_to(cr, op->x1 + 0.5, op->y1 + 0.5);
+      cairo_line_to(cr, op->x2 + 0.5, op->y2 + 0.5);
+   }
+}
+
+// A rect covers whole pixels, and so does a horizontal or vertical line, so one can
+// share a path with others of its kind that it overlaps without changing a thing. A
+// diagonal line's antialiasing would come out differently where they meet.
+static bool sdl_draw_op_exact(const struct sdl_draw_op *op) {
+   return op->type == DRAW_OP_RECT ||
+      (op->type == DRAW_OP_LINE && (op->x1 == op->x2 || op->y1 == op->y2));
+}
+
+// Chain onto ops[i] (through op->next) whatever later rects or lines can join its
+// path, and mark them done so they aren't drawn again on their own.
+static void sdl_plan_batch(frontend *fe, int i) {
+   struct sdl_draw_op *ops = fe->ops, *first = &ops[i], *last = first;
+   const struct sdl_draw_op *blockers[DRAW_BATCH_BLOCKERS];
+   int j, k, nblockers = 0;
+
+   first->next = -1;
+   if (!sdl_draw_op_exact(first))
+      blockers[nblockers++] = first;
+
+   for (j = i + 1; j < fe->nops && j < i + DRAW_BATCH_LOOKAHEAD; j++) {
+      struct sdl_draw_op *op = &ops[j];
+      bool ok;
+      if (op->done) continue;
+      if (op->type == DRAW_OP_CLIP || op->type == DRAW_OP_UNCLIP) break;
+      ok = (op->type == first->type && op->colour == first->colour);
+      // Blockers are things still to be drawn after this path, which it mustn't
+      // paint over; and diagonal lines already in it, which it mustn't cross.
+      for (k = 0; ok && k < nblockers; k++)
+         if (sdl_draw_ops_overlap(op, blockers[k]))
+            ok = false;
+      if (ok) {
+         last->next = j;
+         last = op;
+         op->next = -1;
+         op->done = true;
+         if (sdl_draw_op_exact(op)) continue;
+      }
+      if (nblockers == DRAW_BATCH_BLOCKERS) break;
+      blockers[nblockers++] = op;
+   }
+}
+
+static bool sdl_draw_op_in_band(const struct sdl_draw_op *op, const struct sdl_band *band) {
+   return op->u < band->d && op->d > band->u;
+}
+
+static bool sdl_clip_is_whole(frontend *fe, const SDL_Rect *clip) {
+   return clip->x == 0 && clip->y == 0 &&
+      clip->w == fe->sdl_surface->w && clip->h == fe->sdl_surface->h;
+}
+
+static void sdl_apply_clip(frontend *fe, cairo_t *cr, const SDL_Rect *clip) {
+   cairo_reset_clip(cr);
+   if (sdl_clip_is_whole(fe, clip)) return;
+   cairo_new_path(cr);
+   cairo_rectangle(cr, clip->x, clip->y, clip->w, clip->h);
+   cairo_clip(cr);
+}
+
+// Draw the path that starts at ops[i], leaving out the parts that miss the band.
+static void sdl_replay_batch(frontend *fe, struct sdl_band *band, int i) {
+   const struct sdl_draw_op *first = &fe->ops[i], *op;
+   bool any = false;
+
+   cairo_new_path(band->cr);
+   for (op = first; ; op = &fe->ops[op->next]) {
+      if (sdl_draw_op_in_band(op, band)) {
+         sdl_path_op(band->cr, op);
+         any = true;
+      }
+      if (op->next < 0) break;
+   }
+   if (!any) return;
+
+   draw_set_colour(fe, band->cr, first->colour);
+   if (first->type == DRAW_OP_RECT) {
+      cairo_save(band->cr);
+      cairo_set_antialias(band->cr, CAIRO_ANTIALIAS_NONE);
+      cairo_fill(band->cr);
+      cairo_restore(band->cr);
+   } else {
+      cairo_stroke(band->cr);
+   }
+}
+
+// Play the planned display list into one band. This only reads fe->ops, so several
+// bands can be played back at once.
+static void sdl_replay_draw_ops(frontend *fe, struct sdl_band *band) {
+   cairo_t *cr = band->cr;
+   int i, k;
+
+   for (i = 0; i < fe->nops; i++) {
+      const struct sdl_draw_op *op = &fe->ops[i];
+      if (op->done) continue;
+      // Clips change the state for everything after them, wherever they are; a
+      // batch's own ops may reach the band even if its first one doesn't.
+      if (op->type != DRAW_OP_CLIP && op->type != DRAW_OP_UNCLIP &&
+          op->type != DRAW_OP_RECT && op->type != DRAW_OP_LINE &&
+          !sdl_draw_op_in_band(op, band))
+         continue;
+      switch (op->type) {
+         case DRAW_OP_RECT:
+         case DRAW_OP_LINE:
+            sdl_replay_batch(fe, band, i);
+            break;
+         case DRAW_OP_THICK_LINE:
+            draw_set_colour(fe, cr, op->colour);
+            cairo_save(cr);
+            cairo_set_line_width(cr, op->thickness);
+            cairo_new_path(cr);
+            cairo_move_to(cr, op->fx1, op->fy1);
+            cairo_line_to(cr, op->fx2, op->fy2);
+            cairo_stroke(cr);
+            cairo_restore(cr);
+            break;
+         case DRAW_OP_POLYGON:
+            cairo_new_path(cr);
+            for (k = 0; k < op->npoints; k++)
+               cairo_line_to(cr, op->coords[k*2] + 0.5, op->coords[k*2 + 1] + 0.5);
+            cairo_close_path(cr);
+            if (op->colour >= 0) {
+               draw_set_colour(fe, cr, op->colour);
+               draw_fill_preserve(cr);
+            }
+            draw_set_colour(fe, cr, op->outline);
+            cairo_stroke(cr);
+            break;
+         case DRAW_OP_CIRCLE:
+            cairo_new_path(cr);
+            cairo_arc(cr, op->x1 + 0.5, op->y1 + 0.5, op->x2, 0, 2*PI);
+            cairo_close_path(cr);		/* Just in case... */
+            if (op->colour >= 0) {
+               draw_set_colour(fe, cr, op->colour);
+               draw_fill_preserve(cr);
+            }
+            draw_set_colour(fe, cr, op->outline);
+            cairo_stroke(cr);
+            break;
+         case DRAW_OP_TEXT:
+            draw_set_colour(fe, cr, op->colour);
+            if (band->image == fe->image) {
+               cairo_mask_surface(cr, op->run->mask, op->x1, op->y1);
+            } else {
+               // cairo doesn't promise one surface can be a source on several threads
+               // at once, so each band masks through its own view of the same pixels.
+               cairo_surface_t *mask = cairo_image_surface_create_for_data(
+                  cairo_image_surface_get_data(op->run->mask), CAIRO_FORMAT_A8,
+                  cairo_image_surface_get_width(op->run->mask),
+                  cairo_image_surface_get_height(op->run->mask),
+                  cairo_image_surface_get_stride(op->run->mask));
+               cairo_mask_surface(cr, mask, op->x1, op->y1);
+               cairo_surface_destroy(mask);
+            }
+            break;
+         case DRAW_OP_BLIT:
+            sdl_blitter_copy(fe, op->bl, op->x1, op->y1, band);
+            break;
+         case DRAW_OP_CLIP:
+            band->clip.x = op->x1; band->clip.y = op->y1; band->clip.w = op->x2; band->clip.h = op->y2;
+            sdl_apply_clip(fe, cr, &band->clip);
+            break;
+         case DRAW_OP_UNCLIP:
+            band->clip.x = band->clip.y = 0;
+            band->clip.w = fe->sdl_surface->w; band->clip.h = fe->sdl_surface->h;
+            cairo_reset_clip(cr);
+            break;
+      }
+   }
+}
+
+static void sdl_band_worker(void *wctx) {
+   struct sdl_band_job *job = (struct sdl_band_job *)wctx;
+   int b;
+   while ((b = SDL_AtomicAdd(&job->next, 1)) < job->nbands)
+      sdl_replay_draw_ops(job->fe, &job->bands[b]);
+}
+
+// How many bands to split this display list into: one, unless it's big enough (a
+// full redraw, typically) to be worth starting threads for.
+static int sdl_draw_bands(frontend *fe) {
+   int n = fe->draw_threads * 2; // a few spare, so a slow band doesn't hold the rest up
+   if (fe->draw_threads < 2 || fe->nops < DRAW_BAND_MIN_OPS) return 1;
+   n = min(n, fe->sdl_surface->h / DRAW_BAND_MIN_HEIGHT);
+   return max(n, 1);
+}
+
+// Each band gets its own surface and context on its own rows of sdl_surface, offset
+// so that it draws in window coordinates. The bands are whole rows apart, so every
+// op's pixels come out exactly as they would playing the list into fe->cr; each band
+// just only gets the rows that are its own.
+static void sdl_replay_banded(frontend *fe, int nbands) {
+   struct sdl_band_job job;
+   unsigned char *pixels = fe->sdl_surface->pixels;
+   int w = fe->sdl_surface->w, h = fe->sdl_surface->h, pitch = fe->sdl_surface->pitch;
+   int b;
+
+   cairo_surface_flush(fe->image);
+   job.fe = fe;
+   job.nbands = nbands;
+   job.bands = snewn(nbands, struct sdl_band);
+   SDL_AtomicSet(&job.next, 0);
+   for (b = 0; b < nbands; b++) {
+      struct sdl_band *band = &job.bands[b];
+      band->u = h * b / nbands;
+      band->d = h * (b + 1) / nbands;
+      band->image = cairo_image_surface_create_for_data(pixels + band->u * pitch,
+         CAIRO_FORMAT_RGB24, w, band->d - band->u, pitch);
+      cairo_surface_set_device_offset(band->image, 0, -band->u);
+      band->cr = cairo_create(band->image);
+      sdl_setup_cairo(band->cr);
+      band->clip = fe->clip;
+      sdl_apply_clip(fe, band->cr, &band->clip);
+   }
+
+   sdl_run_workers(sdl_band_worker, &job, min(fe->draw_threads, nbands));
+
+   for (b = 0; b < nbands; b++) {
+      cairo_destroy(job.bands[b].cr);
+      cairo_surface_destroy(job.bands[b].image);
+   }
+   // Leave fe->cr clipped the way the list left every band, as if it had drawn it.
+   fe->clip = job.bands[0].clip;
+   sdl_apply_clip(fe, fe->cr, &fe->clip);
+   cairo_surface_mark_dirty(fe->image);
+   sfree(job.bands);
+}
+
+static void sdl_flush_draw_ops(frontend *fe) {
+   Uint64 start = SDL_GetPerformanceCounter();
+   int i, nbands;
+
+   for (i = 0; i < fe->nops; i++) {
+      struct sdl_draw_op *op = &fe->ops[i];
+      if (!op->done && (op->type == DRAW_OP_RECT || op->type == DRAW_OP_LINE))
+         sdl_plan_batch(fe, i);
+   }
+
+   nbands = sdl_draw_bands(fe);
+   if (nbands > 1) {
+      sdl_replay_banded(fe, nbands);
+   } else if (fe->nops) {
+      struct sdl_band band;
+      band.image = fe->image;
+      band.cr = fe->cr;
+      band.u = 0;
+      band.d = fe->sdl_surface->h;
+      band.clip = fe->clip;
+      sdl_replay_draw_ops(fe, &band);
+      fe->clip = band.clip;
+   }
+
+   for (i = 0; i < fe->nops; i++)
+      if (fe->ops[i].type == DRAW_OP_POLYGON)
+         sfree(fe->ops[i].coords);
+   if (fe->nops)
+      sdl_trace_span(fe, "raster", start, &fe->frame.raster_ms);
+   fe->nops = 0;
+}
+
+static void sdl_free_backbuffer(frontend *fe) {
+   if (fe->cr) sdl_flush_draw_ops(fe); // nothing should be left by now, but don't leak it
+   sdl_glyph_cache_clear(fe); // sized for the old window
+   if (fe->cr) cairo_destroy(fe->cr);
+   if (fe->image) cairo_surface_destroy(fe->image);
+   if (fe->texture) SDL_DestroyTexture(fe->texture);
+   if (fe->sdl_surface) SDL_FreeSurface(fe->sdl_surface);
+   fe->cr = NULL;
+   fe->image = NULL;
+   fe->texture = NULL;
+   fe->sdl_surface = NULL;
+}
+
+// One surface, one cairo context and one streaming texture for the life of the window.
+// Only a resize throws them away and builds new ones.
+static void sdl_setup_backbuffer(frontend *fe, int width, int height) {
+   sdl_free_backbuffer(fe);
+   fe->sdl_surface = SDL_CreateRGBSurface( 0, width, height, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0 );
+   if( fe->sdl_surface == NULL ) {
+      SDL_Log( "SDL_CreateRGBSurface() failed: %s\n", SDL_GetError() );
+      exit( EXIT_FAILURE );
+   }
+   fe->texture = SDL_CreateTexture( fe->renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, width, height );
+   if( fe->texture == NULL ) {
+      SDL_Log( "SDL_CreateTexture() failed: %s\n", SDL_GetError() );
+      exit( EXIT_FAILURE );
+   }
+   fe->image = cairo_image_surface_create_for_data( (unsigned char *) fe->sdl_surface->pixels, CAIRO_FORMAT_RGB24, fe->sdl_surface->w, fe->sdl_surface->h, fe->sdl_surface->pitch );
+   fe->cr = cairo_create(fe->image);
+   sdl_setup_cairo(fe->cr);
+   sdl_reset_clip(fe);
+   sdl_reset_damage(fe);
+}
+
+// Every context the display list is played into starts out like this.
+static void sdl_setup_cairo(cairo_t *cr) {
+   cairo_select_font_face (cr, SDL_FONT_FACE, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+   cairo_set_antialias(cr, CAIRO_ANTIALIAS_GRAY);
+   cairo_set_line_width(cr, 1.0);
+   cairo_set_line_cap(cr, CAIRO_LINE_CAP_SQUARE);
+   cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+}
+
+static void sdl_reset_clip(frontend *fe) {
+   fe->clip.x = 0;
+   fe->clip.y = 0;
+   fe->clip.w = fe->sdl_surface->w;
+   fe->clip.h = fe->sdl_surface->h;
+}
+
+static void sdl_reset_damage(frontend *fe) {
+   fe->ndamage = 0;
    fe->bbox_l = fe->sdl_surface->w;
    fe->bbox_r = 0;
    fe->bbox_u = fe->sdl_surface->h;
    fe->bbox_d = 0;
-   //SDL_FillRect( fe->sdl_surface, NULL, SDL_MapRGB( fe->sdl_surface->format, 255, 255, 255 ) );
-   fe->image = cairo_image_surface_create_for_data( (unsigned char *) fe->sdl_surface->pixels, CAIRO_FORMAT_RGB24, fe->sdl_surface->w, fe->sdl_surface->h, fe->sdl_surface->pitch );
-   fe->cr = cairo_create(fe->image);
-   cairo_select_font_face (fe->cr,  "@cairo:monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-   cairo_set_antialias(fe->cr, CAIRO_ANTIALIAS_GRAY);
-   cairo_set_line_width(fe->cr, 1.0);
-   cairo_set_line_cap(fe->cr, CAIRO_LINE_CAP_SQUARE);
-   cairo_set_line_join(fe->cr, CAIRO_LINE_JOIN_ROUND);
-   //printf("Starting a draw\n");
 }
 
-void sdl_draw_update(drawing *dr, int x, int y, int w, int h) {
-   // this seems to expand the "dirty area" that will be refreshed on the next end_draw. I could just refresh everything?
-   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+static int rect_area(const SDL_Rect *r) {
+   return r->w * r->h;
+}
+
+static void rect_union(SDL_Rect *out, const SDL_Rect *a, const SDL_Rect *b) {
+   int l = min(a->x, b->x), u = min(a->y, b->y);
+   int r = max(a->x + a->w, b->x + b->w), d = max(a->y + a->h, b->y + b->h);
+   out->x = l; out->y = u; out->w = r - l; out->h = d - u;
+}
+
+// Two damage rects are worth merging if the union costs no more upload than the pair
+// plus a little slack (a row of tiles that were drawn one at a time, say).
+static bool rects_should_merge(const SDL_Rect *a, const SDL_Rect *b) {
+   SDL_Rect u;
+   rect_union(&u, a, b);
+   return rect_area(&u) <= rect_area(a) + rect_area(b) + 64 * 64;
+}
+
+static void sdl_add_damage(frontend *fe, int x, int y, int w, int h) {
+   SDL_Rect r;
+   int i, best = -1, bestgrowth = 0;
+
+   // Clamp to the surface; backends happily draw_update slightly off the edge.
+   if (x < 0) { w += x; x = 0; }
+   if (y < 0) { h += y; y = 0; }
+   if (x + w > fe->sdl_surface->w) w = fe->sdl_surface->w - x;
+   if (y + h > fe->sdl_surface->h) h = fe->sdl_surface->h - y;
+   if (w <= 0 || h <= 0) return;
+   r.x = x; r.y = y; r.w = w; r.h = h;
+
    if (fe->bbox_l > x  ) fe->bbox_l = x  ;
    if (fe->bbox_r < x+w) fe->bbox_r = x+w;
    if (fe->bbox_u > y  ) fe->bbox_u = y  ;
    if (fe->bbox_d < y+h) fe->bbox_d = y+h;
+
+   if (fe->ndamage < MAX_DAMAGE_RECTS) {
+      fe->damage[fe->ndamage++] = r;
+      return;
+   }
+   // Out of slots: grow whichever existing rect swallows this one most cheaply.
+   for (i = 0; i < fe->ndamage; i++) {
+      SDL_Rect u;
+      int growth;
+      rect_union(&u, &fe->damage[i], &r);
+      growth = rect_area(&u) - rect_area(&fe->damage[i]);
+      if (best < 0 || growth < bestgrowth) {
+         best = i;
+         bestgrowth = growth;
+      }
+   }
+   rect_union(&fe->damage[best], &fe->damage[best], &r);
+}
+
+static void sdl_merge_damage(frontend *fe) {
+   bool merged;
+   int i, j;
+
+   do {
+      merged = false;
+      for (i = 0; i < fe->ndamage; i++)
+         for (j = i+1; j < fe->ndamage; j++)
+            if (rects_should_merge(&fe->damage[i], &fe->damage[j])) {
+               rect_union(&fe->damage[i], &fe->damage[i], &fe->damage[j]);
+               fe->damage[j--] = fe->damage[--fe->ndamage];
+               merged = true;
+            }
+   } while (merged);
+}
+
+void sdl_start_draw(drawing *dr) {
+   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+   // The context outlives the frame now, so don't let a stray clip or path leak into the next one.
+   cairo_reset_clip(fe->cr);
+   cairo_new_path(fe->cr);
+   sdl_reset_clip(fe);
+   fe->draw_start = SDL_GetPerformanceCounter();
+   //printf("Starting a draw\n");
+}
+
+void sdl_draw_update(drawing *dr, int x, int y, int w, int h) {
+   // Everything outside the rects handed to us here is assumed unchanged since the last frame.
+   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+   sdl_add_damage(fe, x, y, w, h);
 }
 
 void sdl_end_draw(drawing *dr) {
+   // The main loop presents whatever has accumulated in the damage list once per
+   // display refresh, however many redraws the midend asked for.
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   //printf("end_draw, I should probably poke SDL to render or something\n");
-   //I Guess I have to make a repaint happen here? 
-   SDL_Texture * texture = SDL_CreateTextureFromSurface( fe->renderer, fe->sdl_surface );
-   SDL_RenderCopy( fe->renderer, texture, NULL, NULL ) ;
+   // Up to here was the backend deciding what to draw; the flush is cairo drawing it.
+   sdl_trace_span(fe, "game_redraw", fe->draw_start, &fe->frame.redraw_ms);
+   sdl_flush_draw_ops(fe);
+}
+
+static double sdl_trace_usecs(frontend *fe, Uint64 t) {
+   return (double)(t - fe->trace_origin) * 1000000.0 / SDL_GetPerformanceFrequency();
+}
+
+// Add the time since start to *ms, and to the trace if there is one.
+static void sdl_trace_span(frontend *fe, const char *name, Uint64 start, double *ms) {
+   Uint64 end = SDL_GetPerformanceCounter();
+   *ms += (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+   if (fe->trace)
+      draw_trace_span(fe->trace, name, 0, sdl_trace_usecs(fe, start), sdl_trace_usecs(fe, end));
+}
+
+// The overlay is drawn by the renderer over the game's texture, so it never touches
+// sdl_surface, and the backend's idea of what's on screen stays right. It shows the
+// last frame that was finished, since this one's present hasn't happened yet.
+static void sdl_draw_overlay(frontend *fe) {
+   const struct draw_stats *st = &fe->last_frame;
+   char line[256];
+   SDL_Rect dst;
+   cairo_t *cr;
+   int i, len;
+
+   if (!fe->overlay_texture) {
+      fe->overlay_texture = SDL_CreateTexture( fe->renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, OVERLAY_W, OVERLAY_H );
+      if (!fe->overlay_texture) {
+         SDL_Log( "SDL_CreateTexture() failed: %s\n", SDL_GetError() );
+         fe->overlay = 0;
+         return;
+      }
+      fe->overlay_image = cairo_image_surface_create(CAIRO_FORMAT_RGB24, OVERLAY_W, OVERLAY_H);
+   }
+
+   cr = cairo_create(fe->overlay_image);
+   cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+   cairo_paint(cr);
+   cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+   cairo_select_font_face(cr, "@cairo:monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+   cairo_set_font_size(cr, 11);
+   draw_stats_format(st, line, sizeof(line));
+   cairo_move_to(cr, 4, 13);
+   cairo_show_text(cr, line);
+   len = 0;
+   for (i = 0; i < DRAWSTAT_NPRIMS; i++)
+      len += snprintf(line + len, sizeof(line) - len, "%s %ld  ", draw_stat_names[i], st->prims[i]);
+   cairo_move_to(cr, 4, 28);
+   cairo_show_text(cr, line);
+   cairo_destroy(cr);
+   cairo_surface_flush(fe->overlay_image);
+
+   SDL_UpdateTexture( fe->overlay_texture, NULL, cairo_image_surface_get_data(fe->overlay_image),
+                      cairo_image_surface_get_stride(fe->overlay_image) );
+   dst.x = dst.y = 0;
+   dst.w = OVERLAY_W;
+   dst.h = OVERLAY_H;
+   SDL_RenderCopy( fe->renderer, fe->overlay_texture, NULL, &dst );
+}
+
+static void sdl_write_trace(frontend *fe) {
+   struct savefile_write_ctx ctx;
+   ctx.error = 0;
+   ctx.fp = fopen(fe->trace_path, "w");
+   if (!ctx.fp) {
+      perror(fe->trace_path);
+      return;
+   }
+   draw_trace_write(fe->trace, savefile_write, &ctx);
+   if (fclose(ctx.fp) || ctx.error)
+      fprintf(stderr, "%s: write failed\n", fe->trace_path);
+}
+
+static void sdl_present(frontend *fe) {
+   const unsigned char *pixels = fe->sdl_surface->pixels;
+   int pitch = fe->sdl_surface->pitch;
+   Uint64 now, start;
+   int i;
+
+   if (fe->ndamage == 0) {
+      // Nothing moved, so don't upload or present at all. Input that changed
+      // nothing on screen has no latency to measure; don't let it inflate the
+      // next sample.
+      fe->stats.input_pending = 0;
+      return;
+   }
+
+   cairo_surface_flush( fe->image );
+   start = SDL_GetPerformanceCounter();
+   sdl_merge_damage(fe);
+   for (i = 0; i < fe->ndamage; i++) {
+      const SDL_Rect *r = &fe->damage[i];
+      SDL_UpdateTexture( fe->texture, r, pixels + r->y * pitch + r->x * 4, pitch );
+      fe->frame.pixels += rect_area(r);
+   }
+   sdl_reset_damage(fe);
+   sdl_trace_span(fe, "upload", start, &fe->frame.upload_ms);
+
+   // The renderer's backbuffer is undefined after a present, so it always gets the whole
+   // texture. That copy stays on the GPU; the upload above is the bandwidth we care about.
+   start = SDL_GetPerformanceCounter();
+   SDL_RenderCopy( fe->renderer, fe->texture, NULL, NULL ) ;
+   if (fe->overlay)
+      sdl_draw_overlay(fe);
    SDL_RenderPresent( fe->renderer );
-   SDL_DestroyTexture( texture );
+   sdl_trace_span(fe, "present", start, &fe->frame.present_ms);
+
+   if (fe->trace)
+      draw_trace_counts(fe->trace, "frame", 0, sdl_trace_usecs(fe, start), &fe->frame);
+   fe->last_frame = fe->frame;
+   memset(&fe->frame, 0, sizeof(fe->frame));
+
+   now = SDL_GetPerformanceCounter();
+   fe->stats.presents++;
+   if (fe->timer_running && fe->last_present &&
+       now - fe->last_present > fe->frame_period + fe->frame_period / 2)
+      fe->stats.late++;
+   fe->last_present = now;
 
-   cairo_surface_destroy( fe->image );
-   cairo_destroy( fe->cr );
+   if (fe->stats.input_pending) {
+      double ms = (now - fe->stats.input_pending) * 1000.0 / SDL_GetPerformanceFrequency();
+      fe->stats.latency_total += ms;
+      if (ms > fe->stats.latency_max) fe->stats.latency_max = ms;
+      fe->stats.latency_samples++;
+      fe->stats.input_pending = 0;
+   }
 }
 
+// Blitters never go near cairo. Everything is drawn straight into sdl_surface's
+// pixels, so saving a sprite's background and putting it back is a memcpy per row,
+// and a blitter costs one allocation rather than a surface and a context.
 blitter *sdl_blitter_new(drawing *dr, int w, int h) { 
-   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
    blitter *bl = snew(blitter);
-   bl->image = NULL;
    bl->w = w;
    bl->h = h;
+   bl->pixels = snewn((size_t)max(w * h, 1) * 4, unsigned char);
    return bl;
  }
 
 void sdl_blitter_free(drawing *dr, blitter *bl) { 
-   if (bl->image)
-      cairo_surface_destroy(bl->image);
+   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+   sdl_flush_draw_ops(fe); // a queued blit may still want it
+   sfree(bl->pixels);
    sfree(bl); 
 }
 
+// Copy between bl and the same-sized rectangle of the backbuffer at (x,y). Only the
+// part on the surface is copied; loading into a band, only the part that is inside
+// both the band and its clip.
+static void sdl_blitter_copy(frontend *fe, blitter *bl, int x, int y, struct sdl_band *band) {
+   unsigned char *pixels = fe->sdl_surface->pixels;
+   int pitch = fe->sdl_surface->pitch;
+   int l = max(x, 0), u = max(y, 0);
+   int r = min(x + bl->w, fe->sdl_surface->w), d = min(y + bl->h, fe->sdl_surface->h);
+   int row;
+
+   if (band) {
+      l = max(l, band->clip.x);
+      u = max(u, max(band->clip.y, band->u));
+      r = min(r, band->clip.x + band->clip.w);
+      d = min(d, min(band->clip.y + band->clip.h, band->d));
+   }
+   if (l >= r || u >= d) return;
+   cairo_surface_flush(band ? band->image : fe->image);
+   for (row = u; row < d; row++) {
+      unsigned char *screen = pixels + row * pitch + l * 4;
+      unsigned char *saved = bl->pixels + ((size_t)(row - y) * bl->w + (l - x)) * 4;
+      if (band)
+         memcpy(screen, saved, (r - l) * 4);
+      else
+         memcpy(saved, screen, (r - l) * 4);
+   }
+   if (band)
+      cairo_surface_mark_dirty_rectangle(band->image, l, u, r - l, d - u);
+}
+
 void sdl_blitter_save(drawing *dr, blitter *bl, int x, int y) {
-       frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-    cairo_t *cr;
-    if (!bl->image)
-        bl->image = cairo_surface_create_similar(fe->image, CAIRO_CONTENT_COLOR, bl->w, bl->h);
-    cr = cairo_create(bl->image);
-    cairo_set_source_surface(cr, fe->image, -x, -y);
-    cairo_paint(cr);
-    cairo_destroy(cr);
+   frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+   sdl_flush_draw_ops(fe); // we want the pixels as of now
+   sdl_blitter_copy(fe, bl, x, y, NULL);
 }
 
+// Queued like any other drawing, so a board redrawn from cached tiles doesn't
+// flush the display list once per tile. bl->pixels only change in a save, which
+// flushes first, so they are still what we were asked for at playback.
 void sdl_blitter_load(drawing *dr, blitter *bl, int x, int y) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
-   cairo_save(fe->cr);
-   cairo_set_source_surface(fe->cr, bl->image, x, y);
-   cairo_paint(fe->cr);
-   cairo_restore(fe->cr);
+   struct sdl_draw_op *op = sdl_new_draw_op(fe, DRAW_OP_BLIT, -1);
+   fe->frame.prims[DRAWSTAT_BLIT]++;
+   op->bl = bl;
+   op->x1 = x; op->y1 = y;
+   sdl_draw_op_bbox(op, x, y, x + bl->w, y + bl->h, 0);
 }
 
 void sdl_status_bar(drawing *dr, const char *text) {
    frontend *fe = GET_HANDLE_AS_TYPE(dr, frontend);
+   sdl_flush_draw_ops(fe);
    cairo_save(fe->cr);
    cairo_set_source_rgb(fe->cr, 0.0, 0.0, 0.0);
    cairo_rectangle(fe->cr, 700, 0 , 20, 480);
@@ -261,6 +1351,7 @@ void sdl_status_bar(drawing *dr, const char *text) {
    
    cairo_show_text(fe->cr, text);
    cairo_restore(fe->cr);
+   sdl_add_damage(fe, 700, 0, 20, 480);
    //printf("status bar isn't '%s'\n",text);
 }
 
@@ -273,21 +1364,54 @@ frontend* frontend_new(){
    fe->old_timer_ticks=0;
    fe->timer_running=0;
    fe->fontscale=1.5;
+   fe->sdl_surface=NULL;
+   fe->texture=NULL;
+   fe->image=NULL;
+   fe->cr=NULL;
+   fe->wake_event=0;
+   fe->generating=0;
+   fe->refilling=0;
+   fe->pool_size=0;
+   memset(&fe->stats, 0, sizeof(fe->stats));
+   memset(&fe->autosave, 0, sizeof(fe->autosave));
+   fe->glyphs = newtree234(sdl_glyph_run_cmp);
+   fe->ops = NULL;
+   fe->nops = fe->opsize = 0;
+   {
+      const char *e = getenv("PUZZLES_DRAW_THREADS");
+      fe->draw_threads = e ? max(atoi(e), 1) : SDL_GetCPUCount();
+   }
+   fe->stats.report = getenv("PUZZLES_SDL_STATS") != NULL;
+   memset(&fe->frame, 0, sizeof(fe->frame));
+   memset(&fe->last_frame, 0, sizeof(fe->last_frame));
+   fe->draw_start = 0;
+   fe->overlay = getenv("PUZZLES_SDL_OVERLAY") != NULL;
+   fe->overlay_image = NULL;
+   fe->overlay_texture = NULL;
+   fe->trace_path = getenv("PUZZLES_SDL_TRACE");
+   fe->trace = fe->trace_path ? draw_trace_new() : NULL;
+   fe->trace_origin = SDL_GetPerformanceCounter();
    return fe;
 }
 
-int main( void ) {
+int main( int argc, char **argv ) {
    int width      = 720; 
    int height     = 480;
    int videoFlags = SDL_WINDOW_FULLSCREEN;
    double x;
    double y;
    char *game_id;
-   frontend* fe = frontend_new();
-   fe->me=midend_new(fe, &thegame, &sdl_drawing, fe);
-   
+   frontend* fe;
+   int status;
    SDL_Event event;
 
+   // --generate and friends never open a window.
+   if (batch_main(argc, argv, &status))
+      return status;
+
+   fe = frontend_new();
+   fe->me=midend_new(fe, &thegame, &sdl_drawing, fe);
+   midend_set_history_budget(fe->me, HISTORY_SNAPSHOT_INTERVAL, HISTORY_CACHED_STATES);
 
    if( ( SDL_Init( SDL_INIT_VIDEO ) != 0 ) ) {
       SDL_Log( "Unable to initialize SDL: %s.\n", SDL_GetError() );
@@ -303,13 +1427,27 @@ int main( void ) {
       SDL_Log( "Could not create Renderer: %s.\n", SDL_GetError() );
       exit( EXIT_FAILURE );
    }
-   fe->sdl_surface = SDL_CreateRGBSurface( videoFlags, width, height, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0 );
-   if( fe->sdl_surface == NULL ) {
-      SDL_Log( "SDL_CreateRGBSurface() failed: %s\n", SDL_GetError() );
-      exit( EXIT_FAILURE );
-   }
+   sdl_setup_backbuffer(fe, width, height);
+   sdl_setup_frame_clock(fe);
+   fe->wake_event = SDL_RegisterEvents(1);
+   if (fe->wake_event == (Uint32)-1) fe->wake_event = 0;
+   generation_lock = SDL_CreateMutex();
+   // Enough threads for whichever of generation and banded redraws wants more, but the
+   // generators still get no more workers than there are cores.
+   sdl_runner.nworkers = min(SDL_GetCPUCount(),
+      1 + sdl_runner_start(max(SDL_GetCPUCount(), fe->draw_threads) - 1));
+   set_parallel_runner(&sdl_runner);
 
-   midend_new_game(fe->me);
+   {
+      const char *e = getenv("PUZZLES_POOL_SIZE");
+      fe->pool_size = max(e ? atoi(e) : DEFAULT_POOL_SIZE, 0);
+      midend_set_pool_size(fe->me, fe->pool_size);
+   }
+   sdl_load_pool(fe);
+   sdl_autosave_start(fe);
+   if (!load_game_from_disk(fe))
+      midend_new_game(fe->me);
+   save_game_to_disk(fe);
    midend_size(fe->me, &width, &height, 1, 1.0);
    game_id = midend_get_game_id(fe->me);
    printf("The GameID for game '%s' is: %s\n",thegame.name, game_id);  
@@ -318,47 +1456,43 @@ int main( void ) {
    snaffle_colours(fe);
    midend_force_redraw(fe->me);
 
+   fe->stats.window_start = SDL_GetTicks64();
    while( ! fe->quit ) {
-      SDL_Delay(10); // It would be nice to wait for framesync somewhere, but alas.
-   //honestly, I should be swapping framebuffers right here. sdl_draw_end should not be doing it.   
-      if (fe->timer_running) {
-         //midend_force_redraw(fe->me);
-         Uint64 new_timer_ticks=SDL_GetTicks64();
-         //printf("New Ticks = %d, Old ticks = %d", new_timer_ticks, fe->old_timer_ticks);
-         Uint64 delta = new_timer_ticks - fe->old_timer_ticks;
-         fe->old_timer_ticks=new_timer_ticks;
-         midend_timer(fe->me,delta / 1000.0f);
-      }
-      while( SDL_PollEvent( &event ) ) {
-         switch( event.type ) {
-            case SDL_KEYDOWN:
-            case SDL_KEYUP:
-               nom_key_event(fe, &event);
-               break;
-            case SDL_QUIT:
-               fe->quit = 1;
-               break;
-
-            case SDL_WINDOWEVENT:
-               switch( event.window.event ) {
-                  case SDL_WINDOWEVENT_SIZE_CHANGED:
-                     width = event.window.data1;
-                     height = event.window.data2;
-                     break;
-                  case SDL_WINDOWEVENT_CLOSE:
-                     fe->quit=1;
-                     break;
-               }
-
-               //SDL_FreeSurface( fe->sdl_surface ); 
-               //fe->sdl_surface = SDL_CreateRGBSurface( videoFlags, width, height, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0 );
-            
-            }
-            //printf( "window width  = %d\n" "window height = %d\n", width, height );
+      int timeout, got;
+      // At most one present per trip round the loop, and with PRESENTVSYNC that
+      // means at most one per display refresh.
+      sdl_present(fe);
+      timeout = sdl_next_timeout(fe);
+      if (timeout < 0) sdl_refill_pool(fe); // about to go idle, so put the time to use
+      got = (timeout < 0) ? SDL_WaitEvent( &event ) : SDL_WaitEventTimeout( &event, timeout );
+      fe->stats.wakeups++;
+      if (got) {
+         do {
+            sdl_handle_event(fe, &event);
+         } while( !fe->quit && SDL_PollEvent( &event ) );
       }
+      sdl_frame_step(fe);
+      sdl_loop_stats_tick(fe);
    }
 
+   if (generation_lock) {
+      // Any generation still running will discard its own result.
+      SDL_LockMutex(generation_lock);
+      generation_shutdown = true;
+      SDL_UnlockMutex(generation_lock);
+   }
+   sdl_save_pool(fe);
    save_game_to_disk(fe);
+   sdl_autosave_stop(fe);
+   sdl_free_backbuffer(fe);
+   freetree234(fe->glyphs);
+   sfree(fe->ops);
+   if (fe->trace) {
+      sdl_write_trace(fe);
+      draw_trace_free(fe->trace);
+   }
+   if (fe->overlay_texture) SDL_DestroyTexture(fe->overlay_texture);
+   if (fe->overlay_image) cairo_surface_destroy(fe->overlay_image);
    SDL_DestroyRenderer( fe->renderer );
    SDL_DestroyWindow( fe->window );
    SDL_Quit();
@@ -367,9 +1501,102 @@ int main( void ) {
    return 0;
 }
 
-void save_game_to_disk(frontend *fe){} // if we are in a completed state midend_status(), just delete the file and don't save. 
+static void sdl_setup_frame_clock(frontend *fe) {
+   SDL_DisplayMode mode;
+   int hz = DEFAULT_REFRESH_HZ;
+   if (SDL_GetWindowDisplayMode(fe->window, &mode) == 0 && mode.refresh_rate > 0)
+      hz = mode.refresh_rate;
+   fe->frame_period = SDL_GetPerformanceFrequency() / hz;
+}
 
-int load_game_from_disk(frontend *fe){return 0;}
+// Feed midend_timer in whole display refreshes, so animations advance by the same
+// amount every frame they are shown. Any leftover fraction of a refresh stays on
+// the clock for next time; more than one whole refresh means we dropped frames.
+static void sdl_frame_step(frontend *fe) {
+   Uint64 now, steps;
+   if (!fe->timer_running) return;
+   now = SDL_GetPerformanceCounter();
+   steps = (now - fe->old_timer_ticks) / fe->frame_period;
+   if (steps == 0) return;
+   fe->old_timer_ticks += steps * fe->frame_period;
+   fe->stats.dropped += steps - 1;
+   midend_timer(fe->me, (float)((double)(steps * fe->frame_period) / SDL_GetPerformanceFrequency()));
+}
+
+// How long the main loop may sleep: forever when nothing is animating, otherwise
+// until the next frame step is due.
+static int sdl_next_timeout(frontend *fe) {
+   Uint64 now, due;
+   if (!fe->timer_running) return -1;
+   now = SDL_GetPerformanceCounter();
+   due = fe->old_timer_ticks + fe->frame_period;
+   if (due <= now) return 0;
+   return (int)(((due - now) * 1000 + SDL_GetPerformanceFrequency() - 1) / SDL_GetPerformanceFrequency());
+}
+
+static void sdl_loop_stats_tick(frontend *fe) {
+   Uint64 now = SDL_GetTicks64();
+   if (now - fe->stats.window_start < 1000) return;
+   if (fe->stats.report) {
+      fprintf(stderr, "wakeups/s: %d, presents/s: %d, dropped: %d, late: %d, input-to-present: ",
+              fe->stats.wakeups, fe->stats.presents, fe->stats.dropped, fe->stats.late);
+      if (fe->stats.latency_samples)
+         fprintf(stderr, "avg %.2f ms, max %.2f ms over %d inputs\n",
+                 fe->stats.latency_total / fe->stats.latency_samples,
+                 fe->stats.latency_max, fe->stats.latency_samples);
+      else
+         fprintf(stderr, "no inputs\n");
+   }
+   fe->stats.window_start = now;
+   fe->stats.wakeups = 0;
+   fe->stats.presents = fe->stats.dropped = fe->stats.late = 0;
+   fe->stats.latency_total = fe->stats.latency_max = 0;
+   fe->stats.latency_samples = 0;
+}
+
+static void sdl_handle_event(frontend *fe, SDL_Event *event) {
+   int width, height;
+   switch( event->type ) {
+      case SDL_KEYDOWN:
+         if (!fe->stats.input_pending)
+            fe->stats.input_pending = SDL_GetPerformanceCounter();
+         nom_key_event(fe, event);
+         break;
+      case SDL_KEYUP:
+         nom_key_event(fe, event);
+         break;
+      case SDL_QUIT:
+         fe->quit = 1;
+         break;
+      case SDL_WINDOWEVENT:
+         switch( event->window.event ) {
+            case SDL_WINDOWEVENT_SIZE_CHANGED:
+               width = event->window.data1;
+               height = event->window.data2;
+               if (width != fe->sdl_surface->w || height != fe->sdl_surface->h) {
+                  sdl_setup_backbuffer(fe, width, height);
+                  midend_size(fe->me, &width, &height, 1, 1.0);
+                  midend_force_redraw(fe->me);
+               }
+               break;
+            case SDL_WINDOWEVENT_CLOSE:
+               fe->quit=1;
+               break;
+         }
+         break;
+      default:
+         if (fe->wake_event && event->type == fe->wake_event && event->user.code == WAKE_GENERATED) {
+            fe->generating--;
+            sdl_finish_generation(fe, (midend_generation *)event->user.data1);
+         } else if (fe->wake_event && event->type == fe->wake_event && event->user.code == WAKE_POOLED) {
+            fe->refilling = 0;
+            midend_pool_add(fe->me, (midend_generation *)event->user.data1);
+            sdl_save_pool(fe);
+         }
+         // Otherwise it's a plain wake-up, whose only job was to end the wait.
+         break;
+   }
+}
 
 void nom_key_event(frontend *fe, SDL_Event *event) {
    //Key repeat works in a compositor, but when you're just using the bare console, nope. 
@@ -429,18 +1656,14 @@ void nom_key_event(frontend *fe, SDL_Event *event) {
       case SDLK_ESCAPE:
          fe->quit=1; return;
       case SDLK_F10:
-         midend_new_game(fe->me);
-         midend_redraw(fe->me);
-         char *game_id = midend_get_game_id(fe->me);
-         printf("The GameID for game '%s' is: %s\n",thegame.name, game_id);  
-         fflush(stdout);
-         sfree(game_id);
+         sdl_start_generation(fe);
          return;
    }
 
    if (keydown && keyval) 
       if ( !event->key.repeat || (event->key.repeat && allow_repeat)  )  {
          fe->quit = !midend_process_key(fe->me, 0, 0, keyval);
+         save_game_to_disk(fe);
       }
    
 }
@@ -1,18 +1,117 @@
 #pragma once
 
+#define MAX_DAMAGE_RECTS 32
+enum { WAKE_ONLY, WAKE_GENERATED, WAKE_POOLED }; // event.user.code of fe->wake_event
+
+#define DEFAULT_POOL_SIZE 4 // ready-made games kept per preset, unless PUZZLES_POOL_SIZE says otherwise
+
+// Undo history kept in memory: a full game_state every HISTORY_SNAPSHOT_INTERVAL
+// moves, plus up to HISTORY_CACHED_STATES recently used ones in between.
+#define HISTORY_SNAPSHOT_INTERVAL 16
+#define HISTORY_CACHED_STATES 32
+
+// Autosave: appends reach the disk at most this long after the move that made them,
+// and the file is rewritten from scratch once the appends outgrow
+// AUTOSAVE_COMPACT_RATIO times what it was last rewritten at (plus some slack).
+#define AUTOSAVE_BATCH_MS 500
+#define AUTOSAVE_COMPACT_RATIO 4
+#define AUTOSAVE_COMPACT_SLACK 4096
+
+#define SDL_FONT_FACE "@cairo:monospace"
+#define GLYPH_CACHE_MAX 1024 // rendered text runs kept; past this the cache starts again from empty
+
+// Display list. A path picks up same-coloured rects or lines from at most
+// DRAW_BATCH_LOOKAHEAD ops further on, and gives up once DRAW_BATCH_BLOCKERS ops
+// in between have stood in its way.
+#define DRAW_BATCH_LOOKAHEAD 1024
+#define DRAW_BATCH_BLOCKERS 64
+// A display list this long is played back in horizontal bands on every core, each
+// band at least DRAW_BAND_MIN_HEIGHT rows. PUZZLES_DRAW_THREADS=1 turns it off.
+#define DRAW_BAND_MIN_OPS 1024
+#define DRAW_BAND_MIN_HEIGHT 32
+enum { DRAW_OP_RECT, DRAW_OP_LINE, DRAW_OP_THICK_LINE, DRAW_OP_POLYGON, DRAW_OP_CIRCLE,
+       DRAW_OP_TEXT, DRAW_OP_CLIP, DRAW_OP_UNCLIP, DRAW_OP_BLIT };
+
+#define OVERLAY_W 640
+#define OVERLAY_H 34
+
+#define DEFAULT_REFRESH_HZ 60 // used when the display won't tell us its refresh rate
+
+struct sdl_loop_stats {
+   Uint64 window_start;      // SDL_GetTicks64() when the current reporting second began
+   int wakeups;              // times the main loop woke up during that second
+   Uint64 input_pending;     // performance counter at the first unpresented input, or 0
+   double latency_total, latency_max; // input-to-present, in ms
+   int latency_samples;
+   int presents;             // frames actually shown during the current second
+   int dropped;              // frame steps the timer had to skip to catch up
+   int late;                 // presents that landed more than half a refresh after they were due
+   int report;               // print a line per second to stderr
+};
+
+// The autosave journal. Everything from lock down is shared with the writer thread.
+struct sdl_autosave {
+   char *path, *tmppath;     // NULL if there's nowhere to keep it
+   SDL_Thread *thread;
+   int fd;                   // the writer's append handle on path, or -1
+   long full_bytes;          // size of the file when last rewritten in full
+   long journal_bytes;       // bytes appended since then
+   SDL_mutex *lock;
+   SDL_cond *cond;
+   char *pending;            // bytes waiting for the writer
+   int pendlen, pendsize;
+   int rewrite;              // pending is a whole new file, not an append
+   int remove;               // the file should go (and pending is empty)
+   int need_full;            // the next save must be a rewrite, e.g. after a failed write
+   int stop;
+};
+
+// Where the display list is being played back to: the whole backbuffer, or a slice
+// of its rows when a big list is split between threads.
+struct sdl_band {
+   cairo_surface_t *image;   // rows u to d-1 of sdl_surface, in window coordinates
+   cairo_t *cr;
+   int u, d;
+   SDL_Rect clip;            // the clip in force so far
+};
+
 struct frontend {
 midend *me;
 SDL_Window *window;
 SDL_Renderer *renderer;
 SDL_Surface *sdl_surface;
+SDL_Texture *texture; // streaming copy of sdl_surface, lives as long as the backbuffer
 const float *colours;
 int ncolours;
 cairo_t *cr;
 cairo_surface_t *image;
-int bbox_l, bbox_r, bbox_u, bbox_d;
+int bbox_l, bbox_r, bbox_u, bbox_d; // union of everything in damage[], for the overflow case
+SDL_Rect damage[MAX_DAMAGE_RECTS]; // regions touched since the last upload
+int ndamage;
 int quit;
-Uint64 old_timer_ticks;
+Uint64 old_timer_ticks; // performance counter at the last frame step handed to midend_timer
+Uint64 frame_period;    // one display refresh, in performance counter units
+Uint64 last_present;    // performance counter at the last SDL_RenderPresent, or 0
 int timer_running;
+Uint32 wake_event; // user event type pushed to break SDL_WaitEvent, or 0 before SDL is up
+struct sdl_loop_stats stats;
+int generating;         // foreground generations whose result hasn't come back yet
+int refilling;          // true while a pool refill is running in the background
+int pool_size;          // ready-made games wanted per preset; 0 turns the pool off
+struct sdl_autosave autosave;
+struct sdl_draw_op *ops; // this frame's drawing, not yet played back into cr
+int nops, opsize;
+SDL_Rect clip;          // the clip in force where the display list has been played back to
+int draw_threads;       // most threads to play a big display list back on
+struct draw_stats frame, last_frame; // what this frame has cost so far, and the last one in full
+Uint64 draw_start;      // performance counter at the last start_draw
+int overlay;            // show last_frame in the corner (PUZZLES_SDL_OVERLAY)
+cairo_surface_t *overlay_image;
+SDL_Texture *overlay_texture;
+draw_trace *trace;      // everything timed so far, for PUZZLES_SDL_TRACE; or NULL
+const char *trace_path;
+Uint64 trace_origin;    // performance counter that the trace's timestamps count from
+tree234 *glyphs;        // sdl_glyph_runs, rendered at the current window size
 float fontscale;
 };
 typedef frontend frontend;
@@ -22,8 +121,33 @@ static void changed_preset(frontend *fe);
 static void load_prefs(frontend *fe);
 static char *save_prefs(frontend *fe);
 static void draw_fill(frontend *fe);
-static void draw_fill_preserve(frontend *fe);
+static void draw_fill_preserve(cairo_t *cr);
+static void sdl_setup_backbuffer(frontend *fe, int width, int height);
+static void sdl_free_backbuffer(frontend *fe);
+static void sdl_reset_damage(frontend *fe);
+static void sdl_reset_clip(frontend *fe);
+static void sdl_add_damage(frontend *fe, int x, int y, int w, int h);
+static void sdl_merge_damage(frontend *fe);
+static void sdl_blitter_copy(frontend *fe, blitter *bl, int x, int y, struct sdl_band *band);
+static void sdl_setup_cairo(cairo_t *cr);
 void nom_key_event(frontend *fe, SDL_Event *event);
+static void sdl_handle_event(frontend *fe, SDL_Event *event);
+static int sdl_next_timeout(frontend *fe);
+static void sdl_setup_frame_clock(frontend *fe);
+static void sdl_frame_step(frontend *fe);
+static void sdl_present(frontend *fe);
+static void sdl_trace_span(frontend *fe, const char *name, Uint64 start, double *ms);
+static void sdl_start_generation(frontend *fe);
+static void sdl_finish_generation(frontend *fe, midend_generation *gen);
+static void sdl_refill_pool(frontend *fe);
+static void sdl_load_pool(frontend *fe);
+static void sdl_save_pool(frontend *fe);
+static char *sdl_prefs_path(const char *suffix);
+static void sdl_glyph_cache_clear(frontend *fe);
+static void sdl_flush_draw_ops(frontend *fe);
+static void sdl_autosave_start(frontend *fe);
+static void sdl_autosave_stop(frontend *fe);
+static void sdl_loop_stats_tick(frontend *fe);
 
 
 void sdl_drawing_free(drawing *dr) ;
@@ -46,8 +170,9 @@ void sdl_blitter_load(drawing *dr, blitter *bl, int x, int y);
 void sdl_status_bar(drawing *dr, const char *text);
 void document_add_puzzle(document *doc, const game *game, game_params *par, game_ui *ui, game_state *st, game_state *st2);
 
+// A copy of part of sdl_surface, in the same pixel format, rows packed w*4 bytes apart.
 struct blitter {
-    cairo_surface_t *image;
+    unsigned char *pixels;
     int w, h;
 };
 
@@ -55,6 +180,47 @@ frontend* frontend_new();
 void save_game_to_disk(frontend*); 
 int load_game_from_disk(frontend*); // true if load succeeded, false otherwise.
 
+struct sdl_generation_job {
+    midend_generation *gen;
+    Uint32 wake_event;
+    int code; // WAKE_GENERATED or WAKE_POOLED
+};
+
+// A string as sdl_draw_text last rendered it, so drawing it again is one mask blit.
+struct sdl_glyph_run {
+   int fonttype, fontsize;
+   char *text;
+   cairo_text_extents_t extents;
+   cairo_surface_t *mask; // A8 coverage, or NULL if the text has no ink
+   int ox, oy;            // where the text origin falls within mask
+};
+
+struct sdl_draw_op {
+   int type;                 // DRAW_OP_*
+   int colour, outline;      // fill (or only) colour, outline colour; -1 for none
+   int l, u, r, d;           // every pixel it might touch, for deciding what can be reordered
+   int x1, y1, x2, y2;       // rect and clip: x, y, w, h. line: ends. circle: cx, cy, radius. text, blit: position
+   float fx1, fy1, fx2, fy2, thickness; // thick line
+   int *coords, npoints;     // polygon
+   struct sdl_glyph_run *run; // text
+   blitter *bl;              // blit
+   bool done;                // drawn as part of an earlier op's path
+   int next;                 // the op after this one in its path, or -1
+};
+
+struct sdl_band_job {
+   frontend *fe;
+   struct sdl_band *bands;
+   int nbands;
+   SDL_atomic_t next;        // the next band nobody has started on
+};
+
+struct sdl_runner_job {
+    void (*worker)(void *wctx);
+    void *wctx;
+    int running;              // pool threads still on it, under runner_lock
+};
+
 struct savefile_write_ctx {
     FILE *fp;
     int error;
@@ -146,18 +146,17 @@ enum {
 };
 
 /*
- * To determine all possible ways to reach a given sum by adding two or
- * three numbers from 1..9, each of which occurs exactly once in the sum,
- * these arrays contain a list of bitmasks for each sum value, where if
- * bit N is set, it means that N occurs in the sum.  Each list is
- * terminated by a zero if it is shorter than the size of the array.
+ * To determine all possible ways to reach a given sum by adding two,
+ * three or four numbers from 1..9, each of which occurs exactly once
+ * in the sum, find_sum_bits lists a bitmask for each way, where if bit
+ * N is set, it means that N occurs in the sum. There are few enough
+ * ways for any one sum that the solver works them out as it needs
+ * them, rather than sharing tables between threads that may be
+ * generating games at once.
  */
 #define MAX_2SUMS 5
 #define MAX_3SUMS 8
 #define MAX_4SUMS 12
-static unsigned long sum_bits2[18][MAX_2SUMS];
-static unsigned long sum_bits3[25][MAX_3SUMS];
-static unsigned long sum_bits4[31][MAX_4SUMS];
 
 static int find_sum_bits(unsigned long *array, int idx, int value_left,
 			 int addends_left, int min_addend,
@@ -185,30 +184,6 @@ static int find_sum_bits(unsigned long *array, int idx, int value_left,
     return idx;
 }
 
-static void precompute_sum_bits(void)
-{
-    int i;
-    for (i = 3; i < 31; i++) {
-	int j;
-	if (i < 18) {
-	    j = find_sum_bits(sum_bits2[i], 0, i, 2, 1, 0);
-	    assert (j <= MAX_2SUMS);
-	    if (j < MAX_2SUMS)
-		sum_bits2[i][j] = 0;
-	}
-	if (i < 25) {
-	    j = find_sum_bits(sum_bits3[i], 0, i, 3, 1, 0);
-	    assert (j <= MAX_3SUMS);
-	    if (j < MAX_3SUMS)
-		sum_bits3[i][j] = 0;
-	}
-	j = find_sum_bits(sum_bits4[i], 0, i, 4, 1, 0);
-	assert (j <= MAX_4SUMS);
-	if (j < MAX_4SUMS)
-	    sum_bits4[i][j] = 0;
-    }
-}
-
 struct game_params {
     /*
      * For a square puzzle, `c' and `r' indicate the puzzle
@@ -986,7 +961,9 @@ static int solver_intersect(struct solver_usage *usage,
 }
 
 struct solver_scratch {
-    unsigned char *grid, *rowidx, *colidx, *set;
+    unsigned char *grid, *rowidx, *colidx;
+    setelim_bits *rows;
+    setelim *se;
     int *neighbours, *bfsqueue;
     int *indexlist, *indexlist2;
 #ifdef STANDALONE_SOLVER
@@ -1004,10 +981,9 @@ static int solver_set(struct solver_usage *usage,
 {
     int cr = usage->cr;
     int i, j, n, count;
-    unsigned char *grid = scratch->grid;
     unsigned char *rowidx = scratch->rowidx;
     unsigned char *colidx = scratch->colidx;
-    unsigned char *set = scratch->set;
+    setelim_bits *rows = scratch->rows, set, ok;
 
     /*
      * We are passed a cr-by-cr matrix of booleans. Our first job
@@ -1060,141 +1036,106 @@ static int solver_set(struct solver_usage *usage,
     assert(n == j);
 
     /*
-     * And create the smaller matrix.
+     * And create the smaller matrix, a word per row.
      */
-    for (i = 0; i < n; i++)
+    for (i = 0; i < n; i++) {
+        rows[i] = 0;
         for (j = 0; j < n; j++)
-            grid[i*cr+j] = usage->cube[indices[rowidx[i]*cr+colidx[j]]];
+            if (usage->cube[indices[rowidx[i]*cr+colidx[j]]])
+                rows[i] |= (setelim_bits)1 << j;
+    }
 
     /*
      * Having done that, we now have a matrix in which every row
      * has at least two 1s in. Now we search to see if we can find
      * a rectangle of zeroes (in the set-theoretic sense of
      * `rectangle', i.e. a subset of rows crossed with a subset of
-     * columns) whose width and height add up to n.
+     * columns) whose width and height add up to n. setelim_next
+     * hands us each set of columns for which there are at least
+     * enough rows.
      */
+    setelim_start(scratch->se, n, rows);
+    while (setelim_next(scratch->se, &set, &ok)) {
+        bool progress = false;
+
+        count = setelim_popcount(set);
 
-    memset(set, 0, n);
-    count = 0;
-    while (1) {
         /*
-         * We have a candidate set. If its size is <=1 or >=n-1
-         * then we move on immediately.
+         * We expect never to be able to get _more_ than n-count
+         * suitable rows: this would imply that (for example) there
+         * are four numbers which between them have at most three
+         * possible positions, and hence it indicates a faulty
+         * deduction before this point or even a bogus clue.
          */
-        if (count > 1 && count < n-1) {
-            /*
-             * The number of rows we need is n-count. See if we can
-             * find that many rows which each have a zero in all
-             * the positions listed in `set'.
-             */
-            int rows = 0;
-            for (i = 0; i < n; i++) {
-                bool ok = true;
-                for (j = 0; j < n; j++)
-                    if (set[j] && grid[i*cr+j]) {
-                        ok = false;
-                        break;
-                    }
-                if (ok)
-                    rows++;
-            }
-
-            /*
-             * We expect never to be able to get _more_ than
-             * n-count suitable rows: this would imply that (for
-             * example) there are four numbers which between them
-             * have at most three possible positions, and hence it
-             * indicates a faulty deduction before this point or
-             * even a bogus clue.
-             */
-            if (rows > n - count) {
+        if (setelim_popcount(ok) > n - count) {
 #ifdef STANDALONE_SOLVER
-		if (solver_show_working) {
-		    va_list ap;
-		    printf("%*s", solver_recurse_depth*4,
-			   "");
-		    va_start(ap, fmt);
-		    vprintf(fmt, ap);
-		    va_end(ap);
-		    printf(":\n%*s  contradiction reached\n",
-			   solver_recurse_depth*4, "");
-		}
+            if (solver_show_working) {
+                va_list ap;
+                printf("%*s", solver_recurse_depth*4,
+                       "");
+                va_start(ap, fmt);
+                vprintf(fmt, ap);
+                va_end(ap);
+                printf(":\n%*s  contradiction reached\n",
+                       solver_recurse_depth*4, "");
+            }
 #endif
-		return -1;
-	    }
+            return -1;
+        }
 
-            if (rows >= n - count) {
-                bool progress = false;
-
-                /*
-                 * We've got one! Now, for each row which _doesn't_
-                 * satisfy the criterion, eliminate all its set
-                 * bits in the positions _not_ listed in `set'.
-                 * Return +1 (meaning progress has been made) if we
-                 * successfully eliminated anything at all.
-                 * 
-                 * This involves referring back through
-                 * rowidx/colidx in order to work out which actual
-                 * positions in the cube to meddle with.
-                 */
-                for (i = 0; i < n; i++) {
-                    bool ok = true;
-                    for (j = 0; j < n; j++)
-                        if (set[j] && grid[i*cr+j]) {
-                            ok = false;
-                            break;
-                        }
-                    if (!ok) {
-                        for (j = 0; j < n; j++)
-                            if (!set[j] && grid[i*cr+j]) {
-                                int fpos = indices[rowidx[i]*cr+colidx[j]];
-#ifdef STANDALONE_SOLVER
-                                if (solver_show_working) {
-                                    int px, py, pn;
-
-                                    if (!progress) {
-                                        va_list ap;
-					printf("%*s", solver_recurse_depth*4,
-					       "");
-                                        va_start(ap, fmt);
-                                        vprintf(fmt, ap);
-                                        va_end(ap);
-                                        printf(":\n");
-                                    }
+        /*
+         * We've got one! Now, for each row which _doesn't_ satisfy
+         * the criterion, eliminate all its set bits in the
+         * positions _not_ listed in `set'. Return +1 (meaning
+         * progress has been made) if we successfully eliminated
+         * anything at all.
+         *
+         * This involves referring back through rowidx/colidx in
+         * order to work out which actual positions in the cube to
+         * meddle with.
+         */
+        for (i = 0; i < n; i++) {
+            setelim_bits elim;
 
-                                    pn = 1 + fpos % cr;
-                                    px = fpos / cr;
-                                    py = px / cr;
-                                    px %= cr;
+            if (ok & ((setelim_bits)1 << i))
+                continue;
+            for (elim = rows[i] & ~set; elim; elim &= elim - 1) {
+                int fpos;
 
-                                    printf("%*s  ruling out %d at (%d,%d)\n",
-					   solver_recurse_depth*4, "",
-                                           pn, 1+px, 1+py);
-                                }
-#endif
-                                progress = true;
-                                usage->cube[fpos] = false;
-                            }
+                j = setelim_ctz(elim);
+                fpos = indices[rowidx[i]*cr+colidx[j]];
+#ifdef STANDALONE_SOLVER
+                if (solver_show_working) {
+                    int px, py, pn;
+
+                    if (!progress) {
+                        va_list ap;
+                        printf("%*s", solver_recurse_depth*4,
+                               "");
+                        va_start(ap, fmt);
+                        vprintf(fmt, ap);
+                        va_end(ap);
+                        printf(":\n");
                     }
-                }
 
-                if (progress) {
-                    return +1;
+                    pn = 1 + fpos % cr;
+                    px = fpos / cr;
+                    py = px / cr;
+                    px %= cr;
+
+                    printf("%*s  ruling out %d at (%d,%d)\n",
+                           solver_recurse_depth*4, "",
+                           pn, 1+px, 1+py);
                 }
+#endif
+                progress = true;
+                usage->cube[fpos] = false;
             }
         }
 
-        /*
-         * Binary increment: change the rightmost 0 to a 1, and
-         * change all 1s to the right of it to 0s.
-         */
-        i = n;
-        while (i > 0 && set[i-1])
-            set[--i] = 0, count--;
-        if (i > 0)
-            set[--i] = 1, count++;
-        else
-            break;                     /* done */
+        if (progress) {
+            return +1;
+        }
     }
 
     return 0;
@@ -1482,7 +1423,7 @@ static int solver_killer_sums(struct solver_usage *usage, int b,
     int cr = usage->cr;
     int i, ret, max_sums;
     int nsquares = cages->nr_squares[b];
-    unsigned long *sumbits, possible_addends;
+    unsigned long sumbits[MAX_4SUMS], possible_addends;
 
     if (clue == 0) {
 	assert(nsquares == 0);
@@ -1504,7 +1445,7 @@ static int solver_killer_sums(struct solver_usage *usage, int b,
 	int known_row = -1, known_col = -1, known_block = -1;
 	/*
 	 * Verify that the cage lies entirely within one region,
-	 * so that using the precomputed sums is valid.
+	 * so that using sums of distinct addends is valid.
 	 */
 	for (i = 0; i < nsquares; i++) {
 	    int x = cages->blocks[b][i];
@@ -1531,21 +1472,22 @@ static int solver_killer_sums(struct solver_usage *usage, int b,
 	if (clue < 3 || clue > 17)
 	    return -1;
 
-	sumbits = sum_bits2[clue];
 	max_sums = MAX_2SUMS;
     } else if (nsquares == 3) {
 	if (clue < 6 || clue > 24)
 	    return -1;
 
-	sumbits = sum_bits3[clue];
 	max_sums = MAX_3SUMS;
     } else {
 	if (clue < 10 || clue > 30)
 	    return -1;
 
-	sumbits = sum_bits4[clue];
 	max_sums = MAX_4SUMS;
     }
+    i = find_sum_bits(sumbits, 0, clue, nsquares, 1, 0);
+    assert(i <= max_sums);
+    if (i < max_sums)
+	sumbits[i] = 0;
     /*
      * For every possible way to get the sum, see if there is
      * one square in the cage that disallows all the required
@@ -1671,7 +1613,8 @@ static struct solver_scratch *solver_new_scratch(struct solver_usage *usage)
     scratch->grid = snewn(cr*cr, unsigned char);
     scratch->rowidx = snewn(cr, unsigned char);
     scratch->colidx = snewn(cr, unsigned char);
-    scratch->set = snewn(cr, unsigned char);
+    scratch->rows = snewn(cr, setelim_bits);
+    scratch->se = setelim_new(cr);
     scratch->neighbours = snewn(5*cr, int);
     scratch->bfsqueue = snewn(cr*cr, int);
 #ifdef STANDALONE_SOLVER
@@ -1689,7 +1632,8 @@ static void solver_free_scratch(struct solver_scratch *scratch)
 #endif
     sfree(scratch->bfsqueue);
     sfree(scratch->neighbours);
-    sfree(scratch->set);
+    setelim_free(scratch->se);
+    sfree(scratch->rows);
     sfree(scratch->colidx);
     sfree(scratch->rowidx);
     sfree(scratch->grid);
@@ -3644,33 +3588,155 @@ static key_label *game_request_keys(const game_params *params, int *nkeys)
     return keys;
 }
 
-static char *new_game_desc(const game_params *params, random_state *rs,
-			   char **aux, bool interactive)
+/*
+ * Clue removal asks the solver about the current clues less one
+ * symmetric group at a time. The solver always starts with blockwise
+ * positional elimination and goes back to it after anything else, and
+ * where it goes from there depends only on which squares are filled;
+ * so if positional elimination alone would put every removed clue
+ * back, it ends up exactly where it got to from the current clues and
+ * gives the same verdict, and we needn't ask it again.
+ *
+ * This does that positional elimination, and nothing else, on a copy
+ * of grid2 (the current clues with those at coords blanked), with
+ * flags for the digits each row, column, block and diagonal already
+ * has. It looks only at the clues themselves, not killer cages.
+ */
+struct clue_check {
+    int cr;
+    digit *grid;
+    bool *row, *col, *blk, *diag;
+};
+
+static struct clue_check *clue_check_new(int cr)
+{
+    struct clue_check *cc = snew(struct clue_check);
+    cc->cr = cr;
+    cc->grid = snewn(cr*cr, digit);
+    cc->row = snewn(3*cr*cr + 2*cr, bool);
+    cc->col = cc->row + cr*cr;
+    cc->blk = cc->col + cr*cr;
+    cc->diag = cc->blk + cr*cr;
+    return cc;
+}
+
+static void clue_check_free(struct clue_check *cc)
 {
+    sfree(cc->grid);
+    sfree(cc->row);
+    sfree(cc);
+}
+
+static void clue_check_place(struct clue_check *cc,
+                             struct block_structure *blocks, bool xtype,
+                             int xy, int n)
+{
+    int cr = cc->cr, x = xy % cr, y = xy / cr;
+
+    cc->grid[xy] = n;
+    cc->row[y*cr+n-1] = cc->col[x*cr+n-1] = true;
+    cc->blk[blocks->whichblock[xy]*cr+n-1] = true;
+    if (xtype) {
+        if (ondiag0(xy))
+            cc->diag[n-1] = true;
+        if (ondiag1(xy))
+            cc->diag[cr+n-1] = true;
+    }
+}
+
+static bool removed_clues_forced(struct clue_check *cc,
+                                 struct block_structure *blocks,
+                                 bool xtype, const digit *grid2,
+                                 const int *coords, int ncoords)
+{
+    int cr = cc->cr, area = cr*cr;
+    int xy, b, n, i, j;
+
+    memset(cc->row, 0, (3*area + 2*cr) * sizeof(bool));
+    memset(cc->grid, 0, area);
+    for (xy = 0; xy < area; xy++)
+        if (grid2[xy])
+            clue_check_place(cc, blocks, xtype, xy, grid2[xy]);
+
+    while (1) {
+        bool progress = false;
+
+        for (j = 0; j < ncoords; j++)
+            if (!cc->grid[coords[2*j+1]*cr+coords[2*j]])
+                break;
+        if (j == ncoords)
+            return true;               /* all put back */
+
+        for (b = 0; b < cr; b++)
+            for (n = 1; n <= cr; n++) {
+                int pos = -1;
+
+                if (cc->blk[b*cr+n-1])
+                    continue;
+                for (i = 0; i < cr; i++) {
+                    int q = blocks->blocks[b][i], x = q % cr, y = q / cr;
+
+                    if (cc->grid[q] || cc->row[y*cr+n-1] ||
+                        cc->col[x*cr+n-1] ||
+                        (xtype && ((ondiag0(q) && cc->diag[n-1]) ||
+                                   (ondiag1(q) && cc->diag[cr+n-1]))))
+                        continue;
+                    if (pos >= 0)
+                        break;         /* more than one place */
+                    pos = q;
+                }
+                if (i == cr && pos >= 0) {
+                    clue_check_place(cc, blocks, xtype, pos, n);
+                    progress = true;
+                }
+            }
+
+        if (!progress)
+            return false;
+    }
+}
+
+struct solo_attempt_ctx {
+    const game_params *params;
+    struct difficulty dlev;            /* only maxdiff and maxkdiff */
+};
+
+struct solo_attempt_result {
+    char *desc, *aux;
+};
+
+static void free_solo_attempt_result(void *vres)
+{
+    struct solo_attempt_result *res = (struct solo_attempt_result *)vres;
+    sfree(res->desc);
+    sfree(res->aux);
+    sfree(res);
+}
+
+/*
+ * One go at generating a grid of the required difficulty, returning
+ * NULL if it didn't come out right. This is nasty, but it seems to be
+ * unpleasantly hard to generate difficult grids otherwise. Attempts
+ * are independent of each other, so new_game_desc hands them to
+ * race_attempts, which may run several at once.
+ */
+static void *solo_attempt(void *vctx, random_state *rs)
+{
+    const struct solo_attempt_ctx *ctx = (const struct solo_attempt_ctx *)vctx;
+    const game_params *params = ctx->params;
     int c = params->c, r = params->r, cr = c*r;
     int area = cr*cr;
     struct block_structure *blocks, *kblocks;
     digit *grid, *grid2, *kgrid;
     struct xy { int x, y; } *locs;
     int nlocs;
-    char *desc;
+    char *aux = NULL;
     int coords[16], ncoords;
     int x, y, i, j;
-    struct difficulty dlev;
-
-    precompute_sum_bits();
-
-    /*
-     * Adjust the maximum difficulty level to be consistent with
-     * the puzzle size: all 2x2 puzzles appear to be Trivial
-     * (DIFF_BLOCK) so we cannot hold out for even a Basic
-     * (DIFF_SIMPLE) one.
-     * Jigsaw puzzles of size 2 and 3 are also all trivial.
-     */
-    dlev.maxdiff = params->diff;
-    dlev.maxkdiff = params->kdiff;
-    if ((c == 2 && r == 2) || (r == 1 && c < 4))
-        dlev.maxdiff = DIFF_BLOCK;
+    struct difficulty dlev = ctx->dlev, curlev;
+    struct clue_check *cc = NULL;
+    bool found = false;
+    struct solo_attempt_result *res = NULL;
 
     grid = snewn(area, digit);
     locs = snewn(area, struct xy);
@@ -3681,207 +3747,237 @@ static char *new_game_desc(const game_params *params, random_state *rs,
     kblocks = NULL;
     kgrid = (params->killer) ? snewn(area, digit) : NULL;
 
-#ifdef STANDALONE_SOLVER
-    assert(!"This should never happen, so we don't need to create blocknames");
-#endif
-
     /*
-     * Loop until we get a grid of the required difficulty. This is
-     * nasty, but it seems to be unpleasantly hard to generate
-     * difficult grids otherwise.
+     * Generate a random solved state, starting by
+     * constructing the block structure.
      */
-    while (1) {
-        /*
-         * Generate a random solved state, starting by
-         * constructing the block structure.
-         */
-	if (r == 1) {		       /* jigsaw mode */
-	    DSF *dsf = divvy_rectangle(cr, cr, cr, rs);
+    if (r == 1) {		       /* jigsaw mode */
+        DSF *dsf = divvy_rectangle(cr, cr, cr, rs);
 
-	    dsf_to_blocks (dsf, blocks, cr, cr);
-
-	    dsf_free(dsf);
-	} else {		       /* basic Sudoku mode */
-	    for (y = 0; y < cr; y++)
-		for (x = 0; x < cr; x++)
-		    blocks->whichblock[y*cr+x] = (y/c) * c + (x/r);
-	}
-	make_blocks_from_whichblock(blocks);
+        dsf_to_blocks (dsf, blocks, cr, cr);
 
-	if (params->killer) {
-            if (kblocks) free_block_structure(kblocks);
-	    kblocks = gen_killer_cages(cr, rs, params->kdiff > DIFF_KSINGLE);
-	}
+        dsf_free(dsf);
+    } else {		       /* basic Sudoku mode */
+        for (y = 0; y < cr; y++)
+	    for (x = 0; x < cr; x++)
+		blocks->whichblock[y*cr+x] = (y/c) * c + (x/r);
+    }
+    make_blocks_from_whichblock(blocks);
 
-        if (!gridgen(cr, blocks, kblocks, params->xtype, grid, rs, area*area))
-	    continue;
-        assert(check_valid(cr, blocks, kblocks, NULL, params->xtype, grid));
+    if (params->killer) {
+        kblocks = gen_killer_cages(cr, rs, params->kdiff > DIFF_KSINGLE);
+    }
 
-	/*
-	 * Save the solved grid in aux.
-	 */
-	{
-	    /*
-	     * We might already have written *aux the last time we
-	     * went round this loop, in which case we should free
-	     * the old aux before overwriting it with the new one.
-	     */
-            if (*aux) {
-		sfree(*aux);
-            }
+    if (!gridgen(cr, blocks, kblocks, params->xtype, grid, rs, area*area))
+        goto out;
+    assert(check_valid(cr, blocks, kblocks, NULL, params->xtype, grid));
 
-            *aux = encode_solve_move(cr, grid);
-	}
+    /*
+     * Save the solved grid in aux.
+     */
+    aux = encode_solve_move(cr, grid);
 
-	/*
-	 * Now we have a solved grid. For normal puzzles, we start removing
-	 * things from it while preserving solubility.  Killer puzzles are
-	 * different: we just pass the empty grid to the solver, and use
-	 * the puzzle if it comes back solved.
-	 */
+    /*
+     * Now we have a solved grid. For normal puzzles, we start removing
+     * things from it while preserving solubility.  Killer puzzles are
+     * different: we just pass the empty grid to the solver, and use
+     * the puzzle if it comes back solved.
+     */
 
-	if (params->killer) {
-	    struct block_structure *good_cages = NULL;
-	    struct block_structure *last_cages = NULL;
-	    int ntries = 0;
+    if (params->killer) {
+        struct block_structure *good_cages = NULL;
+        struct block_structure *last_cages = NULL;
+        int ntries = 0;
 
-            memcpy(grid2, grid, area);
+        memcpy(grid2, grid, area);
 
-	    for (;;) {
-		compute_kclues(kblocks, kgrid, grid2, area);
+        for (;;) {
+	    compute_kclues(kblocks, kgrid, grid2, area);
 
-		memset(grid, 0, area * sizeof *grid);
-		solver(cr, blocks, kblocks, params->xtype, grid, kgrid, &dlev);
-		if (dlev.diff == dlev.maxdiff && dlev.kdiff == dlev.maxkdiff) {
-		    /*
-		     * We have one that matches our difficulty.  Store it for
-		     * later, but keep going.
-		     */
-		    if (good_cages)
-			free_block_structure(good_cages);
-		    ntries = 0;
-		    good_cages = dup_block_structure(kblocks);
+	    memset(grid, 0, area * sizeof *grid);
+	    solver(cr, blocks, kblocks, params->xtype, grid, kgrid, &dlev);
+	    if (dlev.diff == dlev.maxdiff && dlev.kdiff == dlev.maxkdiff) {
+		/*
+		 * We have one that matches our difficulty.  Store it for
+		 * later, but keep going.
+		 */
+		if (good_cages)
+		    free_block_structure(good_cages);
+		ntries = 0;
+		good_cages = dup_block_structure(kblocks);
+		if (!merge_some_cages(kblocks, cr, area, grid2, rs))
+		    break;
+	    } else if (dlev.diff > dlev.maxdiff || dlev.kdiff > dlev.maxkdiff) {
+		/*
+		 * Give up after too many tries and either use the good one we
+		 * found, or generate a new grid.
+		 */
+		if (++ntries > 50)
+		    break;
+		/*
+		 * The difficulty level got too high.  If we have a good
+		 * one, use it, otherwise go back to the last one that
+		 * was at a lower difficulty and restart the process from
+		 * there.
+		 */
+		if (good_cages != NULL) {
+		    free_block_structure(kblocks);
+		    kblocks = dup_block_structure(good_cages);
 		    if (!merge_some_cages(kblocks, cr, area, grid2, rs))
 			break;
-		} else if (dlev.diff > dlev.maxdiff || dlev.kdiff > dlev.maxkdiff) {
-		    /*
-		     * Give up after too many tries and either use the good one we
-		     * found, or generate a new grid.
-		     */
-		    if (++ntries > 50)
-			break;
-		    /*
-		     * The difficulty level got too high.  If we have a good
-		     * one, use it, otherwise go back to the last one that
-		     * was at a lower difficulty and restart the process from
-		     * there.
-		     */
-		    if (good_cages != NULL) {
-			free_block_structure(kblocks);
-			kblocks = dup_block_structure(good_cages);
-			if (!merge_some_cages(kblocks, cr, area, grid2, rs))
-			    break;
-		    } else {
-			if (last_cages == NULL)
-			    break;
-			free_block_structure(kblocks);
-			kblocks = last_cages;
-			last_cages = NULL;
-		    }
 		} else {
-		    if (last_cages)
-			free_block_structure(last_cages);
-		    last_cages = dup_block_structure(kblocks);
-		    if (!merge_some_cages(kblocks, cr, area, grid2, rs))
+		    if (last_cages == NULL)
 			break;
+		    free_block_structure(kblocks);
+		    kblocks = last_cages;
+		    last_cages = NULL;
 		}
+	    } else {
+		if (last_cages)
+		    free_block_structure(last_cages);
+		last_cages = dup_block_structure(kblocks);
+		if (!merge_some_cages(kblocks, cr, area, grid2, rs))
+		    break;
 	    }
-	    if (last_cages)
-		free_block_structure(last_cages);
-	    if (good_cages != NULL) {
-		free_block_structure(kblocks);
-		kblocks = good_cages;
-		compute_kclues(kblocks, kgrid, grid2, area);
-		memset(grid, 0, area * sizeof *grid);
-		break;
-	    }
-	    continue;
-	}
+        }
+        if (last_cages)
+	    free_block_structure(last_cages);
+        if (good_cages != NULL) {
+	    free_block_structure(kblocks);
+	    kblocks = good_cages;
+	    compute_kclues(kblocks, kgrid, grid2, area);
+	    memset(grid, 0, area * sizeof *grid);
+	    found = true;
+        }
+        goto out;
+    }
 
-        /*
-         * Find the set of equivalence classes of squares permitted
-         * by the selected symmetry. We do this by enumerating all
-         * the grid squares which have no symmetric companion
-         * sorting lower than themselves.
-         */
-        nlocs = 0;
-        for (y = 0; y < cr; y++)
-            for (x = 0; x < cr; x++) {
-                int i = y*cr+x;
-                int j;
-
-                ncoords = symmetries(params, x, y, coords, params->symm);
-                for (j = 0; j < ncoords; j++)
-                    if (coords[2*j+1]*cr+coords[2*j] < i)
-                        break;
-                if (j == ncoords) {
-                    locs[nlocs].x = x;
-                    locs[nlocs].y = y;
-                    nlocs++;
-                }
+    /*
+     * Find the set of equivalence classes of squares permitted
+     * by the selected symmetry. We do this by enumerating all
+     * the grid squares which have no symmetric companion
+     * sorting lower than themselves.
+     */
+    nlocs = 0;
+    for (y = 0; y < cr; y++)
+        for (x = 0; x < cr; x++) {
+            int i = y*cr+x;
+            int j;
+
+            ncoords = symmetries(params, x, y, coords, params->symm);
+            for (j = 0; j < ncoords; j++)
+                if (coords[2*j+1]*cr+coords[2*j] < i)
+                    break;
+            if (j == ncoords) {
+                locs[nlocs].x = x;
+                locs[nlocs].y = y;
+                nlocs++;
             }
+        }
 
-        /*
-         * Now shuffle that list.
-         */
-        shuffle(locs, nlocs, sizeof(*locs), rs);
+    /*
+     * Now shuffle that list.
+     */
+    shuffle(locs, nlocs, sizeof(*locs), rs);
 
-        /*
-         * Now loop over the shuffled list and, for each element,
-         * see whether removing that element (and its reflections)
-         * from the grid will still leave the grid soluble.
-         */
-        for (i = 0; i < nlocs; i++) {
-            x = locs[i].x;
-            y = locs[i].y;
+    /*
+     * Now loop over the shuffled list and, for each element,
+     * see whether removing that element (and its reflections)
+     * from the grid will still leave the grid soluble.
+     *
+     * curlev is always the solver's verdict on the current grid,
+     * so that removals which removed_clues_forced() shows can't
+     * change it don't need the solver at all, and neither does the
+     * final check.
+     */
+    memcpy(grid2, grid, area);
+    solver(cr, blocks, kblocks, params->xtype, grid2, kgrid, &dlev);
+    curlev = dlev;
+    cc = clue_check_new(cr);
 
-            memcpy(grid2, grid, area);
-            ncoords = symmetries(params, x, y, coords, params->symm);
-            for (j = 0; j < ncoords; j++)
-                grid2[coords[2*j+1]*cr+coords[2*j]] = 0;
+    for (i = 0; i < nlocs; i++) {
+        x = locs[i].x;
+        y = locs[i].y;
+
+        memcpy(grid2, grid, area);
+        ncoords = symmetries(params, x, y, coords, params->symm);
+        for (j = 0; j < ncoords; j++)
+            grid2[coords[2*j+1]*cr+coords[2*j]] = 0;
 
+        if (removed_clues_forced(cc, blocks, params->xtype, grid2,
+                                 coords, ncoords))
+            dlev = curlev;
+        else
             solver(cr, blocks, kblocks, params->xtype, grid2, kgrid, &dlev);
-            if (dlev.diff <= dlev.maxdiff &&
-		(!params->killer || dlev.kdiff <= dlev.maxkdiff)) {
-                for (j = 0; j < ncoords; j++)
-                    grid[coords[2*j+1]*cr+coords[2*j]] = 0;
-            }
+        if (dlev.diff <= dlev.maxdiff &&
+	    (!params->killer || dlev.kdiff <= dlev.maxkdiff)) {
+            for (j = 0; j < ncoords; j++)
+                grid[coords[2*j+1]*cr+coords[2*j]] = 0;
+            curlev = dlev;
         }
+    }
 
-        memcpy(grid2, grid, area);
+    dlev = curlev;
+    if (dlev.diff == dlev.maxdiff &&
+        (!params->killer || dlev.kdiff == dlev.maxkdiff))
+        found = true;	       /* found one! */
 
-	solver(cr, blocks, kblocks, params->xtype, grid2, kgrid, &dlev);
-	if (dlev.diff == dlev.maxdiff &&
-	    (!params->killer || dlev.kdiff == dlev.maxkdiff))
-	    break;		       /* found one! */
+  out:
+    if (found) {
+        /*
+         * Now we have the grid as it will be presented to the user.
+         * Encode it in a game desc.
+         */
+        res = snew(struct solo_attempt_result);
+        res->desc = encode_puzzle_desc(params, grid, blocks, kgrid, kblocks);
+        res->aux = aux;
+    } else {
+        sfree(aux);
     }
 
+    if (cc)
+        clue_check_free(cc);
     sfree(grid2);
     sfree(locs);
+    sfree(grid);
+    free_block_structure(blocks);
+    if (kblocks)
+        free_block_structure(kblocks);
+    sfree(kgrid);
+
+    return res;
+}
+
+static char *new_game_desc(const game_params *params, random_state *rs,
+			   char **aux, bool interactive)
+{
+    int c = params->c, r = params->r;
+    struct solo_attempt_ctx ctx;
+    struct solo_attempt_result *res;
+    char *desc;
 
     /*
-     * Now we have the grid as it will be presented to the user.
-     * Encode it in a game desc.
+     * Adjust the maximum difficulty level to be consistent with
+     * the puzzle size: all 2x2 puzzles appear to be Trivial
+     * (DIFF_BLOCK) so we cannot hold out for even a Basic
+     * (DIFF_SIMPLE) one.
+     * Jigsaw puzzles of size 2 and 3 are also all trivial.
      */
-    desc = encode_puzzle_desc(params, grid, blocks, kgrid, kblocks);
+    ctx.params = params;
+    ctx.dlev.maxdiff = params->diff;
+    ctx.dlev.maxkdiff = params->kdiff;
+    if ((c == 2 && r == 2) || (r == 1 && c < 4))
+        ctx.dlev.maxdiff = DIFF_BLOCK;
 
-    sfree(grid);
-    free_block_structure(blocks);
-    if (params->killer) {
-        free_block_structure(kblocks);
-        sfree(kgrid);
-    }
+#ifdef STANDALONE_SOLVER
+    assert(!"This should never happen, so we don't need to create blocknames");
+#endif
 
+    res = race_attempts(rs, solo_attempt, free_solo_attempt_result,
+                        &ctx, 0);
+    desc = res->desc;
+    *aux = res->aux;
+    sfree(res);
     return desc;
 }
 
@@ -4143,8 +4239,6 @@ static game_state *new_game(midend *me, const game_params *params,
     int c = params->c, r = params->r, cr = c*r, area = cr * cr;
     int i;
 
-    precompute_sum_bits();
-
     state->cr = cr;
     state->xtype = params->xtype;
     state->killer = params->killer;
@@ -4289,6 +4383,102 @@ static void free_game(game_state *state)
     sfree(state);
 }
 
+/*
+ * A checkpoint of the state in a save file is one character giving
+ * the completed and cheated flags, then for each cell a comma, its
+ * digit (0 if empty), and if it has any pencil marks, a slash and
+ * one hex digit for each four of them, lowest first.
+ */
+static char *encode_state(const game_state *state)
+{
+    int cr = state->cr, area = cr*cr, nhex = (cr+3)/4;
+    char *ret = snewn(2 + area * (5 + nhex), char), *p = ret;
+    int i, j, k;
+
+    *p++ = '0' + (state->completed ? 1 : 0) + (state->cheated ? 2 : 0);
+    for (i = 0; i < area; i++) {
+        const bool *pencil = state->pencil + i*cr;
+
+        p += sprintf(p, ",%d", state->grid[i]);
+        for (j = 0; j < cr; j++)
+            if (pencil[j])
+                break;
+        if (j < cr) {
+            *p++ = '/';
+            for (j = 0; j < nhex; j++) {
+                int h = 0;
+                for (k = 0; k < 4 && j*4+k < cr; k++)
+                    if (pencil[j*4+k])
+                        h |= 1 << k;
+                *p++ = "0123456789abcdef"[h];
+            }
+        }
+    }
+    *p++ = '\0';
+
+    return sresize(ret, p - ret, char);
+}
+
+static game_state *decode_state(const game_state *initial,
+                                const char *encoding)
+{
+    int cr = initial->cr, area = cr*cr, nhex = (cr+3)/4;
+    const char *p = encoding;
+    game_state *ret;
+    int i, j, k;
+
+    if (*p < '0' || *p > '3')
+        return NULL;
+    ret = dup_game(initial);
+    ret->completed = (*p - '0') & 1;
+    ret->cheated = (*p - '0') & 2;
+    p++;
+
+    for (i = 0; i < area; i++) {
+        bool *pencil = ret->pencil + i*cr;
+        int n;
+
+        if (*p++ != ',' || !isdigit((unsigned char)*p))
+            goto fail;
+        n = atoi(p);
+        while (isdigit((unsigned char)*p))
+            p++;
+        if (n > cr || (initial->immutable[i] && n != initial->grid[i]))
+            goto fail;
+        ret->grid[i] = n;
+
+        memset(pencil, 0, cr * sizeof(bool));
+        if (*p == '/') {
+            p++;
+            for (j = 0; j < nhex; j++) {
+                int h;
+                if (*p >= '0' && *p <= '9')
+                    h = *p - '0';
+                else if (*p >= 'a' && *p <= 'f')
+                    h = *p - 'a' + 10;
+                else
+                    goto fail;
+                p++;
+                for (k = 0; k < 4; k++) {
+                    if (!(h & (1 << k)))
+                        continue;
+                    if (j*4+k >= cr)
+                        goto fail;
+                    pencil[j*4+k] = true;
+                }
+            }
+        }
+    }
+    if (*p)
+        goto fail;
+
+    return ret;
+
+  fail:
+    free_game(ret);
+    return NULL;
+}
+
 static char *solve_game(const game_state *state, const game_state *currstate,
                         const char *ai, const char **error)
 {
@@ -5677,6 +5867,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    encode_state, decode_state,
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     get_prefs, set_prefs,
@@ -266,6 +266,31 @@ struct solver_ctx {
     int *dscratch;
 };
 
+/*
+ * Contexts for the branches of a recursive search that are searched
+ * at once (see latin.c): the clues are shared, but each needs scratch
+ * space of its own. One after another, they can all share the same
+ * one.
+ */
+static void *clone_ctx(void *vctx)
+{
+    struct solver_ctx *ctx = (struct solver_ctx *)vctx;
+    int w = ctx->w;
+    struct solver_ctx *ret;
+
+    ret = smalloc(sizeof(struct solver_ctx) + w * sizeof(long) +
+                  (w+1) * sizeof(int));
+    *ret = *ctx;
+    ret->iscratch = (long *)(ret + 1);
+    ret->dscratch = (int *)(ret->iscratch + w);
+    return ret;
+}
+
+static void free_ctx(void *vctx)
+{
+    sfree(vctx);
+}
+
 static int solver_easy(struct latin_solver *solver, void *vctx)
 {
     struct solver_ctx *ctx = (struct solver_ctx *)vctx;
@@ -295,7 +320,7 @@ static int solver_easy(struct latin_solver *solver, void *vctx)
 		CSTARTSTEP(cstart, cstep, c, w);
 		pos = start + (ctx->clues[c]-1)*step;
 		cpos = cstart + (ctx->clues[c]-1)*cstep;
-		if (solver->cube[cpos*w+w-1]) {
+		if (cubeat(cpos*w+w-1)) {
 #ifdef STANDALONE_SOLVER
 		    if (solver_show_working) {
 			printf("%*sfacing clues on %s %d are maximal:\n",
@@ -376,7 +401,7 @@ static int solver_easy(struct latin_solver *solver, void *vctx)
 		if (ctx->dscratch[i-1] < w && ctx->dscratch[i-1] >= furthest)
 		    continue;	       /* skip this number, it's elsewhere */
 		j--;
-		if (solver->cube[cstart*w+i-1]) {
+		if (cubeat(cstart*w+i-1)) {
 #ifdef STANDALONE_SOLVER
 		    if (solver_show_working) {
 			printf("%s%*s  ruling out %d at (%d,%d)\n",
@@ -385,7 +410,7 @@ static int solver_easy(struct latin_solver *solver, void *vctx)
 			prefix[0] = '\0';
 		    }
 #endif
-		    solver->cube[cstart*w+i-1] = 0;
+		    cubeat_clear(cstart*w+i-1);
 		    ret = 1;
 		}
 	    }
@@ -425,7 +450,7 @@ static int solver_easy(struct latin_solver *solver, void *vctx)
 	    }
 
 	    for (j = 0; j < clue - i - 1; j++)
-		if (solver->cube[(cstart + j*cstep)*w+n-1]) {
+		if (cubeat((cstart + j*cstep)*w+n-1)) {
 #ifdef STANDALONE_SOLVER
 		    if (solver_show_working) {
 			int pos = start+j*step;
@@ -435,7 +460,7 @@ static int solver_easy(struct latin_solver *solver, void *vctx)
 			prefix[0] = '\0';
 		    }
 #endif
-		    solver->cube[(cstart + j*cstep)*w+n-1] = 0;
+		    cubeat_clear((cstart + j*cstep)*w+n-1);
 		    ret = 1;
 		}
 	    i++;
@@ -491,7 +516,7 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
 		for (j = ctx->dscratch[i] + 1; j <= limit; j++) {
 		    if (bitmap & (1L << j))
 			continue;      /* used this one already */
-		    if (!solver->cube[pos*w+j-1])
+		    if (!cubeat(pos*w+j-1))
 			continue;      /* ruled out already */
 
 		    /* Found one. */
@@ -552,7 +577,7 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
 	for (i = 0; i < w; i++) {
 	    int pos = start + step * i;
 	    for (j = 1; j <= w; j++) {
-		if (solver->cube[pos*w+j-1] &&
+		if (cubeat(pos*w+j-1) &&
 		    !(ctx->iscratch[i] & (1L << j))) {
 #ifdef STANDALONE_SOLVER
 		    if (solver_show_working) {
@@ -562,7 +587,7 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
 			prefix[0] = '\0';
 		    }
 #endif
-		    solver->cube[pos*w+j-1] = 0;
+		    cubeat_clear(pos*w+j-1);
 		    ret = 1;
 		}
 	    }
@@ -616,7 +641,8 @@ static bool towers_valid(struct latin_solver *solver, void *vctx)
     return true;
 }
 
-static int solver(int w, int *clues, digit *soln, int maxdiff)
+static int solver(int w, int *clues, digit *soln, int maxdiff,
+                  latin_arena *arena)
 {
     int ret;
     struct solver_ctx ctx;
@@ -628,10 +654,11 @@ static int solver(int w, int *clues, digit *soln, int maxdiff)
     ctx.iscratch = snewn(w, long);
     ctx.dscratch = snewn(w+1, int);
 
-    ret = latin_solver(soln, w, maxdiff,
+    ret = latin_solver(soln, w, arena, maxdiff,
 		       DIFF_EASY, DIFF_HARD, DIFF_EXTREME,
 		       DIFF_EXTREME, DIFF_UNREASONABLE,
-		       towers_solvers, towers_valid, &ctx, NULL, NULL);
+		       towers_solvers, towers_valid, &ctx, NULL, NULL,
+		       clone_ctx, free_ctx);
 
     sfree(ctx.iscratch);
     sfree(ctx.dscratch);
@@ -643,136 +670,130 @@ static int solver(int w, int *clues, digit *soln, int maxdiff)
  * Grid generation.
  */
 
-static char *new_game_desc(const game_params *params, random_state *rs,
-			   char **aux, bool interactive)
+struct towers_attempt_ctx {
+    const game_params *params;
+    int diff;
+};
+
+struct towers_attempt_result {
+    char *desc, *aux;
+};
+
+static void free_towers_attempt_result(void *vres)
+{
+    struct towers_attempt_result *res = (struct towers_attempt_result *)vres;
+    sfree(res->desc);
+    sfree(res->aux);
+    sfree(res);
+}
+
+/*
+ * One go at generating a puzzle of exactly the required difficulty,
+ * returning NULL if it didn't come out right. new_game_desc hands
+ * these to race_attempts, which may run several at once.
+ */
+static void *towers_attempt(void *vctx, random_state *rs)
 {
+    const struct towers_attempt_ctx *ctx =
+        (const struct towers_attempt_ctx *)vctx;
+    const game_params *params = ctx->params;
     int w = params->w, a = w*w;
     digit *grid, *soln, *soln2;
     int *clues, *order;
     int i, ret;
-    int diff = params->diff;
+    int diff = ctx->diff;
     char *desc, *p;
+    latin_arena *arena;
+    struct towers_attempt_result *res = NULL;
 
-    /*
-     * Difficulty exceptions: some combinations of size and
-     * difficulty cannot be satisfied, because all puzzles of at
-     * most that difficulty are actually even easier.
-     *
-     * Remember to re-test this whenever a change is made to the
-     * solver logic!
-     *
-     * I tested it using the following shell command:
-
-for d in e h x u; do
-  for i in {3..9}; do
-    echo -n "./towers --generate 1 ${i}d${d}: "
-    perl -e 'alarm 30; exec @ARGV' ./towers --generate 1 ${i}d${d} >/dev/null \
-      && echo ok
-  done
-done
-
-     * Of course, it's better to do that after taking the exceptions
-     * _out_, so as to detect exceptions that should be removed as
-     * well as those which should be added.
-     */
-    if (diff > DIFF_HARD && w <= 3)
-	diff = DIFF_HARD;
-
-    grid = NULL;
     clues = snewn(4*w, int);
     soln = snewn(a, digit);
     soln2 = snewn(a, digit);
     order = snewn(max(4*w,a), int);
+    arena = latin_arena_new(w);
 
-    while (1) {
-	/*
-	 * Construct a latin square to be the solution.
-	 */
-	sfree(grid);
-	grid = latin_generate(w, rs);
+    /*
+     * Construct a latin square to be the solution.
+     */
+    grid = latin_generate(w, rs);
 
-	/*
-	 * Fill in the clues.
-	 */
-	for (i = 0; i < 4*w; i++) {
-	    int start, step, j, k, best;
-	    STARTSTEP(start, step, i, w);
-	    k = best = 0;
-	    for (j = 0; j < w; j++) {
-		if (grid[start+j*step] > best) {
-		    best = grid[start+j*step];
-		    k++;
-		}
+    /*
+     * Fill in the clues.
+     */
+    for (i = 0; i < 4*w; i++) {
+	int start, step, j, k, best;
+	STARTSTEP(start, step, i, w);
+	k = best = 0;
+	for (j = 0; j < w; j++) {
+	    if (grid[start+j*step] > best) {
+		best = grid[start+j*step];
+		k++;
 	    }
-	    clues[i] = k;
 	}
+	clues[i] = k;
+    }
 
+    /*
+     * Remove the grid numbers and then the clues, one by one,
+     * for as long as the game remains soluble at the given
+     * difficulty.
+     */
+    memcpy(soln, grid, a);
+
+    if (diff == DIFF_EASY && w <= 5) {
 	/*
-	 * Remove the grid numbers and then the clues, one by one,
-	 * for as long as the game remains soluble at the given
-	 * difficulty.
+	 * Special case: for Easy-mode grids that are small
+	 * enough, it's nice to be able to find completely empty
+	 * grids.
 	 */
-	memcpy(soln, grid, a);
+	memset(soln2, 0, a);
+	ret = solver(w, clues, soln2, diff, arena);
+	if (ret > diff)
+	    goto out;
+    }
 
-	if (diff == DIFF_EASY && w <= 5) {
-	    /*
-	     * Special case: for Easy-mode grids that are small
-	     * enough, it's nice to be able to find completely empty
-	     * grids.
-	     */
-	    memset(soln2, 0, a);
-	    ret = solver(w, clues, soln2, diff);
-	    if (ret > diff)
-		continue;
-	}
+    for (i = 0; i < a; i++)
+	order[i] = i;
+    shuffle(order, a, sizeof(*order), rs);
+    for (i = 0; i < a; i++) {
+	int j = order[i];
 
-	for (i = 0; i < a; i++)
+	memcpy(soln2, grid, a);
+	soln2[j] = 0;
+	ret = solver(w, clues, soln2, diff, arena);
+	if (ret <= diff)
+	    grid[j] = 0;
+    }
+
+    if (diff > DIFF_EASY) {	       /* leave all clues on Easy mode */
+	for (i = 0; i < 4*w; i++)
 	    order[i] = i;
-	shuffle(order, a, sizeof(*order), rs);
-	for (i = 0; i < a; i++) {
+	shuffle(order, 4*w, sizeof(*order), rs);
+	for (i = 0; i < 4*w; i++) {
 	    int j = order[i];
+	    int clue = clues[j];
 
 	    memcpy(soln2, grid, a);
-	    soln2[j] = 0;
-	    ret = solver(w, clues, soln2, diff);
-	    if (ret <= diff)
-		grid[j] = 0;
-	}
-
-	if (diff > DIFF_EASY) {	       /* leave all clues on Easy mode */
-	    for (i = 0; i < 4*w; i++)
-		order[i] = i;
-	    shuffle(order, 4*w, sizeof(*order), rs);
-	    for (i = 0; i < 4*w; i++) {
-		int j = order[i];
-		int clue = clues[j];
-
-		memcpy(soln2, grid, a);
-		clues[j] = 0;
-		ret = solver(w, clues, soln2, diff);
-		if (ret > diff)
-		    clues[j] = clue;
-	    }
+	    clues[j] = 0;
+	    ret = solver(w, clues, soln2, diff, arena);
+	    if (ret > diff)
+		clues[j] = clue;
 	}
-
-	/*
-	 * See if the game can be solved at the specified difficulty
-	 * level, but not at the one below.
-	 */
-	memcpy(soln2, grid, a);
-	ret = solver(w, clues, soln2, diff);
-	if (ret != diff)
-	    continue;		       /* go round again */
-
-	/*
-	 * We've got a usable puzzle!
-	 */
-	break;
     }
 
     /*
-     * Encode the puzzle description.
+     * See if the game can be solved at the specified difficulty
+     * level, but not at the one below.
+     */
+    memcpy(soln2, grid, a);
+    ret = solver(w, clues, soln2, diff, arena);
+    if (ret != diff)
+	goto out;
+
+    /*
+     * We've got a usable puzzle! Encode the puzzle description.
      */
+    res = snew(struct towers_attempt_result);
     desc = snewn(40*a, char);
     p = desc;
     for (i = 0; i < 4*w; i++) {
@@ -817,23 +838,69 @@ done
 	}
     }
     *p++ = '\0';
-    desc = sresize(desc, p - desc, char);
+    res->desc = sresize(desc, p - desc, char);
 
     /*
      * Encode the solution.
      */
-    *aux = snewn(a+2, char);
-    (*aux)[0] = 'S';
+    res->aux = snewn(a+2, char);
+    res->aux[0] = 'S';
     for (i = 0; i < a; i++)
-	(*aux)[i+1] = '0' + soln[i];
-    (*aux)[a+1] = '\0';
+	res->aux[i+1] = '0' + soln[i];
+    res->aux[a+1] = '\0';
 
+  out:
     sfree(grid);
     sfree(clues);
     sfree(soln);
     sfree(soln2);
     sfree(order);
+    latin_arena_free(arena);
+
+    return res;
+}
+
+static char *new_game_desc(const game_params *params, random_state *rs,
+			   char **aux, bool interactive)
+{
+    int w = params->w;
+    int diff = params->diff;
+    struct towers_attempt_ctx ctx;
+    struct towers_attempt_result *res;
+    char *desc;
+
+    /*
+     * Difficulty exceptions: some combinations of size and
+     * difficulty cannot be satisfied, because all puzzles of at
+     * most that difficulty are actually even easier.
+     *
+     * Remember to re-test this whenever a change is made to the
+     * solver logic!
+     *
+     * I tested it using the following shell command:
+
+for d in e h x u; do
+  for i in {3..9}; do
+    echo -n "./towers --generate 1 ${i}d${d}: "
+    perl -e 'alarm 30; exec @ARGV' ./towers --generate 1 ${i}d${d} >/dev/null \
+      && echo ok
+  done
+done
+
+     * Of course, it's better to do that after taking the exceptions
+     * _out_, so as to detect exceptions that should be removed as
+     * well as those which should be added.
+     */
+    if (diff > DIFF_HARD && w <= 3)
+	diff = DIFF_HARD;
 
+    ctx.params = params;
+    ctx.diff = diff;
+    res = race_attempts(rs, towers_attempt, free_towers_attempt_result,
+                        &ctx, 0);
+    desc = res->desc;
+    *aux = res->aux;
+    sfree(res);
     return desc;
 }
 
@@ -1043,7 +1110,7 @@ static char *solve_game(const game_state *state, const game_state *currstate,
     soln = snewn(a, digit);
     memcpy(soln, state->clues->immutable, a);
 
-    ret = solver(w, state->clues->clues, soln, DIFFCOUNT-1);
+    ret = solver(w, state->clues->clues, soln, DIFFCOUNT-1, NULL);
 
     if (ret == diff_impossible) {
 	*error = "No solution exists for this puzzle";
@@ -2136,6 +2203,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     get_prefs, set_prefs,
@@ -2221,7 +2289,7 @@ int main(int argc, char **argv)
     solver_show_working = 0;
     for (diff = 0; diff < DIFFCOUNT; diff++) {
 	memcpy(s->grid, s->clues->immutable, p->w * p->w);
-	ret = solver(p->w, s->clues->clues, s->grid, diff);
+	ret = solver(p->w, s->clues->clues, s->grid, diff, NULL);
 	if (ret <= diff)
 	    break;
     }
@@ -2234,7 +2302,7 @@ int main(int argc, char **argv)
         solver_show_working = really_show_working;
         memcpy(s->grid, s->clues->immutable, p->w * p->w);
         ret = solver(p->w, s->clues->clues, s->grid,
-                     diff < DIFFCOUNT ? diff : DIFFCOUNT-1);
+                     diff < DIFFCOUNT ? diff : DIFFCOUNT-1, NULL);
     }
 
     if (diff == DIFFCOUNT) {
@@ -610,21 +610,17 @@ static void free_ctx(void *vctx)
 }
 
 static void solver_nminmax(struct latin_solver *solver,
-                           int x, int y, int *min_r, int *max_r,
-                           unsigned char **ns_r)
+                           int x, int y, int *min_r, int *max_r)
 {
     int o = solver->o, min = o, max = 0, n;
-    unsigned char *ns;
 
     assert(x >= 0 && y >= 0 && x < o && y < o);
 
-    ns = solver->cube + cubepos(x,y,1);
-
     if (grid(x,y) > 0) {
         min = max = grid(x,y)-1;
     } else {
         for (n = 0; n < o; n++) {
-            if (ns[n]) {
+            if (cube(x,y,n+1)) {
                 if (n > max) max = n;
                 if (n < min) min = n;
             }
@@ -632,25 +628,23 @@ static void solver_nminmax(struct latin_solver *solver,
     }
     if (min_r) *min_r = min;
     if (max_r) *max_r = max;
-    if (ns_r) *ns_r = ns;
 }
 
 static int solver_links(struct latin_solver *solver, void *vctx)
 {
     struct solver_ctx *ctx = (struct solver_ctx *)vctx;
     int i, j, lmin, gmax, nchanged = 0;
-    unsigned char *gns, *lns;
     struct solver_link *link;
 
     for (i = 0; i < ctx->nlinks; i++) {
         link = &ctx->links[i];
-        solver_nminmax(solver, link->gx, link->gy, NULL, &gmax, &gns);
-        solver_nminmax(solver, link->lx, link->ly, &lmin, NULL, &lns);
+        solver_nminmax(solver, link->gx, link->gy, NULL, &gmax);
+        solver_nminmax(solver, link->lx, link->ly, &lmin, NULL);
 
         for (j = 0; j < solver->o; j++) {
             /* For the 'greater' end of the link, discount all numbers
              * too small to satisfy the inequality. */
-            if (gns[j]) {
+            if (cube(link->gx, link->gy, j+1)) {
                 if (j < (lmin+link->len)) {
 #ifdef STANDALONE_SOLVER
                     if (solver_show_working) {
@@ -662,13 +656,13 @@ static int solver_links(struct latin_solver *solver, void *vctx)
                                j+1, link->gx+1, link->gy+1);
                     }
 #endif
-                    cube(link->gx, link->gy, j+1) = false;
+                    cube_clear(link->gx, link->gy, j+1);
                     nchanged++;
                 }
             }
             /* For the 'lesser' end of the link, discount all numbers
              * too large to satisfy inequality. */
-            if (lns[j]) {
+            if (cube(link->lx, link->ly, j+1)) {
                 if (j > (gmax-link->len)) {
 #ifdef STANDALONE_SOLVER
                     if (solver_show_working) {
@@ -680,7 +674,7 @@ static int solver_links(struct latin_solver *solver, void *vctx)
                                j+1, link->lx+1, link->ly+1);
                     }
 #endif
-                    cube(link->lx, link->ly, j+1) = false;
+                    cube_clear(link->lx, link->ly, j+1);
                     nchanged++;
                 }
             }
@@ -730,7 +724,7 @@ static int solver_adjacent(struct latin_solver *solver, void *vctx)
                                solver_recurse_depth*4, "", n+1, nx+1, ny+1);
                     }
 #endif
-                    cube(nx, ny, n+1) = false;
+                    cube_clear(nx, ny, n+1);
                     nchanged++;
                 }
             }
@@ -795,7 +789,7 @@ static int solver_adjacent_set(struct latin_solver *solver, void *vctx)
                                solver_recurse_depth*4, "", n+1, nx+1, ny+1);
                     }
 #endif
-                    cube(nx, ny, n+1) = false;
+                    cube_clear(nx, ny, n+1);
                     nchanged++;
                 }
             }
@@ -894,22 +888,22 @@ static bool unequal_valid(struct latin_solver *solver, void *vctx)
     return true;
 }
 
-static int solver_state(game_state *state, int maxdiff)
+static int solver_state(game_state *state, int maxdiff, latin_arena *arena)
 {
     struct solver_ctx *ctx = new_ctx(state);
     struct latin_solver solver;
     int diff;
 
-    if (latin_solver_alloc(&solver, state->nums, state->order))
+    if (latin_solver_alloc_arena(&solver, state->nums, state->order, arena))
         diff = latin_solver_main(&solver, maxdiff,
                                  DIFF_LATIN, DIFF_SET, DIFF_EXTREME,
                                  DIFF_EXTREME, DIFF_RECURSIVE,
                                  unequal_solvers, unequal_valid, ctx,
-                                 clone_ctx, free_ctx);
+                                 clone_ctx, free_ctx, NULL, NULL);
     else
         diff = DIFF_IMPOSSIBLE;
 
-    memcpy(state->hints, solver.cube, state->order*state->order*state->order);
+    latin_solver_get_cube(&solver, state->hints);
 
     free_ctx(ctx);
 
@@ -931,7 +925,7 @@ static game_state *solver_hint(const game_state *state, int *diff_r,
     int diff, r = 0;
 
     for (diff = mindiff; diff <= maxdiff; diff++) {
-        r = solver_state(ret, diff);
+        r = solver_state(ret, diff, NULL);
         debug(("solver_state after %s %d", unequal_diffnames[diff], r));
         if (r != 0) goto done;
     }
@@ -1089,10 +1083,8 @@ static int maxtries;
 #else
 #define MAXTRIES 50
 #endif
-static int gg_solved;
-
 static int game_assemble(game_state *new, int *scratch, digit *latin,
-                         int difficulty)
+                         int difficulty, latin_arena *arena, int *solved)
 {
     game_state *copy = dup_game(new);
     int best;
@@ -1114,8 +1106,8 @@ static int game_assemble(game_state *new, int *scratch, digit *latin,
 #endif
 
     while(1) {
-        gg_solved++;
-        if (solver_state(copy, difficulty) == 1) break;
+        (*solved)++;
+        if (solver_state(copy, difficulty, arena) == 1) break;
 
         best = gg_best_clue(copy, scratch, latin);
         gg_place_clue(new, scratch[best], latin, false);
@@ -1125,7 +1117,7 @@ static int game_assemble(game_state *new, int *scratch, digit *latin,
 #ifdef STANDALONE_SOLVER
     if (solver_show_working) {
         char *dbg = game_text_format(new);
-        printf("game_assemble: done, %d solver iterations:\n%s\n", gg_solved, dbg);
+        printf("game_assemble: done, %d solver iterations:\n%s\n", *solved, dbg);
         sfree(dbg);
     }
 #endif
@@ -1133,7 +1125,7 @@ static int game_assemble(game_state *new, int *scratch, digit *latin,
 }
 
 static void game_strip(game_state *new, int *scratch, digit *latin,
-                       int difficulty)
+                       int difficulty, latin_arena *arena, int *solved)
 {
     int o = new->order, o2 = o*o, lscratch = o2*5, i;
     game_state *copy = blank_game(new->order, new->mode);
@@ -1145,8 +1137,8 @@ static void game_strip(game_state *new, int *scratch, digit *latin,
 
         memcpy(copy->nums,  new->nums,  o2 * sizeof(digit));
         memcpy(copy->flags, new->flags, o2 * sizeof(unsigned int));
-        gg_solved++;
-        if (solver_state(copy, difficulty) != 1) {
+        (*solved)++;
+        if (solver_state(copy, difficulty, arena) != 1) {
             /* put clue back, we can't solve without it. */
             bool ret = gg_place_clue(new, scratch[i], latin, false);
             assert(ret);
@@ -1161,7 +1153,7 @@ static void game_strip(game_state *new, int *scratch, digit *latin,
 #ifdef STANDALONE_SOLVER
     if (solver_show_working) {
         char *dbg = game_text_format(new);
-        debug(("game_strip: done, %d solver iterations.", gg_solved));
+        debug(("game_strip: done, %d solver iterations.", *solved));
         debug(("%s", dbg));
         sfree(dbg);
     }
@@ -1190,75 +1182,94 @@ static void add_adjacent_flags(game_state *state, digit *latin)
     }
 }
 
-static char *new_game_desc(const game_params *params_in, random_state *rs,
-			   char **aux, bool interactive)
+struct unequal_attempt_ctx {
+    const game_params *params;
+    bool accept_easy;                  /* settle for a too-easy puzzle */
+};
+
+struct unequal_attempt_result {
+    char *desc, *aux;
+};
+
+static void free_unequal_attempt_result(void *vres)
 {
-    game_params params_copy = *params_in; /* structure copy */
-    game_params *params = &params_copy;
-    digit *sq = NULL;
-    int i, x, y, retlen, k, nsol;
-    int o2 = params->order * params->order, ntries = 1;
+    struct unequal_attempt_result *res = (struct unequal_attempt_result *)vres;
+    sfree(res->desc);
+    sfree(res->aux);
+    sfree(res);
+}
+
+/*
+ * One go at generating a puzzle, returning NULL if it came out too
+ * easy (unless we've been told to settle for that). new_game_desc
+ * hands these to race_attempts, which may run several at once.
+ */
+static void *unequal_attempt(void *vctx, random_state *rs)
+{
+    const struct unequal_attempt_ctx *ctx =
+        (const struct unequal_attempt_ctx *)vctx;
+    const game_params *params = ctx->params;
+    int diff = params->diff;
+    digit *sq;
+    int i, x, y, retlen, k, nsol, solved = 0;
+    int o2 = params->order * params->order;
     int *scratch, lscratch = o2*5;
     char *ret, buf[80];
     game_state *state = blank_game(params->order, params->mode);
+    latin_arena *arena = latin_arena_new(params->order);
+    struct unequal_attempt_result *res = NULL;
 
     /* Generate a list of 'things to strip' (randomised later) */
     scratch = snewn(lscratch, int);
     /* Put the numbers (4 mod 5) before the inequalities (0-3 mod 5) */
     for (i = 0; i < lscratch; i++) scratch[i] = (i%o2)*5 + 4 - (i/o2);
 
-generate:
 #ifdef STANDALONE_SOLVER
     if (solver_show_working)
-        printf("new_game_desc: generating %s puzzle, ntries so far %d\n",
-               unequal_diffnames[params->diff], ntries);
+        printf("new_game_desc: generating %s puzzle\n",
+               unequal_diffnames[diff]);
 #endif
-    if (sq) sfree(sq);
     sq = latin_generate(params->order, rs);
     latin_debug(sq, params->order);
     /* Separately shuffle the numeric and inequality clues */
     shuffle(scratch, lscratch/5, sizeof(int), rs);
     shuffle(scratch+lscratch/5, 4*lscratch/5, sizeof(int), rs);
 
-    memset(state->nums, 0, o2 * sizeof(digit));
-    memset(state->flags, 0, o2 * sizeof(unsigned int));
-
     if (state->mode == MODE_ADJACENT) {
         /* All adjacency flags are always present. */
         add_adjacent_flags(state, sq);
     }
 
-    gg_solved = 0;
-    if (game_assemble(state, scratch, sq, params->diff) < 0)
-        goto generate;
-    game_strip(state, scratch, sq, params->diff);
+    if (game_assemble(state, scratch, sq, diff, arena, &solved) < 0)
+        goto out;
+    game_strip(state, scratch, sq, diff, arena, &solved);
 
-    if (params->diff > 0) {
+    if (diff > 0) {
         game_state *copy = dup_game(state);
-        nsol = solver_state(copy, params->diff-1);
+        nsol = solver_state(copy, diff-1, arena);
         free_game(copy);
         if (nsol > 0) {
 #ifdef STANDALONE_SOLVER
             if (solver_show_working)
                 printf("game_assemble: puzzle as generated is too easy.\n");
 #endif
-            if (ntries < MAXTRIES) {
-                ntries++;
-                goto generate;
-            }
+            if (!ctx->accept_easy)
+                goto out;
 #ifdef STANDALONE_SOLVER
             if (solver_show_working)
                 printf("Unable to generate %s %dx%d after %d attempts.\n",
-                       unequal_diffnames[params->diff],
+                       unequal_diffnames[diff],
                        params->order, params->order, MAXTRIES);
 #endif
-            params->diff--;
+            diff--;
         }
     }
 #ifdef STANDALONE_SOLVER
     if (solver_show_working)
-        printf("new_game_desc: generated %s puzzle; %d attempts (%d solver).\n",
-               unequal_diffnames[params->diff], ntries, gg_solved);
+        printf("new_game_desc: generated %s puzzle; %d solver, "
+               "%ld solver allocations.\n",
+               unequal_diffnames[diff], solved,
+               latin_arena_allocs(arena));
 #endif
 
     ret = NULL; retlen = 0;
@@ -1277,12 +1288,44 @@ generate:
             retlen += k;
         }
     }
-    *aux = latin_desc(sq, params->order);
+    res = snew(struct unequal_attempt_result);
+    res->desc = ret;
+    res->aux = latin_desc(sq, params->order);
 
+  out:
     free_game(state);
     sfree(sq);
     sfree(scratch);
+    latin_arena_free(arena);
+
+    return res;
+}
 
+static char *new_game_desc(const game_params *params, random_state *rs,
+			   char **aux, bool interactive)
+{
+    struct unequal_attempt_ctx ctx;
+    struct unequal_attempt_result *res = NULL;
+    char *ret;
+
+    /*
+     * Hold out for a puzzle of the requested difficulty for all but
+     * the last of MAXTRIES attempts, and then take the last one
+     * whatever it turns out like. The last attempt carries on from
+     * rs, which the first attempt has finished with by then.
+     */
+    ctx.params = params;
+    ctx.accept_easy = false;
+    if (MAXTRIES > 1)
+        res = race_attempts(rs, unequal_attempt, free_unequal_attempt_result,
+                            &ctx, MAXTRIES - 1);
+    if (!res) {
+        ctx.accept_easy = true;
+        res = unequal_attempt(&ctx, rs);
+    }
+    ret = res->desc;
+    *aux = res->aux;
+    sfree(res);
     return ret;
 }
 
@@ -1428,7 +1471,7 @@ static char *solve_game(const game_state *state, const game_state *currstate,
         if (!(solved->flags[r] & F_IMMUTABLE))
             solved->nums[r] = 0;
     }
-    r = solver_state(solved, DIFFCOUNT-1);   /* always use full solver */
+    r = solver_state(solved, DIFFCOUNT-1, NULL); /* always use full solver */
     if (r > 0) ret = latin_desc(solved->nums, solved->order);
     free_game(solved);
     return ret;
@@ -2199,6 +2242,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     get_prefs, set_prefs,
@@ -2308,7 +2352,7 @@ static int solve(game_params *p, char *desc, int debug)
                                  DIFF_LATIN, DIFF_SET, DIFF_EXTREME,
                                  DIFF_EXTREME, DIFF_RECURSIVE,
                                  unequal_solvers, unequal_valid, ctx,
-                                 clone_ctx, free_ctx);
+                                 clone_ctx, free_ctx, NULL, NULL);
     else
         diff = DIFF_IMPOSSIBLE;
 
@@ -2370,7 +2414,7 @@ static void soak(game_params *p, random_state *rs)
         p->diff = realdiff;
         desc = new_game_desc(p, rs, &aux, false);
         st = new_game(NULL, p, desc);
-        solver_state(st, DIFF_RECURSIVE);
+        solver_state(st, DIFF_RECURSIVE, NULL);
         free_game(st);
         sfree(aux);
         sfree(desc);
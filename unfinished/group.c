@@ -337,7 +337,7 @@ static int solver_normal(struct latin_solver *solver, void *vctx)
 			       names[n-1], x+1, y+1);
 		    }
 #endif
-		    if (solver->cube[(x*w+y)*w+n-1]) {
+		    if (cube(x, y, n)) {
 			latin_solver_place(solver, x, y, n);
 			return 1;
 		    } else {
@@ -365,7 +365,7 @@ static int solver_normal(struct latin_solver *solver, void *vctx)
 			       names[n-1], x+1, y+1);
 		    }
 #endif
-		    if (solver->cube[(x*w+y)*w+n-1]) {
+		    if (cube(x, y, n)) {
 			latin_solver_place(solver, x, y, n);
 			return 1;
 		    } else {
@@ -518,7 +518,7 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
                                solver_recurse_depth*4, "", names[j], i, j);
                     }
 #endif
-                    cube(i, j, j+1) = false;
+                    cube_clear(i, j, j+1);
                     done_something = true;
                 }
                 if (cube(j, i, j+1)) {
@@ -533,7 +533,7 @@ static int solver_hard(struct latin_solver *solver, void *vctx)
                                solver_recurse_depth*4, "", names[j], j, i);
                     }
 #endif
-                    cube(j, i, j+1) = false;
+                    cube_clear(j, i, j+1);
                     done_something = true;
                 }
             }
@@ -603,7 +603,8 @@ static int solver(const game_params *params, digit *grid, int maxdiff)
         ret = latin_solver_main(&solver, maxdiff,
                                 DIFF_TRIVIAL, DIFF_HARD, DIFF_EXTREME,
                                 DIFF_EXTREME, DIFF_UNREASONABLE,
-                                group_solvers, group_valid, NULL, NULL, NULL);
+                                group_solvers, group_valid, NULL, NULL, NULL,
+                                NULL, NULL);
     else
         ret = diff_impossible;
 
@@ -2391,6 +2392,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     true, solve_game,
     true, game_can_format_as_text_now, game_text_format,
     get_prefs, set_prefs,
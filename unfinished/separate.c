@@ -833,6 +833,7 @@ const struct game thegame = {
     new_game,
     dup_game,
     free_game,
+    NULL, NULL, /* encode_state, decode_state */
     false, solve_game,
     false, game_can_format_as_text_now, game_text_format,
     NULL, NULL, /* get_prefs, set_prefs */